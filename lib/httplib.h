@@ -180,6 +180,7 @@ using socket_t = SOCKET;
 #include <netinet/in.h>
 #ifdef __linux__
 #include <resolv.h>
+#include <sys/sendfile.h>
 #endif
 #include <netinet/tcp.h>
 #ifdef CPPHTTPLIB_USE_POLL
@@ -223,6 +224,7 @@ using socket_t = int;
 #include <string>
 #include <sys/stat.h>
 #include <thread>
+#include <unordered_map>
 
 #ifdef CPPHTTPLIB_OPENSSL_SUPPORT
 #ifdef _WIN32
@@ -341,6 +343,9 @@ public:
   std::function<bool(const char *data, size_t data_len)> write;
   std::function<void()> done;
   std::function<bool()> is_writable;
+  // Sends a range of a file without copying it through user space. Null when
+  // the stream cannot do that, e.g. TLS, then read the file and use `write`.
+  std::function<bool(int fd, size_t offset, size_t length)> write_file;
   std::ostream os;
 
 private:
@@ -431,6 +436,7 @@ struct Request {
   MultipartFormDataMap files;
   Ranges ranges;
   Match matches;
+  std::unordered_map<std::string, std::string> path_params;
 
   // for client
   ResponseHandler response_handler;
@@ -527,6 +533,12 @@ public:
   virtual void get_local_ip_and_port(std::string &ip, int &port) const = 0;
   virtual socket_t socket() const = 0;
 
+  // Zero-copy file transfer, only plain sockets on Linux support it
+  virtual bool can_write_file() const { return false; }
+  virtual ssize_t write_file(int /*fd*/, size_t /*offset*/, size_t /*size*/) {
+    return -1;
+  }
+
   template <typename... Args>
   ssize_t write_format(const char *fmt, const Args &...args);
   ssize_t write(const char *ptr);
@@ -538,7 +550,9 @@ public:
   TaskQueue() = default;
   virtual ~TaskQueue() = default;
 
-  virtual void enqueue(std::function<void()> fn) = 0;
+  // Returns false if the task was not admitted, the connection is then
+  // answered with 503 and closed
+  virtual bool enqueue(std::function<void()> fn) = 0;
   virtual void shutdown() = 0;
 
   virtual void on_idle() {}
@@ -556,13 +570,14 @@ public:
   ThreadPool(const ThreadPool &) = delete;
   ~ThreadPool() override = default;
 
-  void enqueue(std::function<void()> fn) override {
+  bool enqueue(std::function<void()> fn) override {
     {
       std::unique_lock<std::mutex> lock(mutex_);
       jobs_.push_back(std::move(fn));
     }
 
     cond_.notify_one();
+    return true;
   }
 
   void shutdown() override {
@@ -643,6 +658,12 @@ public:
   using Expect100ContinueHandler =
       std::function<int(const Request &, Response &)>;
 
+  // Looks the route up itself instead of the handlers registered with
+  // Get/Post/..., called with the content reader before the body is read and
+  // with nullptr after, returns true if the request was handled
+  using Dispatcher = std::function<bool(Request &, Response &,
+                                        const ContentReader *content_reader)>;
+
   Server();
 
   virtual ~Server();
@@ -674,6 +695,7 @@ public:
   Server &set_exception_handler(ExceptionHandler handler);
   Server &set_pre_routing_handler(HandlerWithResponse handler);
   Server &set_post_routing_handler(Handler handler);
+  Server &set_dispatcher(Dispatcher handler);
 
   Server &set_expect_100_continue_handler(Expect100ContinueHandler handler);
   Server &set_logger(Logger logger);
@@ -798,6 +820,7 @@ private:
   ExceptionHandler exception_handler_;
   HandlerWithResponse pre_routing_handler_;
   Handler post_routing_handler_;
+  Dispatcher dispatcher_;
   Logger logger_;
   Expect100ContinueHandler expect_100_continue_handler_;
 
@@ -2481,6 +2504,10 @@ public:
   void get_remote_ip_and_port(std::string &ip, int &port) const override;
   void get_local_ip_and_port(std::string &ip, int &port) const override;
   socket_t socket() const override;
+#ifdef __linux__
+  bool can_write_file() const override { return true; }
+  ssize_t write_file(int fd, size_t offset, size_t size) override;
+#endif
 
 private:
   socket_t sock_;
@@ -2594,6 +2621,26 @@ inline int shutdown_socket(socket_t sock) {
 #endif
 }
 
+// Answers a connection the task queue did not admit without reading the
+// request, best effort: a request arriving after the close resets the
+// connection
+inline void reject_socket(socket_t sock) {
+  static const char response[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                 "Content-Length: 0\r\n"
+                                 "Retry-After: 1\r\n"
+                                 "Connection: close\r\n\r\n";
+  send_socket(sock, response, sizeof(response) - 1, CPPHTTPLIB_SEND_FLAGS);
+#ifdef _WIN32
+  shutdown(sock, SD_SEND);
+#else
+  shutdown(sock, SHUT_WR);
+  // Unread data makes close send a reset that may discard the response
+  char buf[1024];
+  while (read_socket(sock, buf, sizeof(buf), MSG_DONTWAIT) > 0) {}
+#endif
+  close_socket(sock);
+}
+
 template <typename BindOrConnect>
 socket_t create_socket(const std::string &host, const std::string &ip, int port,
                        int address_family, int socket_flags, bool tcp_nodelay,
@@ -3643,6 +3690,24 @@ inline bool write_content(Stream &strm, const ContentProvider &content_provider,
 
   data_sink.is_writable = [&](void) { return ok && strm.is_writable(); };
 
+  if (strm.can_write_file()) {
+    data_sink.write_file = [&](int fd, size_t file_offset, size_t l) -> bool {
+      while (ok && l > 0) {
+        auto n = strm.write_file(fd, file_offset, l);
+        if (n < 0 && errno == EINTR) { continue; }
+        // 0: the file was truncated under us
+        if (n <= 0) {
+          ok = false;
+          break;
+        }
+        offset += static_cast<size_t>(n);
+        file_offset += static_cast<size_t>(n);
+        l -= static_cast<size_t>(n);
+      }
+      return ok;
+    };
+  }
+
   while (offset < end_offset && !is_shutting_down()) {
     if (!content_provider(offset, end_offset - offset, data_sink)) {
       error = Error::Canceled;
@@ -4218,6 +4283,27 @@ get_range_offset_and_length(const Request &req, size_t content_length,
   return std::make_pair(r.first, static_cast<size_t>(r.second - r.first) + 1);
 }
 
+// Resolves suffix and open ranges against the content length and drops the
+// ones that start past the end. Returns false when no range is satisfiable.
+inline bool normalize_ranges(Ranges &ranges, size_t content_length) {
+  auto len = static_cast<ssize_t>(content_length);
+  Ranges satisfiable;
+  for (auto r : ranges) {
+    if (r.first == -1 && r.second == -1) {
+      r.first = 0;
+    } else if (r.first == -1) {
+      if (r.second == 0) { continue; }
+      r.first = (std::max)(static_cast<ssize_t>(0), len - r.second);
+      r.second = -1;
+    }
+    if (r.first >= len) { continue; }
+    if (r.second == -1 || r.second >= len) { r.second = len - 1; }
+    satisfiable.push_back(r);
+  }
+  ranges.swap(satisfiable);
+  return !ranges.empty();
+}
+
 inline std::string make_content_range_header_field(size_t offset, size_t length,
                                                    size_t content_length) {
   std::string field = "bytes ";
@@ -4235,6 +4321,9 @@ bool process_multipart_ranges_data(const Request &req, Response &res,
                                    const std::string &content_type,
                                    SToken stoken, CToken ctoken,
                                    Content content) {
+  // A content provider leaves the body empty, its length is content_length_
+  auto content_length = res.body.empty() ? res.content_length_ : res.body.size();
+
   for (size_t i = 0; i < req.ranges.size(); i++) {
     ctoken("--");
     stoken(boundary);
@@ -4245,12 +4334,12 @@ bool process_multipart_ranges_data(const Request &req, Response &res,
       ctoken("\r\n");
     }
 
-    auto offsets = get_range_offset_and_length(req, res.body.size(), i);
+    auto offsets = get_range_offset_and_length(req, content_length, i);
     auto offset = offsets.first;
     auto length = offsets.second;
 
     ctoken("Content-Range: ");
-    stoken(make_content_range_header_field(offset, length, res.body.size()));
+    stoken(make_content_range_header_field(offset, length, content_length));
     ctoken("\r\n");
     ctoken("\r\n");
     if (!content(offset, length)) { return false; }
@@ -4877,6 +4966,14 @@ inline void SocketStream::get_local_ip_and_port(std::string &ip,
 
 inline socket_t SocketStream::socket() const { return sock_; }
 
+#ifdef __linux__
+inline ssize_t SocketStream::write_file(int fd, size_t offset, size_t size) {
+  if (!is_writable()) { return -1; }
+  auto off = static_cast<off_t>(offset);
+  return ::sendfile(sock_, fd, &off, size);
+}
+#endif
+
 // Buffer stream implementation
 inline bool BufferStream::is_readable() const { return true; }
 
@@ -5047,6 +5144,11 @@ inline Server &Server::set_pre_routing_handler(HandlerWithResponse handler) {
   return *this;
 }
 
+inline Server &Server::set_dispatcher(Dispatcher handler) {
+  dispatcher_ = std::move(handler);
+  return *this;
+}
+
 inline Server &Server::set_post_routing_handler(Handler handler) {
   post_routing_handler_ = std::move(handler);
   return *this;
@@ -5591,10 +5693,13 @@ inline bool Server::listen_internal() {
       }
 
 #if __cplusplus > 201703L
-      task_queue->enqueue([=, this]() { process_and_close_socket(sock); });
+      auto admitted =
+          task_queue->enqueue([=, this]() { process_and_close_socket(sock); });
 #else
-      task_queue->enqueue([=]() { process_and_close_socket(sock); });
+      auto admitted =
+          task_queue->enqueue([=]() { process_and_close_socket(sock); });
 #endif
+      if (!admitted) { detail::reject_socket(sock); }
     }
 
     task_queue->shutdown();
@@ -5631,6 +5736,8 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
                                                       std::move(receiver));
           });
 
+      if (dispatcher_ && dispatcher_(req, res, &reader)) { return true; }
+
       if (req.method == "POST") {
         if (dispatch_request_for_content_reader(
                 req, res, std::move(reader),
@@ -5662,6 +5769,8 @@ inline bool Server::routing(Request &req, Response &res, Stream &strm) {
     if (!read_content(strm, req, res)) { return false; }
   }
 
+  if (dispatcher_ && dispatcher_(req, res, nullptr)) { return true; }
+
   // Regular handler
   if (req.method == "GET" || req.method == "HEAD") {
     return dispatch_request(req, res, get_handlers_);
@@ -5952,6 +6061,26 @@ Server::process_request(Stream &strm, bool close_connection,
 
   if (routed) {
     if (res.status == -1) { res.status = req.ranges.empty() ? 200 : 206; }
+    if (!req.ranges.empty()) {
+      // Ranges only apply to a 206 response whose length is known up front
+      auto has_length = !res.body.empty() || res.content_length_ > 0 ||
+                        !res.content_provider_;
+      if (res.status != 206 || !has_length) {
+        req.ranges.clear();
+        if (res.status == 206) { res.status = 200; }
+      } else {
+        auto length = res.body.empty() ? res.content_length_ : res.body.size();
+        if (!detail::normalize_ranges(req.ranges, length)) {
+          res.status = 416;
+          res.body.clear();
+          res.content_length_ = 0;
+          res.content_provider_ = nullptr;
+          res.set_header("Content-Range", "bytes */" + std::to_string(length));
+          req.ranges.clear();
+          return write_response(strm, close_connection, req, res);
+        }
+      }
+    }
     return write_response_with_content(strm, close_connection, req, res);
   } else {
     if (res.status == -1) { res.status = 404; }
@@ -0,0 +1,395 @@
+/*
+ *  IXEventLoop.cpp
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#include "IXEventLoop.h"
+
+#include "IXSetThreadName.h"
+#include "IXUniquePtr.h"
+#include <algorithm>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace ix
+{
+    const int EventLoop::kTickIntervalMs(100);
+    const EventLoop::HandlerId EventLoop::kWakeUpHandlerId(0);
+    const int EventLoop::kMaxEventsPerWait(256);
+
+    EventLoop::EventLoop()
+        : _epollFd(-1)
+        , _wakeUpFd(-1)
+        , _nextHandlerId(kWakeUpHandlerId + 1)
+        , _handlersCount(0)
+        , _stopping(false)
+    {
+    }
+
+    EventLoop::~EventLoop()
+    {
+        stop(0);
+
+#ifdef __linux__
+        if (_wakeUpFd != -1) ::close(_wakeUpFd);
+        if (_epollFd != -1) ::close(_epollFd);
+#endif
+    }
+
+#ifdef __linux__
+    bool EventLoop::init(std::string& errorMsg)
+    {
+        _epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFd == -1)
+        {
+            errorMsg = std::string("epoll_create1 failed: ") + strerror(errno);
+            return false;
+        }
+
+        _wakeUpFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (_wakeUpFd == -1)
+        {
+            errorMsg = std::string("eventfd failed: ") + strerror(errno);
+            return false;
+        }
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = kWakeUpHandlerId;
+        if (::epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeUpFd, &event) == -1)
+        {
+            errorMsg = std::string("epoll_ctl failed: ") + strerror(errno);
+            return false;
+        }
+
+        return true;
+    }
+
+    void EventLoop::start(const std::string& threadName)
+    {
+        if (!_thread.joinable())
+        {
+            _thread = std::thread(&EventLoop::run, this, threadName);
+        }
+    }
+
+    void EventLoop::requestStop(int drainTimeoutMs)
+    {
+        if (!_thread.joinable()) return;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(drainTimeoutMs);
+        post(
+            [this, deadline]
+            {
+                _stopping = true;
+                _stopDeadline = deadline;
+            });
+    }
+
+    bool EventLoop::post(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_tasksMutex);
+            _tasks.push_back(std::move(task));
+        }
+
+        uint64_t value = 1;
+        return ::write(_wakeUpFd, &value, sizeof(value)) == sizeof(value) || errno == EAGAIN;
+    }
+
+    EventLoop::HandlerId EventLoop::add(int fd, bool wantWrite, const EventLoopHandlerPtr& handler)
+    {
+        HandlerId id = _nextHandlerId++;
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0);
+        event.data.u64 = id;
+        if (::epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+        {
+            return kWakeUpHandlerId;
+        }
+
+        _handlers[id] = Registration {fd, handler};
+        _handlersCount = _handlers.size();
+        return id;
+    }
+
+    bool EventLoop::setWantWrite(HandlerId id, bool wantWrite)
+    {
+        auto it = _handlers.find(id);
+        if (it == _handlers.end()) return false;
+
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0);
+        event.data.u64 = id;
+        return ::epoll_ctl(_epollFd, EPOLL_CTL_MOD, it->second.fd, &event) == 0;
+    }
+
+    void EventLoop::remove(HandlerId id)
+    {
+        auto it = _handlers.find(id);
+        if (it == _handlers.end()) return;
+
+        // The descriptor is still open here (sockets on a loop defer their close
+        // to destruction), so this can never remove a recycled fd.
+        ::epoll_ctl(_epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        _handlers.erase(it);
+        _handlersCount = _handlers.size();
+    }
+
+    void EventLoop::run(std::string threadName)
+    {
+        setThreadName(threadName);
+        _threadId = std::this_thread::get_id();
+
+        std::vector<struct epoll_event> events(kMaxEventsPerWait);
+        auto tickInterval = std::chrono::milliseconds(kTickIntervalMs);
+        auto nextTick = std::chrono::steady_clock::now() + tickInterval;
+
+        for (;;)
+        {
+            auto now = std::chrono::steady_clock::now();
+            int timeoutMs = 0;
+            if (nextTick > now)
+            {
+                timeoutMs = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                                nextTick - now + std::chrono::milliseconds(1))
+                                .count();
+            }
+
+            int count = ::epoll_wait(_epollFd, &events[0], (int) events.size(), timeoutMs);
+            if (count < 0 && errno != EINTR)
+            {
+                break;
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                const struct epoll_event& event = events[i];
+                if (event.data.u64 == kWakeUpHandlerId)
+                {
+                    uint64_t value;
+                    while (::read(_wakeUpFd, &value, sizeof(value)) == sizeof(value))
+                        ;
+                    continue;
+                }
+
+                // The handler may have been removed by a previous event of this batch
+                auto it = _handlers.find(event.data.u64);
+                if (it == _handlers.end()) continue;
+
+                // Keep the handler alive, it may remove itself from the loop
+                EventLoopHandlerPtr handler = it->second.handler;
+                bool readable = (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0;
+                bool writable = (event.events & EPOLLOUT) != 0;
+                handler->onEvents(readable, writable);
+            }
+
+            runPostedTasks();
+
+            now = std::chrono::steady_clock::now();
+            if (now >= nextTick)
+            {
+                runTicks();
+                nextTick = now + tickInterval;
+            }
+
+            if (_stopping && (_handlers.empty() || now >= _stopDeadline))
+            {
+                break;
+            }
+        }
+
+        notifyStopped();
+        runPostedTasks();
+    }
+#else
+    bool EventLoop::init(std::string& errorMsg)
+    {
+        errorMsg = "event loops are only supported on Linux (epoll)";
+        return false;
+    }
+
+    void EventLoop::start(const std::string& /*threadName*/)
+    {
+    }
+
+    void EventLoop::requestStop(int /*drainTimeoutMs*/)
+    {
+    }
+
+    bool EventLoop::post(Task /*task*/)
+    {
+        return false;
+    }
+
+    EventLoop::HandlerId EventLoop::add(int /*fd*/,
+                                        bool /*wantWrite*/,
+                                        const EventLoopHandlerPtr& /*handler*/)
+    {
+        return kWakeUpHandlerId;
+    }
+
+    bool EventLoop::setWantWrite(HandlerId /*id*/, bool /*wantWrite*/)
+    {
+        return false;
+    }
+
+    void EventLoop::remove(HandlerId /*id*/)
+    {
+    }
+
+    void EventLoop::run(std::string /*threadName*/)
+    {
+    }
+#endif
+
+    void EventLoop::stop(int drainTimeoutMs)
+    {
+        requestStop(drainTimeoutMs);
+        join();
+    }
+
+    void EventLoop::join()
+    {
+        if (_thread.joinable()) _thread.join();
+    }
+
+    bool EventLoop::isInLoopThread() const
+    {
+        return _threadId.load() == std::this_thread::get_id();
+    }
+
+    size_t EventLoop::getHandlersCount() const
+    {
+        return _handlersCount;
+    }
+
+    bool EventLoop::isStopping() const
+    {
+        return _stopping;
+    }
+
+    void EventLoop::runPostedTasks()
+    {
+        std::vector<Task> tasks;
+        {
+            std::lock_guard<std::mutex> lock(_tasksMutex);
+            tasks.swap(_tasks);
+        }
+
+        for (auto&& task : tasks)
+        {
+            task();
+        }
+    }
+
+    void EventLoop::runTicks()
+    {
+        // Handlers may unregister themselves while ticking
+        std::vector<EventLoopHandlerPtr> handlers;
+        handlers.reserve(_handlers.size());
+        for (auto&& it : _handlers)
+        {
+            handlers.push_back(it.second.handler);
+        }
+
+        for (auto&& handler : handlers)
+        {
+            handler->onTick();
+        }
+    }
+
+    void EventLoop::notifyStopped()
+    {
+        auto ids = std::vector<HandlerId>();
+        for (auto&& it : _handlers)
+        {
+            ids.push_back(it.first);
+        }
+
+        for (auto id : ids)
+        {
+            auto it = _handlers.find(id);
+            if (it == _handlers.end()) continue;
+
+            EventLoopHandlerPtr handler = it->second.handler;
+            remove(id);
+            handler->onLoopStopped();
+        }
+    }
+
+    bool EventLoopPool::start(size_t loopCount,
+                              const std::string& threadNamePrefix,
+                              std::string& errorMsg)
+    {
+        if (loopCount == 0)
+        {
+            loopCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (size_t i = 0; i < loopCount; ++i)
+        {
+            auto loop = ix::make_unique<EventLoop>();
+            if (!loop->init(errorMsg))
+            {
+                _loops.clear();
+                return false;
+            }
+            _loops.push_back(std::move(loop));
+        }
+
+        for (size_t i = 0; i < _loops.size(); ++i)
+        {
+            _loops[i]->start(threadNamePrefix + std::to_string(i));
+        }
+
+        return true;
+    }
+
+    void EventLoopPool::stop(int drainTimeoutMs)
+    {
+        // All loops drain in parallel
+        for (auto&& loop : _loops)
+        {
+            loop->requestStop(drainTimeoutMs);
+        }
+        for (auto&& loop : _loops)
+        {
+            loop->join();
+        }
+        _loops.clear();
+    }
+
+    EventLoop* EventLoopPool::next()
+    {
+        if (_loops.empty()) return nullptr;
+
+        return _loops[_next++ % _loops.size()].get();
+    }
+
+    size_t EventLoopPool::size() const
+    {
+        return _loops.size();
+    }
+
+    size_t EventLoopPool::getHandlersCount() const
+    {
+        size_t count = 0;
+        for (auto&& loop : _loops)
+        {
+            count += loop->getHandlersCount();
+        }
+        return count;
+    }
+} // namespace ix
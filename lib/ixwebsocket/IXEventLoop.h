@@ -0,0 +1,127 @@
+/*
+ *  IXEventLoop.h
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ix
+{
+    // Receives the readiness notifications of one socket registered on an EventLoop.
+    // All methods are invoked on the loop thread.
+    class EventLoopHandler
+    {
+    public:
+        virtual ~EventLoopHandler() = default;
+
+        // A hangup or an error is reported as readable, the next recv will tell which.
+        virtual void onEvents(bool readable, bool writable) = 0;
+
+        // Called every EventLoop::kTickIntervalMs, for timeouts and heartbeats.
+        virtual void onTick()
+        {
+        }
+
+        // The loop is going away while this handler is still registered.
+        virtual void onLoopStopped()
+        {
+        }
+    };
+
+    using EventLoopHandlerPtr = std::shared_ptr<EventLoopHandler>;
+
+    // A single threaded, level triggered epoll reactor.
+    //
+    // post() and the const accessors are thread safe, everything else must be
+    // called on the loop thread (from a handler or from a posted task).
+    class EventLoop
+    {
+    public:
+        using Task = std::function<void()>;
+        using HandlerId = uint64_t;
+
+        EventLoop();
+        ~EventLoop();
+
+        bool init(std::string& errorMsg);
+        void start(const std::string& threadName);
+
+        // Let the registered handlers finish for at most drainTimeoutMs, then
+        // notify the remaining ones and join the loop thread.
+        void stop(int drainTimeoutMs);
+        void requestStop(int drainTimeoutMs);
+        void join();
+
+        bool post(Task task);
+        bool isInLoopThread() const;
+        size_t getHandlersCount() const;
+
+        // Returns 0 if the descriptor could not be registered
+        HandlerId add(int fd, bool wantWrite, const EventLoopHandlerPtr& handler);
+        bool setWantWrite(HandlerId id, bool wantWrite);
+        void remove(HandlerId id);
+        bool isStopping() const;
+
+        const static int kTickIntervalMs;
+
+    private:
+        struct Registration
+        {
+            int fd;
+            EventLoopHandlerPtr handler;
+        };
+
+        void run(std::string threadName);
+        void runPostedTasks();
+        void runTicks();
+        void notifyStopped();
+
+        int _epollFd;
+        int _wakeUpFd;
+
+        std::thread _thread;
+        std::atomic<std::thread::id> _threadId;
+
+        std::mutex _tasksMutex;
+        std::vector<Task> _tasks;
+
+        // Only touched on the loop thread, except for the atomic count
+        std::map<HandlerId, Registration> _handlers;
+        HandlerId _nextHandlerId;
+        std::atomic<size_t> _handlersCount;
+
+        bool _stopping;
+        std::chrono::steady_clock::time_point _stopDeadline;
+
+        const static HandlerId kWakeUpHandlerId;
+        const static int kMaxEventsPerWait;
+    };
+
+    // A fixed set of event loops, connections are spread over them round robin.
+    class EventLoopPool
+    {
+    public:
+        bool start(size_t loopCount, const std::string& threadNamePrefix, std::string& errorMsg);
+        void stop(int drainTimeoutMs);
+
+        EventLoop* next();
+        size_t size() const;
+        size_t getHandlersCount() const;
+
+    private:
+        std::vector<std::unique_ptr<EventLoop>> _loops;
+        std::atomic<size_t> _next {0};
+    };
+} // namespace ix
@@ -8,6 +8,7 @@
 
 #include "IXGzipCodec.h"
 #include "IXNetSystem.h"
+#include "IXSocketEventLoop.h"
 #include "IXSocketConnect.h"
 #include "IXUserAgent.h"
 #include <cstdint>
@@ -114,6 +115,35 @@ namespace ix
         connectionState->setTerminated();
     }
 
+    void HttpServer::handleConnectionOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                 std::shared_ptr<ConnectionState> connectionState,
+                                                 EventLoop& loop)
+    {
+        // The request is already buffered, only a large response can block the loop
+        std::unique_ptr<Socket> httpSocket(std::move(socket));
+        auto ret = Http::parseRequest(httpSocket, _timeoutSecs);
+
+        if (std::get<0>(ret))
+        {
+            auto request = std::get<2>(ret);
+            if (request->headers["Upgrade"] == "websocket")
+            {
+                std::unique_ptr<SocketEventLoop> webSocketSocket(
+                    static_cast<SocketEventLoop*>(httpSocket.release()));
+                WebSocketServer::handleUpgradeOnEventLoop(
+                    std::move(webSocketSocket), connectionState, loop, request);
+                return;
+            }
+
+            auto response = _onConnectionCallback(request, connectionState);
+            if (!Http::sendResponse(response, httpSocket))
+            {
+                logError("Cannot send response");
+            }
+        }
+        connectionState->setTerminated();
+    }
+
     void HttpServer::setDefaultConnectionCallback()
     {
         setOnConnectionCallback(
@@ -51,6 +51,9 @@ namespace ix
         // Methods
         virtual void handleConnection(std::unique_ptr<Socket>,
                                       std::shared_ptr<ConnectionState> connectionState) final;
+        virtual void handleConnectionOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                 std::shared_ptr<ConnectionState> connectionState,
+                                                 EventLoop& loop) final;
 
         void setDefaultConnectionCallback();
     };
@@ -0,0 +1,25 @@
+/*
+ *  IXSelectInterruptEventLoop.cpp
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#include "IXSelectInterruptEventLoop.h"
+
+namespace ix
+{
+    bool SelectInterruptEventLoop::notify(uint64_t value)
+    {
+        std::lock_guard<std::mutex> lock(_onNotifyCallbackMutex);
+        if (!_onNotifyCallback) return false;
+
+        _onNotifyCallback(value);
+        return true;
+    }
+
+    void SelectInterruptEventLoop::setOnNotifyCallback(const OnNotifyCallback& callback)
+    {
+        std::lock_guard<std::mutex> lock(_onNotifyCallbackMutex);
+        _onNotifyCallback = callback;
+    }
+} // namespace ix
@@ -0,0 +1,34 @@
+/*
+ *  IXSelectInterruptEventLoop.h
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#pragma once
+
+#include "IXSelectInterrupt.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace ix
+{
+    // Sockets owned by an EventLoop are never blocked in poll(), so wake up
+    // requests (send / close) are forwarded to a callback which schedules the
+    // work on the loop thread instead of being written to a pipe.
+    class SelectInterruptEventLoop final : public SelectInterrupt
+    {
+    public:
+        using OnNotifyCallback = std::function<void(uint64_t value)>;
+
+        bool notify(uint64_t value) final;
+
+        // Once this returns with a null callback, no notification is in flight.
+        void setOnNotifyCallback(const OnNotifyCallback& callback);
+
+    private:
+        OnNotifyCallback _onNotifyCallback;
+        std::mutex _onNotifyCallbackMutex;
+    };
+} // namespace ix
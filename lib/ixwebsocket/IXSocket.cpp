@@ -20,6 +20,10 @@
 #include <sys/types.h>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #ifdef min
 #undef min
 #endif
@@ -28,6 +32,8 @@ namespace ix
 {
     const int Socket::kDefaultPollNoTimeout = -1; // No poll timeout by default
     const int Socket::kDefaultPollTimeout = kDefaultPollNoTimeout;
+    constexpr size_t Socket::kMaxSendBuffers;
+    const size_t Socket::kCoalescedSendSize = 16 * 1024; // One TLS record
 
     Socket::Socket(int fd)
         : _sockfd(fd)
@@ -255,6 +261,55 @@ namespace ix
         return send((char*) &buffer[0], buffer.size());
     }
 
+    ssize_t Socket::sendv(const SendBuffer* buffers, size_t count)
+    {
+#ifdef _WIN32
+        return sendCoalesced(buffers, count);
+#else
+        std::array<struct iovec, kMaxSendBuffers> iov;
+        count = std::min(count, kMaxSendBuffers);
+        for (size_t i = 0; i < count; ++i)
+        {
+            iov[i].iov_base = const_cast<char*>(buffers[i].data);
+            iov[i].iov_len = buffers[i].size;
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov.data();
+        message.msg_iovlen = count;
+
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL;
+#endif
+
+        return ::sendmsg(_sockfd, &message, flags);
+#endif
+    }
+
+    ssize_t Socket::sendCoalesced(const SendBuffer* buffers, size_t count)
+    {
+        if (count == 0) return 0;
+
+        // A large leading buffer is sent as is
+        if (count == 1 || buffers[0].size >= kCoalescedSendSize)
+        {
+            return send(const_cast<char*>(buffers[0].data), buffers[0].size);
+        }
+
+        // Only used on the calling thread, between two sends
+        static thread_local std::vector<char> coalesced;
+        coalesced.clear();
+        for (size_t i = 0; i < count && coalesced.size() < kCoalescedSendSize; ++i)
+        {
+            size_t size = std::min(buffers[i].size, kCoalescedSendSize - coalesced.size());
+            coalesced.insert(coalesced.end(), buffers[i].data, buffers[i].data + size);
+        }
+
+        return send(coalesced.data(), coalesced.size());
+    }
+
     ssize_t Socket::recv(void* buffer, size_t length)
     {
         int flags = 0;
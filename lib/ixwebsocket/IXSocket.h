@@ -36,6 +36,13 @@ namespace ix
         CloseRequest = 5
     };
 
+    // One contiguous part of a gathered send
+    struct SendBuffer
+    {
+        const char* data;
+        size_t size;
+    };
+
     class Socket
     {
     public:
@@ -64,6 +71,10 @@ namespace ix
         ssize_t send(const std::string& buffer);
         virtual ssize_t recv(void* buffer, size_t length);
 
+        // Gathered send of up to kMaxSendBuffers buffers, a single sendmsg on plain sockets
+        virtual ssize_t sendv(const SendBuffer* buffers, size_t count);
+        static constexpr size_t kMaxSendBuffers = 64;
+
         // Blocking and cancellable versions, working with socket that can be set
         // to non blocking mode. Used during HTTP upgrade.
         bool readByte(void* buffer, const CancellationRequest& isCancellationRequested);
@@ -91,10 +102,16 @@ namespace ix
         static bool readSelectInterruptRequest(const SelectInterruptPtr& selectInterrupt,
                                                PollResultType* pollResult);
 
+        SelectInterruptPtr _selectInterrupt;
+
+        // For sockets which cannot gather (TLS): copy the leading buffers into one
+        // record sized chunk and send it with send()
+        ssize_t sendCoalesced(const SendBuffer* buffers, size_t count);
+
     private:
+        static const size_t kCoalescedSendSize;
+
         static const int kDefaultPollTimeout;
         static const int kDefaultPollNoTimeout;
-
-        SelectInterruptPtr _selectInterrupt;
     };
 } // namespace ix
@@ -281,6 +281,11 @@ namespace ix
     }
 
     // No wait support
+    ssize_t SocketAppleSSL::sendv(const SendBuffer* buffers, size_t count)
+    {
+        return sendCoalesced(buffers, count);
+    }
+
     ssize_t SocketAppleSSL::recv(void* buf, size_t nbyte)
     {
         OSStatus status = errSSLWouldBlock;
@@ -0,0 +1,56 @@
+/*
+ *  IXSocketEventLoop.cpp
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#include "IXSocketEventLoop.h"
+
+#include "IXNetSystem.h"
+#include "IXUniquePtr.h"
+
+namespace ix
+{
+    SocketEventLoop::SocketEventLoop(int fd)
+        : Socket(fd)
+        , _pollFd(fd)
+    {
+        auto selectInterrupt = ix::make_unique<SelectInterruptEventLoop>();
+        _selectInterruptEventLoop = selectInterrupt.get();
+        _selectInterrupt = std::move(selectInterrupt);
+    }
+
+    SocketEventLoop::~SocketEventLoop()
+    {
+        setOnWakeUpCallback(nullptr);
+
+        std::lock_guard<std::mutex> lock(_socketMutex);
+        closeSocket(_pollFd);
+        _sockfd = -1;
+    }
+
+    void SocketEventLoop::close()
+    {
+        std::lock_guard<std::mutex> lock(_socketMutex);
+
+        if (_sockfd == -1) return;
+
+#ifdef _WIN32
+        ::shutdown(_sockfd, SD_BOTH);
+#else
+        ::shutdown(_sockfd, SHUT_RDWR);
+#endif
+        _sockfd = -1;
+    }
+
+    int SocketEventLoop::getPollFd() const
+    {
+        return _pollFd;
+    }
+
+    void SocketEventLoop::setOnWakeUpCallback(
+        const SelectInterruptEventLoop::OnNotifyCallback& callback)
+    {
+        _selectInterruptEventLoop->setOnNotifyCallback(callback);
+    }
+} // namespace ix
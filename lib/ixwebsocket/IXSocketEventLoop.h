@@ -0,0 +1,38 @@
+/*
+ *  IXSocketEventLoop.h
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#pragma once
+
+#include "IXSelectInterruptEventLoop.h"
+#include "IXSocket.h"
+
+namespace ix
+{
+    // A plain TCP socket registered on an EventLoop.
+    //
+    // close() may be called from any thread while the descriptor is still in the
+    // loop's epoll set. Closing the descriptor right away would let the kernel
+    // recycle its number for the next accepted connection, so close() only shuts
+    // the connection down (which the loop sees as a hangup) and the descriptor
+    // itself is released on destruction, after the loop has unregistered it.
+    class SocketEventLoop final : public Socket
+    {
+    public:
+        SocketEventLoop(int fd);
+        ~SocketEventLoop();
+
+        void close() final;
+
+        // The descriptor to register on the loop, valid for the socket lifetime
+        int getPollFd() const;
+
+        void setOnWakeUpCallback(const SelectInterruptEventLoop::OnNotifyCallback& callback);
+
+    private:
+        int _pollFd;
+        SelectInterruptEventLoop* _selectInterruptEventLoop;
+    };
+} // namespace ix
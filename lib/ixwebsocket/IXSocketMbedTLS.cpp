@@ -339,6 +339,11 @@ namespace ix
         }
     }
 
+    ssize_t SocketMbedTLS::sendv(const SendBuffer* buffers, size_t count)
+    {
+        return sendCoalesced(buffers, count);
+    }
+
     ssize_t SocketMbedTLS::recv(void* buf, size_t nbyte)
     {
         while (true)
@@ -37,6 +37,7 @@ namespace ix
 
         virtual ssize_t send(char* buffer, size_t length) final;
         virtual ssize_t recv(void* buffer, size_t length) final;
+        virtual ssize_t sendv(const SendBuffer* buffers, size_t count) final;
 
     private:
         mbedtls_ssl_context _ssl;
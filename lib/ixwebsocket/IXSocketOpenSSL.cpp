@@ -834,6 +834,11 @@ namespace ix
         }
     }
 
+    ssize_t SocketOpenSSL::sendv(const SendBuffer* buffers, size_t count)
+    {
+        return sendCoalesced(buffers, count);
+    }
+
     ssize_t SocketOpenSSL::recv(void* buf, size_t nbyte)
     {
         while (true)
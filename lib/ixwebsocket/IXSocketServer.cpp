@@ -6,17 +6,24 @@
 
 #include "IXSocketServer.h"
 
+#include "IXEventLoop.h"
 #include "IXNetSystem.h"
 #include "IXSelectInterrupt.h"
 #include "IXSelectInterruptFactory.h"
 #include "IXSetThreadName.h"
 #include "IXSocket.h"
 #include "IXSocketConnect.h"
+#include "IXSocketEventLoop.h"
 #include "IXSocketFactory.h"
+#include "IXStrCaseCompare.h"
+#include "IXUniquePtr.h"
 #include <assert.h>
+#include <chrono>
 #include <sstream>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 namespace ix
 {
@@ -25,6 +32,153 @@ namespace ix
     const int SocketServer::kDefaultTcpBacklog(5);
     const size_t SocketServer::kDefaultMaxConnections(128);
     const int SocketServer::kDefaultAddressFamily(AF_INET);
+    const int SocketServer::kEventLoopDrainTimeoutMs(1000);
+    const int SocketServer::kDefaultEventLoopRequestTimeoutSecs(30);
+    const size_t SocketServer::kMaxPendingRequestSize(16 * 1024);
+
+    //
+    // A connection accepted in event loop mode, waiting on its loop until the
+    // request is complete. Data is only peeked, so the socket is handed over
+    // exactly as it was received.
+    //
+    class SocketServer::PendingRequest final
+        : public EventLoopHandler
+        , public std::enable_shared_from_this<SocketServer::PendingRequest>
+    {
+    public:
+        PendingRequest(SocketServer& server,
+                       std::unique_ptr<SocketEventLoop> socket,
+                       std::shared_ptr<ConnectionState> connectionState,
+                       EventLoop& loop,
+                       std::chrono::steady_clock::time_point deadline)
+            : _server(server)
+            , _socket(std::move(socket))
+            , _connectionState(connectionState)
+            , _loop(loop)
+            , _deadline(deadline)
+            , _id(0)
+        {
+        }
+
+        void attach()
+        {
+            _id = _loop.add(_socket->getPollFd(), false, shared_from_this());
+            if (_id == 0)
+            {
+                _server.logError("SocketServer: cannot register connection on event loop");
+                discard();
+            }
+        }
+
+        void onEvents(bool /*readable*/, bool /*writable*/) final
+        {
+            thread_local std::vector<char> buffer(kMaxPendingRequestSize);
+            ssize_t ret = ::recv(_socket->getPollFd(), &buffer[0], buffer.size(), MSG_PEEK);
+
+            if (ret < 0 && Socket::isWaitNeeded())
+            {
+                return;
+            }
+            else if (ret <= 0)
+            {
+                discard();
+                return;
+            }
+
+            // The loop only hands over requests it fully peeked, the parser
+            // then never waits for data. Larger ones are refused rather than
+            // parsed with a blocking read that would stall every connection
+            // of the loop.
+            int status = getRequestStatus(&buffer[0], (size_t) ret, buffer.size());
+            if (status == 200)
+            {
+                _loop.remove(_id);
+                _server.handleConnectionOnEventLoop(std::move(_socket), _connectionState, _loop);
+            }
+            else if (status != 0)
+            {
+                reject(status);
+            }
+        }
+
+        void onTick() final
+        {
+            if (_loop.isStopping() || std::chrono::steady_clock::now() > _deadline)
+            {
+                discard();
+            }
+        }
+
+        void onLoopStopped() final
+        {
+            discard();
+        }
+
+    private:
+        // 200 once the request head is complete, and so is the body if it has
+        // a Content-Length, 0 while more data is needed, 431 or 413 if the
+        // head or the whole request cannot fit in capacity bytes
+        static int getRequestStatus(const char* data, size_t size, size_t capacity)
+        {
+            std::string head(data, size);
+            auto headEnd = head.find("\r\n\r\n");
+            if (headEnd == std::string::npos) return size >= capacity ? 431 : 0;
+
+            size_t contentLength = 0;
+            size_t lineStart = head.find("\r\n") + 2;
+            while (lineStart < headEnd)
+            {
+                size_t lineEnd = head.find("\r\n", lineStart);
+                size_t colon = head.find(':', lineStart);
+                if (colon != std::string::npos && colon < lineEnd)
+                {
+                    std::string name = head.substr(lineStart, colon - lineStart);
+                    if (!CaseInsensitiveLess::cmp(name, "Content-Length") &&
+                        !CaseInsensitiveLess::cmp("Content-Length", name))
+                    {
+                        contentLength = strtoul(head.c_str() + colon + 1, nullptr, 10);
+                    }
+                }
+                lineStart = lineEnd + 2;
+            }
+
+            if (contentLength > capacity - (headEnd + 4)) return 413;
+            return size >= headEnd + 4 + contentLength ? 200 : 0;
+        }
+
+        // Answer with an error status and close. The reply is small enough
+        // for the socket buffer, it is sent once without waiting. What was
+        // received is read first, so that closing does not reset the
+        // connection before the peer reads the reply.
+        void reject(int status)
+        {
+            char discarded[4096];
+            while (::recv(_socket->getPollFd(), discarded, sizeof(discarded), MSG_DONTWAIT) > 0)
+            {
+            }
+
+            std::stringstream ss;
+            ss << "HTTP/1.1 " << status << " "
+               << (status == 431 ? "Request Header Fields Too Large" : "Payload Too Large")
+               << "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            _socket->send(ss.str());
+            discard();
+        }
+
+        void discard()
+        {
+            _loop.remove(_id);
+            _socket.reset();
+            _connectionState->setTerminated();
+        }
+
+        SocketServer& _server;
+        std::unique_ptr<SocketEventLoop> _socket;
+        std::shared_ptr<ConnectionState> _connectionState;
+        EventLoop& _loop;
+        std::chrono::steady_clock::time_point _deadline;
+        EventLoop::HandlerId _id;
+    };
 
     SocketServer::SocketServer(
         int port, const std::string& host, int backlog, size_t maxConnections, int addressFamily)
@@ -38,6 +192,8 @@ namespace ix
         , _stopGc(false)
         , _connectionStateFactory(&ConnectionState::createConnectionState)
         , _acceptSelectInterrupt(createSelectInterrupt())
+        , _useEventLoops(false)
+        , _eventLoopCount(0)
     {
     }
 
@@ -177,6 +333,8 @@ namespace ix
     {
         _stop = false;
 
+        startEventLoops();
+
         if (!_thread.joinable())
         {
             _thread = std::thread(&SocketServer::run, this);
@@ -215,6 +373,13 @@ namespace ix
             _stop = false;
         }
 
+        // Let the connections on the loops finish their closing handshake
+        if (_eventLoopPool)
+        {
+            _eventLoopPool->stop(kEventLoopDrainTimeoutMs);
+            _eventLoopPool.reset();
+        }
+
         // Join all threads and make sure that all connections are terminated
         if (_gcThread.joinable())
         {
@@ -393,6 +558,13 @@ namespace ix
 
             if (_stop) return;
 
+            if (_eventLoopPool)
+            {
+                SocketConnect::configure(clientFd);
+                handOffToEventLoop(ix::make_unique<SocketEventLoop>(clientFd), connectionState);
+                continue;
+            }
+
             // create socket
             std::string errorMsg;
             bool tls = _socketTLSOptions.tls;
@@ -468,6 +640,65 @@ namespace ix
         _socketTLSOptions = socketTLSOptions;
     }
 
+    void SocketServer::enableEventLoops(size_t loopCount)
+    {
+        _useEventLoops = true;
+        _eventLoopCount = loopCount;
+    }
+
+    void SocketServer::startEventLoops()
+    {
+        if (!_useEventLoops || _eventLoopPool) return;
+
+        if (_socketTLSOptions.tls)
+        {
+            logInfo("SocketServer: event loops do not support TLS, "
+                    "using one thread per connection");
+            return;
+        }
+
+        std::string errorMsg;
+        auto eventLoopPool = ix::make_unique<EventLoopPool>();
+        if (!eventLoopPool->start(_eventLoopCount, "Srv:ev:" + std::to_string(_port) + ":", errorMsg))
+        {
+            logError("SocketServer: cannot start event loops, using one thread per connection: " +
+                     errorMsg);
+            return;
+        }
+
+        _eventLoopPool = std::move(eventLoopPool);
+    }
+
+    void SocketServer::handOffToEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                          std::shared_ptr<ConnectionState> connectionState)
+    {
+        EventLoop* loop = _eventLoopPool->next();
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::seconds(getEventLoopRequestTimeoutSecs());
+
+        // std::function needs a copyable closure
+        auto socketHolder = std::make_shared<std::unique_ptr<SocketEventLoop>>(std::move(socket));
+        loop->post(
+            [this, loop, socketHolder, connectionState, deadline]
+            {
+                auto pendingRequest = std::make_shared<PendingRequest>(
+                    *this, std::move(*socketHolder), connectionState, *loop, deadline);
+                pendingRequest->attach();
+            });
+    }
+
+    void SocketServer::handleConnectionOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                   std::shared_ptr<ConnectionState> connectionState,
+                                                   EventLoop& /*loop*/)
+    {
+        handleConnection(std::move(socket), connectionState);
+    }
+
+    int SocketServer::getEventLoopRequestTimeoutSecs()
+    {
+        return kDefaultEventLoopRequestTimeoutSecs;
+    }
+
     void SocketServer::onSetTerminatedCallback()
     {
         // a connection got terminated, we can run the connection thread GC,
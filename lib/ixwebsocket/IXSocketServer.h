@@ -24,6 +24,9 @@
 namespace ix
 {
     class Socket;
+    class SocketEventLoop;
+    class EventLoop;
+    class EventLoopPool;
 
     class SocketServer
     {
@@ -60,6 +63,13 @@ namespace ix
 
         void setTLSOptions(const SocketTLSOptions& socketTLSOptions);
 
+        // Serve connections from a pool of epoll event loops instead of one thread
+        // per connection. Must be called before start(). loopCount == 0 means one
+        // loop per core. TLS connections, and platforms without epoll, keep using
+        // one thread per connection. Requests whose head and body exceed 16 KiB
+        // are answered with 431 or 413 in this mode.
+        void enableEventLoops(size_t loopCount = 0);
+
         int  getPort();
         std::string getHost();
         int getBacklog();
@@ -72,6 +82,20 @@ namespace ix
 
         void stopAcceptingConnections();
 
+        // Event loop mode: invoked on the loop thread once the whole request head
+        // (and its Content-Length body) has been received, so parsing it does not
+        // block. Implementations must not block the loop afterwards either. The
+        // default runs handleConnection() inline, which only suits servers that
+        // answer one request and return.
+        virtual void handleConnectionOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                 std::shared_ptr<ConnectionState> connectionState,
+                                                 EventLoop& loop);
+
+        // How long a connection may take to send its request in event loop mode
+        virtual int getEventLoopRequestTimeoutSecs();
+
+        const static int kEventLoopDrainTimeoutMs;
+
     private:
         // Member variables
         int _port;
@@ -127,5 +151,17 @@ namespace ix
         std::condition_variable _conditionVariableGC;
         std::mutex _conditionVariableMutexGC;
         bool _canContinueGC{ false };
+
+        // event loop mode
+        class PendingRequest;
+        bool _useEventLoops;
+        size_t _eventLoopCount;
+        std::unique_ptr<EventLoopPool> _eventLoopPool;
+        void startEventLoops();
+        void handOffToEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                std::shared_ptr<ConnectionState> connectionState);
+
+        const static int kDefaultEventLoopRequestTimeoutSecs;
+        const static size_t kMaxPendingRequestSize;
     };
 } // namespace ix
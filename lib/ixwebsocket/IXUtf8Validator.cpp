@@ -0,0 +1,95 @@
+/*
+ *  IXUtf8Validator.cpp
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#include "IXUtf8Validator.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define IXWEBSOCKET_UTF8_X86
+#include <immintrin.h>
+#endif
+
+namespace ix
+{
+    namespace
+    {
+        using CountFunction = size_t (*)(const uint8_t* data, size_t size);
+
+        size_t countLeadingAsciiWord(const uint8_t* data, size_t size)
+        {
+            const uint64_t highBits = 0x8080808080808080ull;
+
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t word;
+                memcpy(&word, data + i, sizeof(word));
+                if (word & highBits) break;
+            }
+
+            while (i != size && data[i] < 0x80)
+            {
+                ++i;
+            }
+            return i;
+        }
+
+#ifdef IXWEBSOCKET_UTF8_X86
+        __attribute__((target("sse2"))) size_t countLeadingAsciiSSE2(const uint8_t* data,
+                                                                     size_t size)
+        {
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                int highBits = _mm_movemask_epi8(block);
+                if (highBits != 0)
+                {
+                    return i + __builtin_ctz((unsigned) highBits);
+                }
+            }
+
+            return i + countLeadingAsciiWord(data + i, size - i);
+        }
+
+        __attribute__((target("avx2"))) size_t countLeadingAsciiAVX2(const uint8_t* data,
+                                                                     size_t size)
+        {
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                int highBits = _mm256_movemask_epi8(block);
+                if (highBits != 0)
+                {
+                    return i + __builtin_ctz((unsigned) highBits);
+                }
+            }
+
+            // See IXWebSocketMask.cpp, no vzeroupper is emitted before a tail call
+            _mm256_zeroupper();
+            return i + countLeadingAsciiSSE2(data + i, size - i);
+        }
+#endif
+
+        CountFunction selectCountFunction()
+        {
+#ifdef IXWEBSOCKET_UTF8_X86
+            if (__builtin_cpu_supports("avx2")) return countLeadingAsciiAVX2;
+            if (__builtin_cpu_supports("sse2")) return countLeadingAsciiSSE2;
+#endif
+            return countLeadingAsciiWord;
+        }
+    } // namespace
+
+    size_t countLeadingAscii(const uint8_t* data, size_t size)
+    {
+        static const CountFunction countFunction = selectCountFunction();
+
+        return countFunction(data, size);
+    }
+} // namespace ix
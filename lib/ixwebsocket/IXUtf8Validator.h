@@ -36,8 +36,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace ix
 {
@@ -92,6 +94,10 @@ namespace ix
         return *state;
     }
 
+    /// Count the leading ASCII bytes of a buffer, 16 or 32 bytes at a time when
+    /// the CPU supports it (see IXUtf8Validator.cpp)
+    size_t countLeadingAscii(const uint8_t* data, size_t size);
+
     /// Provides streaming UTF8 validation functionality
     class Utf8Validator
     {
@@ -139,6 +145,37 @@ namespace ix
             return true;
         }
 
+        /// Advance Validator state with a buffer
+        /**
+         * ASCII runs are skipped with countLeadingAscii while the validator is between
+         * codepoints, the state machine only runs over multibyte sequences. The buffer
+         * may end in the middle of a codepoint, so fragments can be fed one by one.
+         *
+         * @param s The bytes to advance the validation state with
+         * @return Whether or not decoding the bytes resulted in a validation error.
+         */
+        bool decode(std::string_view s)
+        {
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(s.data());
+            size_t size = s.size();
+            size_t i = 0;
+
+            while (i != size)
+            {
+                if (m_state == utf8_accept && data[i] < 0x80)
+                {
+                    i += countLeadingAscii(data + i, size - i);
+                    if (i == size) break;
+                }
+
+                if (decodeNextByte(&m_state, &m_codepoint, data[i++]) == utf8_reject)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
         /// Return whether the input sequence ended on a valid utf8 codepoint
         /**
          * @return Whether or not the input sequence ended on a valid codepoint.
@@ -165,10 +202,10 @@ namespace ix
      * convenience function that creates a Validator, validates a complete string
      * and returns the result.
      */
-    inline bool validateUtf8(std::string const& s)
+    inline bool validateUtf8(std::string_view s)
     {
         Utf8Validator v;
-        if (!v.decode(s.begin(), s.end()))
+        if (!v.decode(s))
         {
             return false;
         }
@@ -39,6 +39,7 @@ namespace ix
         , _minWaitBetweenReconnectionRetries(kDefaultMinWaitBetweenReconnectionRetries)
         , _handshakeTimeoutSecs(kDefaultHandShakeTimeoutSecs)
         , _enablePong(kDefaultEnablePong)
+        , _zeroCopyDelivery(false)
         , _pingIntervalSecs(kDefaultPingIntervalSecs)
         , _pingType(SendMessageKind::Ping)
         , _autoThreadName(true)
@@ -104,6 +105,11 @@ namespace ix
         return _perMessageDeflateOptions;
     }
 
+    const WebSocketPerMessageDeflateOptions WebSocket::getNegotiatedPerMessageDeflateOptions() const
+    {
+        return _ws.getPerMessageDeflateOptions();
+    }
+
     void WebSocket::setPingMessage(const std::string& sendMessage, SendMessageKind pingType)
     {
         std::lock_guard<std::mutex> lock(_configMutex);
@@ -139,6 +145,16 @@ namespace ix
         _enablePong = false;
     }
 
+    void WebSocket::enableZeroCopyDelivery()
+    {
+        _zeroCopyDelivery = true;
+    }
+
+    void WebSocket::disableZeroCopyDelivery()
+    {
+        _zeroCopyDelivery = false;
+    }
+
     void WebSocket::enablePerMessageDeflate()
     {
         std::lock_guard<std::mutex> lock(_configMutex);
@@ -258,14 +274,16 @@ namespace ix
                                                    bool enablePerMessageDeflate,
                                                    HttpRequestPtr request)
     {
+        std::vector<std::string> subProtocols;
         {
             std::lock_guard<std::mutex> lock(_configMutex);
             _ws.configure(
                 _perMessageDeflateOptions, _socketTLSOptions, _enablePong, _pingIntervalSecs);
+            subProtocols = _subProtocols;
         }
 
-        WebSocketInitResult status =
-            _ws.connectToSocket(std::move(socket), timeoutSecs, enablePerMessageDeflate, request);
+        WebSocketInitResult status = _ws.connectToSocket(
+            std::move(socket), timeoutSecs, enablePerMessageDeflate, request, subProtocols);
         if (!status.success)
         {
             return status;
@@ -276,7 +294,8 @@ namespace ix
                                               emptyMsg,
                                               0,
                                               WebSocketErrorInfo(),
-                                              WebSocketOpenInfo(status.uri, status.headers),
+                                              WebSocketOpenInfo(
+                                                  status.uri, status.headers, status.protocol),
                                               WebSocketCloseInfo()));
 
         if (_pingIntervalSecs > 0)
@@ -398,60 +417,98 @@ namespace ix
             WebSocketTransport::PollResult pollResult = _ws.poll();
 
             // 3. Dispatch the incoming messages
-            _ws.dispatch(
-                pollResult,
-                [this](const std::string& msg,
-                       size_t wireSize,
-                       bool decompressionError,
-                       WebSocketTransport::MessageKind messageKind)
+            dispatchMessages(pollResult);
+
+            // 4. Let the owner run deferred work on this thread (e.g. drain a send queue)
+            if (_onPollCallback)
+            {
+                _onPollCallback();
+            }
+        }
+    }
+
+    void WebSocket::dispatchMessages(WebSocketTransport::PollResult pollResult)
+    {
+        _ws.dispatch(
+            pollResult,
+            [this](std::string_view msg,
+                   size_t wireSize,
+                   bool decompressionError,
+                   WebSocketTransport::MessageKind messageKind)
+            {
+                WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
+                switch (messageKind)
                 {
-                    WebSocketMessageType webSocketMessageType {WebSocketMessageType::Error};
-                    switch (messageKind)
+                    case WebSocketTransport::MessageKind::MSG_TEXT:
+                    case WebSocketTransport::MessageKind::MSG_BINARY:
                     {
-                        case WebSocketTransport::MessageKind::MSG_TEXT:
-                        case WebSocketTransport::MessageKind::MSG_BINARY:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Message;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PING:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Ping;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::PONG:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Pong;
-                        }
-                        break;
-
-                        case WebSocketTransport::MessageKind::FRAGMENT:
-                        {
-                            webSocketMessageType = WebSocketMessageType::Fragment;
-                        }
-                        break;
+                        webSocketMessageType = WebSocketMessageType::Message;
                     }
+                    break;
 
-                    WebSocketErrorInfo webSocketErrorInfo;
-                    webSocketErrorInfo.decompressionError = decompressionError;
+                    case WebSocketTransport::MessageKind::PING:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Ping;
+                    }
+                    break;
 
-                    bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
+                    case WebSocketTransport::MessageKind::PONG:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Pong;
+                    }
+                    break;
 
+                    case WebSocketTransport::MessageKind::FRAGMENT:
+                    {
+                        webSocketMessageType = WebSocketMessageType::Fragment;
+                    }
+                    break;
+                }
+
+                WebSocketErrorInfo webSocketErrorInfo;
+                webSocketErrorInfo.decompressionError = decompressionError;
+
+                bool binary = messageKind == WebSocketTransport::MessageKind::MSG_BINARY;
+
+                if (_zeroCopyDelivery)
+                {
+                    _onMessageCallback(ix::make_unique<WebSocketMessage>(
+                        webSocketMessageType, msg, wireSize, webSocketErrorInfo, binary));
+                }
+                else
+                {
+                    std::string str(msg);
                     _onMessageCallback(ix::make_unique<WebSocketMessage>(webSocketMessageType,
-                                                                         msg,
+                                                                         str,
                                                                          wireSize,
                                                                          webSocketErrorInfo,
                                                                          WebSocketOpenInfo(),
                                                                          WebSocketCloseInfo(),
                                                                          binary));
+                }
+
+                WebSocket::invokeTrafficTrackerCallback(wireSize, true);
+            });
+    }
+
+    void WebSocket::handleSocketEvents(bool readable, bool writable, bool closeRequested)
+    {
+        WebSocketTransport::PollResult pollResult =
+            _ws.handleSocketEvents(readable, writable, closeRequested);
+
+        dispatchMessages(pollResult);
 
-                    WebSocket::invokeTrafficTrackerCallback(wireSize, true);
-                });
+        if (_onPollCallback)
+        {
+            _onPollCallback();
         }
     }
 
+    void WebSocket::setBlockingSend(bool blockingSend)
+    {
+        _ws.setBlockingSend(blockingSend);
+    }
+
     void WebSocket::setOnMessageCallback(const OnMessageCallback& callback)
     {
         _onMessageCallback = callback;
@@ -462,6 +519,18 @@ namespace ix
         return _onMessageCallback != nullptr;
     }
 
+    void WebSocket::setOnPollCallback(const OnPollCallback& callback)
+    {
+        _onPollCallback = callback;
+    }
+
+    bool WebSocket::wakeUp()
+    {
+        if (!isConnected()) return false;
+
+        return _ws.requestWakeUp();
+    }
+
     void WebSocket::setTrafficTrackerCallback(const OnTrafficTrackerCallback& callback)
     {
         _onTrafficTrackerCallback = callback;
@@ -576,6 +645,45 @@ namespace ix
         return webSocketSendInfo;
     }
 
+    bool WebSocket::canSendPrecompressed(uint8_t windowBits) const
+    {
+        return _ws.canSendPrecompressed(windowBits);
+    }
+
+    WebSocketSendInfo WebSocket::sendPrecompressed(const IXWebSocketSendData& data,
+                                                   uint8_t windowBits,
+                                                   bool binary)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+        WebSocketSendInfo webSocketSendInfo = _ws.sendPrecompressed(data, windowBits, binary);
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
+    std::string WebSocket::encodeFrames(const IXWebSocketSendData& data,
+                                        bool binary,
+                                        bool compressed)
+    {
+        return WebSocketTransport::encodeFrames(data, binary, compressed);
+    }
+
+    WebSocketSendInfo WebSocket::sendEncodedFrames(const std::shared_ptr<const std::string>& frames,
+                                                   uint8_t windowBits)
+    {
+        if (!isConnected()) return WebSocketSendInfo(false);
+
+        std::lock_guard<std::mutex> lock(_writeMutex);
+        WebSocketSendInfo webSocketSendInfo = _ws.sendEncodedFrames(frames, windowBits);
+
+        WebSocket::invokeTrafficTrackerCallback(webSocketSendInfo.wireSize, false);
+
+        return webSocketSendInfo;
+    }
+
     ReadyState WebSocket::getReadyState() const
     {
         switch (_ws.getReadyState())
@@ -41,6 +41,8 @@ namespace ix
 
     using OnTrafficTrackerCallback = std::function<void(size_t size, bool incoming)>;
 
+    using OnPollCallback = std::function<void()>;
+
     class WebSocket
     {
     public:
@@ -59,6 +61,11 @@ namespace ix
         void setPingInterval(int pingIntervalSecs);
         void enablePong();
         void disablePong();
+
+        // Deliver received data as WebSocketMessage::view, pointing into the receive
+        // buffer and only valid during the callback, instead of a copy in str.
+        void enableZeroCopyDelivery();
+        void disableZeroCopyDelivery();
         void enablePerMessageDeflate();
         void disablePerMessageDeflate();
         void addSubProtocol(const std::string& subProtocol);
@@ -93,11 +100,32 @@ namespace ix
                                    const OnProgressCallback& onProgressCallback = nullptr);
         WebSocketSendInfo ping(const std::string& text,SendMessageKind pingType = SendMessageKind::Ping);
 
+        // Send a message compressed by the caller with a fresh deflate stream, for
+        // instance once for all the clients of a broadcast. Fails, without sending,
+        // if the negotiated permessage-deflate parameters do not allow it.
+        bool canSendPrecompressed(uint8_t windowBits) const;
+        WebSocketSendInfo sendPrecompressed(const IXWebSocketSendData& data,
+                                            uint8_t windowBits,
+                                            bool binary = false);
+
+        // Server side: queue frames built once with encodeFrames for many connections.
+        // windowBits is 0 for uncompressed frames, see sendPrecompressed otherwise.
+        static std::string encodeFrames(const IXWebSocketSendData& data,
+                                        bool binary,
+                                        bool compressed);
+        WebSocketSendInfo sendEncodedFrames(const std::shared_ptr<const std::string>& frames,
+                                            uint8_t windowBits = 0);
+
         void close(uint16_t code = WebSocketCloseConstants::kNormalClosureCode,
                    const std::string& reason = WebSocketCloseConstants::kNormalClosureMessage);
 
         void setOnMessageCallback(const OnMessageCallback& callback);
         bool isOnMessageCallbackRegistered() const;
+
+        // Invoked from the run loop thread after each poll / dispatch cycle.
+        // wakeUp() can be called from any thread to force such a cycle.
+        void setOnPollCallback(const OnPollCallback& callback);
+        bool wakeUp();
         static void setTrafficTrackerCallback(const OnTrafficTrackerCallback& callback);
         static void resetTrafficTrackerCallback();
 
@@ -106,6 +134,8 @@ namespace ix
 
         const std::string getUrl() const;
         const WebSocketPerMessageDeflateOptions getPerMessageDeflateOptions() const;
+        // Result of the handshake, only meaningful once the connection is open
+        const WebSocketPerMessageDeflateOptions getNegotiatedPerMessageDeflateOptions() const;
         const std::string getPingMessage() const;
         int getPingInterval() const;
         size_t bufferedAmount() const;
@@ -137,6 +167,12 @@ namespace ix
                                             bool enablePerMessageDeflate,
                                             HttpRequestPtr request = nullptr);
 
+        // Server, event loop mode: replaces run() once connected. Never blocks.
+        void handleSocketEvents(bool readable, bool writable, bool closeRequested);
+        void setBlockingSend(bool blockingSend);
+
+        void dispatchMessages(WebSocketTransport::PollResult pollResult);
+
         WebSocketTransport _ws;
 
         std::string _url;
@@ -149,6 +185,7 @@ namespace ix
         mutable std::mutex _configMutex; // protect all config variables access
 
         OnMessageCallback _onMessageCallback;
+        OnPollCallback _onPollCallback;
         static OnTrafficTrackerCallback _onTrafficTrackerCallback;
 
         std::atomic<bool> _stop;
@@ -173,6 +210,8 @@ namespace ix
         bool _enablePong;
         static const bool kDefaultEnablePong;
 
+        std::atomic<bool> _zeroCopyDelivery;
+
         // Optional ping and pong timeout
         int _pingIntervalSecs;
         int _pingTimeoutSecs;
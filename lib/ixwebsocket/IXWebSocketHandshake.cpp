@@ -236,11 +236,15 @@ namespace ix
                 _enablePerMessageDeflate = false;
             }
             // Otherwise try to initialize the deflate engine (zlib)
-            else if (!_perMessageDeflate->init(webSocketPerMessageDeflateOptions))
+            else if (!_perMessageDeflate->init(webSocketPerMessageDeflateOptions, false))
             {
                 return WebSocketInitResult(
                     false, 0, "Failed to initialize per message deflate engine");
             }
+            else
+            {
+                _perMessageDeflateOptions = webSocketPerMessageDeflateOptions;
+            }
         }
 
         return WebSocketInitResult(true, status, "", headers, path);
@@ -248,7 +252,8 @@ namespace ix
 
     WebSocketInitResult WebSocketHandshake::serverHandshake(int timeoutSecs,
                                                             bool enablePerMessageDeflate,
-                                                            HttpRequestPtr request)
+                                                            HttpRequestPtr request,
+                                                            const std::vector<std::string>& subProtocols)
     {
         _requestInitCancellation = false;
 
@@ -369,14 +374,50 @@ namespace ix
         // If the client has requested that extension,
         if (webSocketPerMessageDeflateOptions.enabled() && enablePerMessageDeflate)
         {
-            _enablePerMessageDeflate = true;
+            // The server may ask for no context takeover on both sides even if the
+            // client did not offer it (RFC 7692 7.1.1). Without a context, idle
+            // connections do not hold zlib streams and a compressed message can be
+            // sent to several clients.
+            webSocketPerMessageDeflateOptions = WebSocketPerMessageDeflateOptions(
+                true,
+                webSocketPerMessageDeflateOptions.getClientNoContextTakeover() ||
+                    _perMessageDeflateOptions.getClientNoContextTakeover(),
+                webSocketPerMessageDeflateOptions.getServerNoContextTakeover() ||
+                    _perMessageDeflateOptions.getServerNoContextTakeover(),
+                webSocketPerMessageDeflateOptions.getClientMaxWindowBits(),
+                webSocketPerMessageDeflateOptions.getServerMaxWindowBits());
+
+            // Decline the extension if it cannot be honored (e.g. a 256 bytes window)
+            _enablePerMessageDeflate =
+                _perMessageDeflate->init(webSocketPerMessageDeflateOptions, true);
+
+            if (_enablePerMessageDeflate)
+            {
+                _perMessageDeflateOptions = webSocketPerMessageDeflateOptions;
+                ss << webSocketPerMessageDeflateOptions.generateHeader();
+            }
+        }
+        else
+        {
+            _enablePerMessageDeflate = false;
+        }
 
-            if (!_perMessageDeflate->init(webSocketPerMessageDeflateOptions))
+        // Sub Protocol strings are comma separated, in the client's order of preference
+        std::string subProtocol;
+        std::stringstream offeredSubProtocols(headers["sec-websocket-protocol"]);
+        std::string token;
+        while (subProtocol.empty() && std::getline(offeredSubProtocols, token, ','))
+        {
+            token = WebSocketPerMessageDeflateOptions::removeSpaces(token);
+            if (std::find(subProtocols.begin(), subProtocols.end(), token) != subProtocols.end())
             {
-                return WebSocketInitResult(
-                    false, 0, "Failed to initialize per message deflate engine");
+                subProtocol = token;
             }
-            ss << webSocketPerMessageDeflateOptions.generateHeader();
+        }
+
+        if (!subProtocol.empty())
+        {
+            ss << "Sec-WebSocket-Protocol: " << subProtocol << "\r\n";
         }
 
         ss << "\r\n";
@@ -387,6 +428,8 @@ namespace ix
                 false, 0, std::string("Failed sending response to remote end"));
         }
 
-        return WebSocketInitResult(true, 200, "", headers, uri);
+        WebSocketInitResult result(true, 200, "", headers, uri);
+        result.protocol = subProtocol;
+        return result;
     }
 } // namespace ix
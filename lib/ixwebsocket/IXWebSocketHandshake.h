@@ -17,6 +17,7 @@
 #include <chrono>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace ix
 {
@@ -37,9 +38,13 @@ namespace ix
                                             int port,
                                             int timeoutSecs);
 
-        WebSocketInitResult serverHandshake(int timeoutSecs,
-                                            bool enablePerMessageDeflate,
-                                            HttpRequestPtr request = nullptr);
+        // The first sub protocol offered by the client which is in subProtocols is
+        // accepted and returned in WebSocketInitResult::protocol
+        WebSocketInitResult serverHandshake(
+            int timeoutSecs,
+            bool enablePerMessageDeflate,
+            HttpRequestPtr request = nullptr,
+            const std::vector<std::string>& subProtocols = std::vector<std::string>());
 
     private:
         std::string genRandomString(const int len);
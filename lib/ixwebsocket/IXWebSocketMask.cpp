@@ -0,0 +1,166 @@
+/*
+ *  IXWebSocketMask.cpp
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#include "IXWebSocketMask.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define IXWEBSOCKET_MASK_X86
+#include <immintrin.h>
+#endif
+
+namespace ix
+{
+    namespace
+    {
+        void maskScalar(uint8_t* data, size_t size, const uint8_t maskingKey[4])
+        {
+            for (size_t i = 0; i != size; ++i)
+            {
+                data[i] ^= maskingKey[i & 0x3];
+            }
+        }
+
+        // The vector kernels only process multiples of 4 bytes, so the tail is
+        // still aligned with the start of the key.
+        void maskWord(uint8_t* data, size_t size, const uint8_t maskingKey[4])
+        {
+            uint8_t keyBytes[8];
+            memcpy(keyBytes, maskingKey, 4);
+            memcpy(keyBytes + 4, maskingKey, 4);
+            uint64_t key;
+            memcpy(&key, keyBytes, sizeof(key));
+
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                uint64_t word;
+                memcpy(&word, data + i, sizeof(word));
+                word ^= key;
+                memcpy(data + i, &word, sizeof(word));
+            }
+
+            maskScalar(data + i, size - i, maskingKey);
+        }
+
+#ifdef IXWEBSOCKET_MASK_X86
+        __attribute__((target("sse2"))) void maskSSE2(uint8_t* data,
+                                                     size_t size,
+                                                     const uint8_t maskingKey[4])
+        {
+            int32_t key32;
+            memcpy(&key32, maskingKey, sizeof(key32));
+            __m128i key = _mm_set1_epi32(key32);
+
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i* p = reinterpret_cast<__m128i*>(data + i);
+                _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), key));
+            }
+
+            maskWord(data + i, size - i, maskingKey);
+        }
+
+        __attribute__((target("avx2"))) void maskAVX2(uint8_t* data,
+                                                     size_t size,
+                                                     const uint8_t maskingKey[4])
+        {
+            int32_t key32;
+            memcpy(&key32, maskingKey, sizeof(key32));
+            __m256i key = _mm256_set1_epi32(key32);
+
+            size_t i = 0;
+            for (; i + 64 <= size; i += 64)
+            {
+                __m256i* p = reinterpret_cast<__m256i*>(data + i);
+                __m256i a = _mm256_xor_si256(_mm256_loadu_si256(p), key);
+                __m256i b = _mm256_xor_si256(_mm256_loadu_si256(p + 1), key);
+                _mm256_storeu_si256(p, a);
+                _mm256_storeu_si256(p + 1, b);
+            }
+            for (; i + 32 <= size; i += 32)
+            {
+                __m256i* p = reinterpret_cast<__m256i*>(data + i);
+                _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), key));
+            }
+
+            // GCC does not emit a vzeroupper before the tail call, the dirty upper
+            // halves would slow the non VEX code down.
+            _mm256_zeroupper();
+            maskWord(data + i, size - i, maskingKey);
+        }
+#endif
+
+        MaskFunction selectMaskFunction()
+        {
+            return getMaskFunction(getBestMaskKernel());
+        }
+    } // namespace
+
+    void applyMask(uint8_t* data, size_t size, const uint8_t maskingKey[4])
+    {
+        static const MaskFunction maskFunction = selectMaskFunction();
+
+        maskFunction(data, size, maskingKey);
+    }
+
+    bool isMaskKernelSupported(MaskKernel kernel)
+    {
+        switch (kernel)
+        {
+            case MaskKernel::Scalar:
+            case MaskKernel::Word: return true;
+#ifdef IXWEBSOCKET_MASK_X86
+            case MaskKernel::SSE2: return __builtin_cpu_supports("sse2");
+            case MaskKernel::AVX2: return __builtin_cpu_supports("avx2");
+#else
+            case MaskKernel::SSE2:
+            case MaskKernel::AVX2: return false;
+#endif
+        }
+        return false;
+    }
+
+    MaskKernel getBestMaskKernel()
+    {
+        if (isMaskKernelSupported(MaskKernel::AVX2)) return MaskKernel::AVX2;
+        if (isMaskKernelSupported(MaskKernel::SSE2)) return MaskKernel::SSE2;
+        return MaskKernel::Word;
+    }
+
+    MaskFunction getMaskFunction(MaskKernel kernel)
+    {
+        if (!isMaskKernelSupported(kernel)) return nullptr;
+
+        switch (kernel)
+        {
+            case MaskKernel::Scalar: return maskScalar;
+            case MaskKernel::Word: return maskWord;
+#ifdef IXWEBSOCKET_MASK_X86
+            case MaskKernel::SSE2: return maskSSE2;
+            case MaskKernel::AVX2: return maskAVX2;
+#else
+            case MaskKernel::SSE2:
+            case MaskKernel::AVX2: return nullptr;
+#endif
+        }
+        return nullptr;
+    }
+
+    const char* getMaskKernelName(MaskKernel kernel)
+    {
+        switch (kernel)
+        {
+            case MaskKernel::Scalar: return "scalar";
+            case MaskKernel::Word: return "word";
+            case MaskKernel::SSE2: return "sse2";
+            case MaskKernel::AVX2: return "avx2";
+        }
+        return "unknown";
+    }
+} // namespace ix
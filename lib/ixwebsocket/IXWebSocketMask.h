@@ -0,0 +1,34 @@
+/*
+ *  IXWebSocketMask.h
+ *  Author: wlanxww
+ *  Copyright (c) 2026. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ix
+{
+    // XOR a payload with a 4 bytes masking key (RFC 6455 section 5.3), starting
+    // at key index 0. Masking and unmasking are the same operation.
+    enum class MaskKernel
+    {
+        Scalar,
+        Word,
+        SSE2,
+        AVX2
+    };
+
+    using MaskFunction = void (*)(uint8_t* data, size_t size, const uint8_t maskingKey[4]);
+
+    // Uses the fastest kernel supported by the running CPU, selected once
+    void applyMask(uint8_t* data, size_t size, const uint8_t maskingKey[4]);
+
+    MaskKernel getBestMaskKernel();
+    bool isMaskKernelSupported(MaskKernel kernel);
+    // Returns nullptr if the kernel is not supported
+    MaskFunction getMaskFunction(MaskKernel kernel);
+    const char* getMaskKernelName(MaskKernel kernel);
+} // namespace ix
@@ -12,6 +12,7 @@
 #include "IXWebSocketOpenInfo.h"
 #include <memory>
 #include <string>
+#include <string_view>
 
 namespace ix
 {
@@ -24,6 +25,9 @@ namespace ix
         WebSocketOpenInfo openInfo;
         WebSocketCloseInfo closeInfo;
         bool binary;
+        // Always set. With zero copy delivery, str is empty and only the view,
+        // valid during the callback, carries the data.
+        std::string_view view;
 
         WebSocketMessage(WebSocketMessageType t,
                          const std::string& s,
@@ -39,6 +43,22 @@ namespace ix
             , openInfo(o)
             , closeInfo(c)
             , binary(b)
+            , view(s)
+        {
+            ;
+        }
+
+        WebSocketMessage(WebSocketMessageType t,
+                         std::string_view v,
+                         size_t w,
+                         WebSocketErrorInfo e,
+                         bool b = false)
+            : type(t)
+            , str(emptyString())
+            , wireSize(w)
+            , errorInfo(e)
+            , binary(b)
+            , view(v)
         {
             ;
         }
@@ -54,6 +74,13 @@ namespace ix
                          WebSocketOpenInfo o,
                          WebSocketCloseInfo c,
                          bool b = false) = delete;
+
+    private:
+        static const std::string& emptyString()
+        {
+            static const std::string empty;
+            return empty;
+        }
     };
 
     using WebSocketMessagePtr = std::unique_ptr<WebSocketMessage>;
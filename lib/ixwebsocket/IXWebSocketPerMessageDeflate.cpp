@@ -69,15 +69,24 @@ namespace ix
     }
 
     bool WebSocketPerMessageDeflate::init(
-        const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions)
+        const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions, bool server)
     {
         bool clientNoContextTakeover = perMessageDeflateOptions.getClientNoContextTakeover();
+        bool serverNoContextTakeover = perMessageDeflateOptions.getServerNoContextTakeover();
 
-        uint8_t deflateBits = perMessageDeflateOptions.getClientMaxWindowBits();
-        uint8_t inflateBits = perMessageDeflateOptions.getServerMaxWindowBits();
+        uint8_t clientBits = perMessageDeflateOptions.getClientMaxWindowBits();
+        uint8_t serverBits = perMessageDeflateOptions.getServerMaxWindowBits();
 
-        return _compressor->init(deflateBits, clientNoContextTakeover) &&
-               _decompressor->init(inflateBits, clientNoContextTakeover);
+        if (server)
+        {
+            return _compressor->init(serverBits, serverNoContextTakeover) &&
+                   _decompressor->init(clientBits, clientNoContextTakeover);
+        }
+        else
+        {
+            return _compressor->init(clientBits, clientNoContextTakeover) &&
+                   _decompressor->init(serverBits, serverNoContextTakeover);
+        }
     }
 
     bool WebSocketPerMessageDeflate::compress(const IXWebSocketSendData& in, std::string& out)
@@ -90,9 +99,14 @@ namespace ix
         return _compressor->compress(in, out);
     }
 
-    bool WebSocketPerMessageDeflate::decompress(const std::string& in, std::string& out)
+    bool WebSocketPerMessageDeflate::decompress(std::string_view in, std::string& out)
     {
         return _decompressor->decompress(in, out);
     }
 
+    bool WebSocketPerMessageDeflate::canShareCompressedMessages(uint8_t windowBits) const
+    {
+        return _compressor->getNoContextTakeover() && windowBits <= _compressor->getWindowBits();
+    }
+
 } // namespace ix
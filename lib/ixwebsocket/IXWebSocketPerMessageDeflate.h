@@ -50,10 +50,18 @@ namespace ix
         WebSocketPerMessageDeflate();
         ~WebSocketPerMessageDeflate();
 
-        bool init(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions);
+        // Each side compresses with its own parameters and inflates with the ones of
+        // its peer
+        bool init(const WebSocketPerMessageDeflateOptions& perMessageDeflateOptions,
+                  bool server);
         bool compress(const IXWebSocketSendData& in, std::string& out);
         bool compress(const std::string& in, std::string& out);
-        bool decompress(const std::string& in, std::string& out);
+        bool decompress(std::string_view in, std::string& out);
+
+        // Whether a message compressed on its own with a window of windowBits can be
+        // sent as is: the compressor must not keep a context the message would break,
+        // and the peer must accept such a window.
+        bool canShareCompressedMessages(uint8_t windowBits) const;
 
     private:
         std::unique_ptr<WebSocketPerMessageDeflateCompressor> _compressor;
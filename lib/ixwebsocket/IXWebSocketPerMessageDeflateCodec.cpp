@@ -6,8 +6,11 @@
 
 #include "IXWebSocketPerMessageDeflateCodec.h"
 
+#include "IXUniquePtr.h"
 #include "IXWebSocketPerMessageDeflateOptions.h"
+#include <algorithm>
 #include <cassert>
+#include <mutex>
 #include <string.h>
 
 namespace
@@ -20,41 +23,241 @@ namespace
 
 namespace ix
 {
+    struct ZlibStream
+    {
+        ZlibStream(bool deflate, uint8_t windowBits)
+            : deflate(deflate)
+            , windowBits(windowBits)
+            , initialized(false)
+        {
+#ifdef IXWEBSOCKET_USE_ZLIB
+            memset(&state, 0, sizeof(state));
+
+            state.zalloc = Z_NULL;
+            state.zfree = Z_NULL;
+            state.opaque = Z_NULL;
+            state.avail_in = 0;
+            state.next_in = Z_NULL;
+
+            int ret = deflate ? deflateInit2(&state,
+                                             Z_DEFAULT_COMPRESSION,
+                                             Z_DEFLATED,
+                                             -1 * windowBits,
+                                             4, // memory level 1-9
+                                             Z_DEFAULT_STRATEGY)
+                              : inflateInit2(&state, -1 * windowBits);
+
+            initialized = ret == Z_OK;
+#endif
+        }
+
+        ~ZlibStream()
+        {
+#ifdef IXWEBSOCKET_USE_ZLIB
+            if (!initialized) return;
+
+            if (deflate)
+            {
+                deflateEnd(&state);
+            }
+            else
+            {
+                inflateEnd(&state);
+            }
+#endif
+        }
+
+        // Forget the dictionary, the memory allocated by zlib is kept
+        bool reset()
+        {
+#ifdef IXWEBSOCKET_USE_ZLIB
+            return (deflate ? deflateReset(&state) : inflateReset(&state)) == Z_OK;
+#else
+            return false;
+#endif
+        }
+
+        const bool deflate;
+        const uint8_t windowBits;
+        bool initialized;
+#ifdef IXWEBSOCKET_USE_ZLIB
+        z_stream state;
+#endif
+    };
+
+    namespace
+    {
+        // Idle streams kept per direction and window size. Beyond that streams are
+        // freed as soon as their message is processed.
+        const size_t kMaxPooledStreams = 8;
+
+        // Output space added when the output of a stream is full
+        const size_t kMinOutputSpace = 256;
+
+        std::unique_ptr<ZlibStream> createStream(bool deflate, uint8_t windowBits)
+        {
+            auto stream = ix::make_unique<ZlibStream>(deflate, windowBits);
+            if (!stream->initialized) stream.reset();
+
+            return stream;
+        }
+
+        class ZlibStreamPool
+        {
+        public:
+            std::unique_ptr<ZlibStream> acquire(bool deflate, uint8_t windowBits)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    auto& streams = _streams[deflate][windowBits];
+                    if (!streams.empty())
+                    {
+                        auto stream = std::move(streams.back());
+                        streams.pop_back();
+                        return stream;
+                    }
+                }
+
+                return createStream(deflate, windowBits);
+            }
+
+            void release(std::unique_ptr<ZlibStream> stream)
+            {
+                // Streams are returned clean, the next message must not see this one
+                if (!stream->reset()) return;
+
+                std::lock_guard<std::mutex> lock(_mutex);
+                auto& streams = _streams[stream->deflate][stream->windowBits];
+                if (streams.size() < kMaxPooledStreams)
+                {
+                    streams.push_back(std::move(stream));
+                }
+            }
+
+        private:
+            std::mutex _mutex;
+            std::vector<std::unique_ptr<ZlibStream>> _streams[2][16];
+        };
+
+        ZlibStreamPool& getStreamPool()
+        {
+            static ZlibStreamPool pool;
+            return pool;
+        }
+
+        //
+        // Stream used to process one message. With context takeover the codec owns
+        // its stream for the whole connection, otherwise one is borrowed from the
+        // pool and given back when the message is done.
+        //
+        class StreamLease
+        {
+        public:
+            StreamLease(std::unique_ptr<ZlibStream>& ownStream,
+                        bool deflate,
+                        uint8_t windowBits,
+                        bool noContextTakeover)
+                : _stream(nullptr)
+            {
+                if (noContextTakeover)
+                {
+                    _leasedStream = getStreamPool().acquire(deflate, windowBits);
+                    _stream = _leasedStream.get();
+                }
+                else
+                {
+                    if (!ownStream) ownStream = createStream(deflate, windowBits);
+                    _stream = ownStream.get();
+                }
+            }
+
+            ~StreamLease()
+            {
+                if (_leasedStream) getStreamPool().release(std::move(_leasedStream));
+            }
+
+            ZlibStream* get() const
+            {
+                return _stream;
+            }
+
+        private:
+            ZlibStream* _stream;
+            std::unique_ptr<ZlibStream> _leasedStream;
+        };
+
+#ifdef IXWEBSOCKET_USE_ZLIB
+        //
+        // Feed the input to the stream and append what comes out to out. zlib writes
+        // straight into out, which is grown geometrically, so no scratch buffer is
+        // needed.
+        //
+        template<typename S>
+        bool processInput(ZlibStream& stream, const void* data, size_t size, S& out, size_t sizeHint)
+        {
+            z_stream& state = stream.state;
+            state.avail_in = (uInt) size;
+            state.next_in = (Bytef*) data;
+
+            size_t used = out.size();
+            size_t growth = std::max(sizeHint, kMinOutputSpace);
+
+            do
+            {
+                if (out.size() - used < kMinOutputSpace)
+                {
+                    out.resize(used + growth);
+                    growth = out.size();
+                }
+
+                state.avail_out = (uInt) (out.size() - used);
+                state.next_out = reinterpret_cast<Bytef*>(&out[used]);
+
+                int ret = stream.deflate ? deflate(&state, Z_SYNC_FLUSH)
+                                         : inflate(&state, Z_SYNC_FLUSH);
+
+                if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR ||
+                    ret == Z_STREAM_ERROR)
+                {
+                    out.resize(used);
+                    return false; // zlib error
+                }
+
+                used = out.size() - state.avail_out;
+            } while (state.avail_out == 0);
+
+            out.resize(used);
+
+            return true;
+        }
+#endif
+    } // namespace
+
     //
     // Compressor
     //
     WebSocketPerMessageDeflateCompressor::WebSocketPerMessageDeflateCompressor()
+        : _windowBits(WebSocketPerMessageDeflateOptions::kDefaultServerMaxWindowBits)
+        , _noContextTakeover(false)
     {
-#ifdef IXWEBSOCKET_USE_ZLIB
-        memset(&_deflateState, 0, sizeof(_deflateState));
-
-        _deflateState.zalloc = Z_NULL;
-        _deflateState.zfree = Z_NULL;
-        _deflateState.opaque = Z_NULL;
-#endif
+        ;
     }
 
     WebSocketPerMessageDeflateCompressor::~WebSocketPerMessageDeflateCompressor()
     {
-#ifdef IXWEBSOCKET_USE_ZLIB
-        deflateEnd(&_deflateState);
-#endif
+        ;
     }
 
-    bool WebSocketPerMessageDeflateCompressor::init(uint8_t deflateBits,
-                                                    bool clientNoContextTakeOver)
+    bool WebSocketPerMessageDeflateCompressor::init(uint8_t deflateBits, bool noContextTakeOver)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        int ret = deflateInit2(&_deflateState,
-                               Z_DEFAULT_COMPRESSION,
-                               Z_DEFLATED,
-                               -1 * deflateBits,
-                               4, // memory level 1-9
-                               Z_DEFAULT_STRATEGY);
-
-        if (ret != Z_OK) return false;
+        // Raw deflate streams do not support a 256 bytes window
+        if (deflateBits < 9 || deflateBits > 15) return false;
 
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+        // The stream itself is created when the first message is sent
+        _windowBits = deflateBits;
+        _noContextTakeover = noContextTakeOver;
+        _deflateState.reset();
 
         return true;
 #else
@@ -62,6 +265,16 @@ namespace ix
 #endif
     }
 
+    uint8_t WebSocketPerMessageDeflateCompressor::getWindowBits() const
+    {
+        return _windowBits;
+    }
+
+    bool WebSocketPerMessageDeflateCompressor::getNoContextTakeover() const
+    {
+        return _noContextTakeover;
+    }
+
     template<typename T>
     bool WebSocketPerMessageDeflateCompressor::endsWithEmptyUnCompressedBlock(const T& value)
     {
@@ -123,7 +336,6 @@ namespace ix
         //        (possibly part of) the DEFLATE header bits with the "BTYPE" bits
         //        set to 00.
         //
-        size_t output;
 
         // Clear output
         out.clear();
@@ -140,21 +352,13 @@ namespace ix
             return true;
         }
 
-        _deflateState.avail_in = (uInt) in.size();
-        _deflateState.next_in = (Bytef*) in.data();
+        StreamLease stream(_deflateState, true, _windowBits, _noContextTakeover);
+        if (!stream.get()) return false;
 
-        do
+        if (!processInput(*stream.get(), in.data(), in.size(), out, in.size() / 2))
         {
-            // Output to local buffer
-            _deflateState.avail_out = (uInt) _compressBuffer.size();
-            _deflateState.next_out = &_compressBuffer.front();
-
-            deflate(&_deflateState, _flush);
-
-            output = _compressBuffer.size() - _deflateState.avail_out;
-
-            out.insert(out.end(), _compressBuffer.begin(), _compressBuffer.begin() + output);
-        } while (_deflateState.avail_out == 0);
+            return false;
+        }
 
         if (endsWithEmptyUnCompressedBlock(out))
         {
@@ -171,34 +375,26 @@ namespace ix
     // Decompressor
     //
     WebSocketPerMessageDeflateDecompressor::WebSocketPerMessageDeflateDecompressor()
+        : _windowBits(WebSocketPerMessageDeflateOptions::kDefaultServerMaxWindowBits)
+        , _noContextTakeover(false)
     {
-#ifdef IXWEBSOCKET_USE_ZLIB
-        memset(&_inflateState, 0, sizeof(_inflateState));
-
-        _inflateState.zalloc = Z_NULL;
-        _inflateState.zfree = Z_NULL;
-        _inflateState.opaque = Z_NULL;
-        _inflateState.avail_in = 0;
-        _inflateState.next_in = Z_NULL;
-#endif
+        ;
     }
 
     WebSocketPerMessageDeflateDecompressor::~WebSocketPerMessageDeflateDecompressor()
     {
-#ifdef IXWEBSOCKET_USE_ZLIB
-        inflateEnd(&_inflateState);
-#endif
+        ;
     }
 
-    bool WebSocketPerMessageDeflateDecompressor::init(uint8_t inflateBits,
-                                                      bool clientNoContextTakeOver)
+    bool WebSocketPerMessageDeflateDecompressor::init(uint8_t inflateBits, bool noContextTakeOver)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
-        int ret = inflateInit2(&_inflateState, -1 * inflateBits);
-
-        if (ret != Z_OK) return false;
+        if (inflateBits < 8 || inflateBits > 15) return false;
 
-        _flush = (clientNoContextTakeOver) ? Z_FULL_FLUSH : Z_SYNC_FLUSH;
+        // The stream itself is created when the first message is received
+        _windowBits = inflateBits;
+        _noContextTakeover = noContextTakeOver;
+        _inflateState.reset();
 
         return true;
 #else
@@ -206,7 +402,7 @@ namespace ix
 #endif
     }
 
-    bool WebSocketPerMessageDeflateDecompressor::decompress(const std::string& in, std::string& out)
+    bool WebSocketPerMessageDeflateDecompressor::decompress(std::string_view in, std::string& out)
     {
 #ifdef IXWEBSOCKET_USE_ZLIB
         //
@@ -219,32 +415,29 @@ namespace ix
         //
         //    2.  Decompress the resulting data using DEFLATE.
         //
-        std::string inFixed(in);
-        inFixed += kEmptyUncompressedBlock;
-
-        _inflateState.avail_in = (uInt) inFixed.size();
-        _inflateState.next_in = (unsigned char*) (const_cast<char*>(inFixed.data()));
+        // The payload is inflated straight from the receive buffer, the tail is fed
+        // as a second input instead of being appended to a copy.
+        //
 
         // Clear output
         out.clear();
 
-        do
-        {
-            _inflateState.avail_out = (uInt) _compressBuffer.size();
-            _inflateState.next_out = &_compressBuffer.front();
-
-            int ret = inflate(&_inflateState, Z_SYNC_FLUSH);
+        StreamLease stream(_inflateState, false, _windowBits, _noContextTakeover);
+        if (!stream.get()) return false;
 
-            if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
-            {
-                return false; // zlib error
-            }
-
-            out.append(reinterpret_cast<char*>(&_compressBuffer.front()),
-                       _compressBuffer.size() - _inflateState.avail_out);
-        } while (_inflateState.avail_out == 0);
+        return inflateInput(*stream.get(), in, out) &&
+               inflateInput(*stream.get(), kEmptyUncompressedBlock, out);
+#else
+        return false;
+#endif
+    }
 
-        return true;
+    bool WebSocketPerMessageDeflateDecompressor::inflateInput(ZlibStream& stream,
+                                                              std::string_view in,
+                                                              std::string& out)
+    {
+#ifdef IXWEBSOCKET_USE_ZLIB
+        return processInput(stream, in.data(), in.size(), out, 2 * in.size());
 #else
         return false;
 #endif
@@ -9,39 +9,47 @@
 #ifdef IXWEBSOCKET_USE_ZLIB
 #include "zlib.h"
 #endif
-#include <array>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "IXWebSocketSendData.h"
 
 namespace ix
 {
+    // zlib stream, defined in the .cpp file. Deflate streams weigh ~140 KB with a
+    // 15 bits window, so connections which reset the context after every message
+    // lease one from a process wide pool instead of owning one.
+    struct ZlibStream;
+
     class WebSocketPerMessageDeflateCompressor
     {
     public:
         WebSocketPerMessageDeflateCompressor();
         ~WebSocketPerMessageDeflateCompressor();
 
-        bool init(uint8_t deflateBits, bool clientNoContextTakeOver);
+        bool init(uint8_t deflateBits, bool noContextTakeOver);
         bool compress(const IXWebSocketSendData& in, std::string& out);
         bool compress(const std::string& in, std::string& out);
         bool compress(const std::string& in, std::vector<uint8_t>& out);
         bool compress(const std::vector<uint8_t>& in, std::string& out);
         bool compress(const std::vector<uint8_t>& in, std::vector<uint8_t>& out);
 
+        uint8_t getWindowBits() const;
+        bool getNoContextTakeover() const;
+
     private:
         template<typename T, typename S>
         bool compressData(const T& in, S& out);
         template<typename T>
         bool endsWithEmptyUnCompressedBlock(const T& value);
 
-        int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        uint8_t _windowBits;
+        bool _noContextTakeover;
 
-#ifdef IXWEBSOCKET_USE_ZLIB
-        z_stream _deflateState;
-#endif
+        // Only used with context takeover, created by the first message
+        std::unique_ptr<ZlibStream> _deflateState;
     };
 
     class WebSocketPerMessageDeflateDecompressor
@@ -50,16 +58,17 @@ namespace ix
         WebSocketPerMessageDeflateDecompressor();
         ~WebSocketPerMessageDeflateDecompressor();
 
-        bool init(uint8_t inflateBits, bool clientNoContextTakeOver);
-        bool decompress(const std::string& in, std::string& out);
+        bool init(uint8_t inflateBits, bool noContextTakeOver);
+        bool decompress(std::string_view in, std::string& out);
 
     private:
-        int _flush;
-        std::array<unsigned char, 1 << 14> _compressBuffer;
+        bool inflateInput(ZlibStream& stream, std::string_view in, std::string& out);
 
-#ifdef IXWEBSOCKET_USE_ZLIB
-        z_stream _inflateState;
-#endif
+        uint8_t _windowBits;
+        bool _noContextTakeover;
+
+        // Only used with context takeover, created by the first message
+        std::unique_ptr<ZlibStream> _inflateState;
     };
 
 } // namespace ix
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 #include <iterator>
@@ -81,6 +82,19 @@ namespace ix
         {
         }
 
+        /* Shares ownership of the string, the transport queues a reference to it instead of a copy */
+        IXWebSocketSendData(std::shared_ptr<const std::string> str)
+            : _data(str ? str->data() : nullptr)
+            , _size(str ? str->size() : 0)
+            , _owner(std::move(str))
+        {
+        }
+
+        const std::shared_ptr<const std::string>& owner() const
+        {
+            return _owner;
+        }
+
         bool empty() const
         {
             return _data == nullptr || _size == 0;
@@ -124,6 +138,7 @@ namespace ix
     private:
         const char* _data;
         const size_t _size;
+        std::shared_ptr<const std::string> _owner;
     };
 
 }
\ No newline at end of file
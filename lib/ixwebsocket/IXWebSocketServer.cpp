@@ -6,9 +6,11 @@
 
 #include "IXWebSocketServer.h"
 
+#include "IXEventLoop.h"
 #include "IXNetSystem.h"
 #include "IXSetThreadName.h"
 #include "IXSocketConnect.h"
+#include "IXSocketEventLoop.h"
 #include "IXWebSocket.h"
 #include "IXWebSocketTransport.h"
 #include <future>
@@ -20,6 +22,133 @@ namespace ix
     const int WebSocketServer::kDefaultHandShakeTimeoutSecs(3); // 3 seconds
     const bool WebSocketServer::kDefaultEnablePong(true);
 
+    //
+    // Replaces WebSocket::run() in event loop mode: every readiness
+    // notification, wake up request and tick runs one non blocking
+    // receive / dispatch / send cycle on the loop thread.
+    //
+    class WebSocketServer::EventLoopConnection final
+        : public EventLoopHandler
+        , public std::enable_shared_from_this<WebSocketServer::EventLoopConnection>
+    {
+    public:
+        EventLoopConnection(WebSocketServer& server,
+                            std::shared_ptr<WebSocket> webSocket,
+                            std::shared_ptr<ConnectionState> connectionState,
+                            SocketEventLoop& socket,
+                            EventLoop& loop)
+            : _server(server)
+            , _webSocket(webSocket)
+            , _connectionState(connectionState)
+            , _socket(socket)
+            , _loop(loop)
+            , _id(0)
+            , _wantWrite(false)
+            , _detached(false)
+            , _wakeUpPending(std::make_shared<std::atomic<bool>>(false))
+        {
+        }
+
+        void attach()
+        {
+            _id = _loop.add(_socket.getPollFd(), false, shared_from_this());
+            if (_id == 0)
+            {
+                _server.logError("WebSocketServer: cannot register connection on event loop");
+                _webSocket->close();
+                detach();
+                return;
+            }
+
+            // Runs on the caller's thread: only the loop may own (and destroy) this object
+            std::weak_ptr<EventLoopConnection> weakSelf = shared_from_this();
+            EventLoop* loop = &_loop;
+            auto wakeUpPending = _wakeUpPending;
+            _socket.setOnWakeUpCallback(
+                [weakSelf, loop, wakeUpPending](uint64_t value)
+                {
+                    bool closeRequested = value == SelectInterrupt::kCloseRequest;
+
+                    // Coalesce send requests until the loop has handled the previous one
+                    if (!closeRequested && wakeUpPending->exchange(true))
+                    {
+                        return;
+                    }
+
+                    loop->post(
+                        [weakSelf, closeRequested]
+                        {
+                            if (auto self = weakSelf.lock())
+                            {
+                                *self->_wakeUpPending = false;
+                                self->process(false, true, closeRequested);
+                            }
+                        });
+                });
+
+            // Messages queued by the Open callback, before we could be woken up
+            process(false, true, false);
+        }
+
+        void onEvents(bool readable, bool writable) final
+        {
+            process(readable, writable, false);
+        }
+
+        void onTick() final
+        {
+            process(false, false, false);
+        }
+
+        void onLoopStopped() final
+        {
+            // Drain timeout exceeded, drop the connection without a closing handshake
+            _socket.close();
+            detach();
+        }
+
+    private:
+        void process(bool readable, bool writable, bool closeRequested)
+        {
+            if (_detached) return;
+
+            _webSocket->handleSocketEvents(readable, writable, closeRequested);
+
+            if (_webSocket->getReadyState() == ReadyState::Closed)
+            {
+                detach();
+                return;
+            }
+
+            bool wantWrite = _webSocket->bufferedAmount() != 0;
+            if (wantWrite != _wantWrite)
+            {
+                _wantWrite = wantWrite;
+                _loop.setWantWrite(_id, wantWrite);
+            }
+        }
+
+        void detach()
+        {
+            _detached = true;
+            _socket.setOnWakeUpCallback(nullptr);
+            _loop.remove(_id);
+
+            _server.removeWebSocket(_webSocket);
+            _connectionState->setTerminated();
+        }
+
+        WebSocketServer& _server;
+        std::shared_ptr<WebSocket> _webSocket;
+        std::shared_ptr<ConnectionState> _connectionState;
+        SocketEventLoop& _socket; // owned by _webSocket
+        EventLoop& _loop;
+        EventLoop::HandlerId _id;
+        bool _wantWrite;
+        bool _detached;
+        std::shared_ptr<std::atomic<bool>> _wakeUpPending;
+    };
+
     WebSocketServer::WebSocketServer(int port,
                                      const std::string& host,
                                      int backlog,
@@ -84,12 +213,9 @@ namespace ix
         connectionState->setTerminated();
     }
 
-    void WebSocketServer::handleUpgrade(std::unique_ptr<Socket> socket,
-                                        std::shared_ptr<ConnectionState> connectionState,
-                                        HttpRequestPtr request)
+    std::shared_ptr<WebSocket> WebSocketServer::createWebSocket(
+        std::shared_ptr<ConnectionState> connectionState)
     {
-        setThreadName("Srv:ws:" + connectionState->getId());
-
         auto webSocket = std::make_shared<WebSocket>();
 
         webSocket->setAutoThreadName(false);
@@ -104,7 +230,7 @@ namespace ix
                          "registered.");
                 logError("Missing call to setOnMessageCallback inside setOnConnectionCallback.");
                 connectionState->setTerminated();
-                return;
+                return nullptr;
             }
         }
         else if (_onClientMessageCallback)
@@ -120,7 +246,7 @@ namespace ix
                 "WebSocketServer Application developer error: No server callback is registerered.");
             logError("Missing call to setOnConnectionCallback or setOnClientMessageCallback.");
             connectionState->setTerminated();
-            return;
+            return nullptr;
         }
 
         webSocket->disableAutomaticReconnection();
@@ -140,6 +266,32 @@ namespace ix
             _clients.insert(webSocket);
         }
 
+        return webSocket;
+    }
+
+    void WebSocketServer::removeWebSocket(const std::shared_ptr<WebSocket>& webSocket)
+    {
+        webSocket->setOnMessageCallback(nullptr);
+
+        // Remove this client from our client set
+        {
+            std::lock_guard<std::mutex> lock(_clientsMutex);
+            if (_clients.erase(webSocket) != 1)
+            {
+                logError("Cannot delete client");
+            }
+        }
+    }
+
+    void WebSocketServer::handleUpgrade(std::unique_ptr<Socket> socket,
+                                        std::shared_ptr<ConnectionState> connectionState,
+                                        HttpRequestPtr request)
+    {
+        setThreadName("Srv:ws:" + connectionState->getId());
+
+        auto webSocket = createWebSocket(connectionState);
+        if (!webSocket) return;
+
         auto status = webSocket->connectToSocket(
             std::move(socket), _handshakeTimeoutSecs, _enablePerMessageDeflate, request);
         if (status.success)
@@ -156,16 +308,52 @@ namespace ix
             logError(ss.str());
         }
 
-        webSocket->setOnMessageCallback(nullptr);
+        removeWebSocket(webSocket);
+    }
 
-        // Remove this client from our client set
+    void WebSocketServer::handleConnectionOnEventLoop(
+        std::unique_ptr<SocketEventLoop> socket,
+        std::shared_ptr<ConnectionState> connectionState,
+        EventLoop& loop)
+    {
+        handleUpgradeOnEventLoop(std::move(socket), connectionState, loop);
+    }
+
+    int WebSocketServer::getEventLoopRequestTimeoutSecs()
+    {
+        return _handshakeTimeoutSecs;
+    }
+
+    void WebSocketServer::handleUpgradeOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                   std::shared_ptr<ConnectionState> connectionState,
+                                                   EventLoop& loop,
+                                                   HttpRequestPtr request)
+    {
+        auto webSocket = createWebSocket(connectionState);
+        if (!webSocket) return;
+
+        // The request was fully received by the loop, so the handshake does not block
+        SocketEventLoop& socketRef = *socket;
+        auto status = webSocket->connectToSocket(
+            std::move(socket), _handshakeTimeoutSecs, _enablePerMessageDeflate, request);
+        if (!status.success)
         {
-            std::lock_guard<std::mutex> lock(_clientsMutex);
-            if (_clients.erase(webSocket) != 1)
-            {
-                logError("Cannot delete client");
-            }
+            std::stringstream ss;
+            ss << "WebSocketServer::handleConnectionOnEventLoop() HTTP status: "
+               << status.http_status << " error: " << status.errorStr << " uri: " << status.uri;
+            logError(ss.str());
+
+            removeWebSocket(webSocket);
+            connectionState->setTerminated();
+            return;
         }
+
+        // Sends from other threads only fill the send buffer, the loop flushes it
+        webSocket->setBlockingSend(false);
+
+        auto connection = std::make_shared<EventLoopConnection>(
+            *this, webSocket, connectionState, socketRef, loop);
+        connection->attach();
     }
 
     std::set<std::shared_ptr<WebSocket>> WebSocketServer::getClients()
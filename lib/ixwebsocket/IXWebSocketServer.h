@@ -75,9 +75,26 @@ namespace ix
                                       std::shared_ptr<ConnectionState> connectionState);
         virtual size_t getConnectedClientsCount() final;
 
+        // Setup shared by both connection modes, nullptr on application error
+        std::shared_ptr<WebSocket> createWebSocket(std::shared_ptr<ConnectionState> connectionState);
+        void removeWebSocket(const std::shared_ptr<WebSocket>& webSocket);
+
+        // A connected client driven by an EventLoop
+        class EventLoopConnection;
+
     protected:
         void handleUpgrade(std::unique_ptr<Socket> socket,
                            std::shared_ptr<ConnectionState> connectionState,
                            HttpRequestPtr request = nullptr);
+
+        virtual void handleConnectionOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                                 std::shared_ptr<ConnectionState> connectionState,
+                                                 EventLoop& loop);
+        virtual int getEventLoopRequestTimeoutSecs();
+
+        void handleUpgradeOnEventLoop(std::unique_ptr<SocketEventLoop> socket,
+                                      std::shared_ptr<ConnectionState> connectionState,
+                                      EventLoop& loop,
+                                      HttpRequestPtr request = nullptr);
     };
 } // namespace ix
@@ -41,6 +41,8 @@
 #include "IXUtf8Validator.h"
 #include "IXWebSocketHandshake.h"
 #include "IXWebSocketHttpHeaders.h"
+#include "IXWebSocketMask.h"
+#include <algorithm>
 #include <chrono>
 #include <cstdarg>
 #include <cstdlib>
@@ -61,6 +63,10 @@ namespace ix
     WebSocketTransport::WebSocketTransport()
         : _useMask(true)
         , _blockingSend(false)
+        , _rxbufOffset(0)
+        , _txbufOffset(0)
+        , _txbufSize(0)
+        , _receivingFragmentedMessage(false)
         , _receivedMessageCompressed(false)
         , _readyState(ReadyState::CLOSED)
         , _closeCode(WebSocketCloseConstants::kInternalErrorCode)
@@ -172,7 +178,8 @@ namespace ix
     WebSocketInitResult WebSocketTransport::connectToSocket(std::unique_ptr<Socket> socket,
                                                             int timeoutSecs,
                                                             bool enablePerMessageDeflate,
-                                                            HttpRequestPtr request)
+                                                            HttpRequestPtr request,
+                                                            const std::vector<std::string>& subProtocols)
     {
         std::lock_guard<std::mutex> lock(_socketMutex);
 
@@ -189,8 +196,8 @@ namespace ix
                                               _perMessageDeflateOptions,
                                               _enablePerMessageDeflate);
 
-        auto result =
-            webSocketHandshake.serverHandshake(timeoutSecs, enablePerMessageDeflate, request);
+        auto result = webSocketHandshake.serverHandshake(
+            timeoutSecs, enablePerMessageDeflate, request, subProtocols);
         if (result.success)
         {
             setReadyState(ReadyState::OPEN);
@@ -305,7 +312,7 @@ namespace ix
         return now - _closingTimePoint > std::chrono::milliseconds(kClosingMaximumWaitingDelayInMs);
     }
 
-    WebSocketTransport::PollResult WebSocketTransport::poll()
+    void WebSocketTransport::checkHeartBeat()
     {
         if (_readyState == ReadyState::OPEN)
         {
@@ -325,6 +332,22 @@ namespace ix
                 }
             }
         }
+    }
+
+    void WebSocketTransport::checkClosingDelay()
+    {
+        if (_readyState == ReadyState::CLOSING && closingDelayExceeded())
+        {
+            clearReceiveBuffer();
+            // close code and reason were set when calling close()
+            closeSocket();
+            setReadyState(ReadyState::CLOSED);
+        }
+    }
+
+    WebSocketTransport::PollResult WebSocketTransport::poll()
+    {
+        checkHeartBeat();
 
         // No timeout if state is not OPEN, otherwise computed
         // pingIntervalOrTimeoutGCD (equals to -1 if no ping and no ping timeout are set)
@@ -381,52 +404,116 @@ namespace ix
             closeSocket();
         }
 
-        if (_readyState == ReadyState::CLOSING && closingDelayExceeded())
+        checkClosingDelay();
+
+        return PollResult::Succeeded;
+    }
+
+    WebSocketTransport::PollResult WebSocketTransport::handleSocketEvents(bool readable,
+                                                                          bool writable,
+                                                                          bool closeRequested)
+    {
+        checkHeartBeat();
+
+        if (closeRequested)
         {
-            _rxbuf.clear();
-            // close code and reason were set when calling close()
             closeSocket();
-            setReadyState(ReadyState::CLOSED);
         }
+        else
+        {
+            // Unlike flushSendBuffer(), only write what the socket accepts right now,
+            // the loop reports the socket writable again for the rest.
+            if (writable && !sendOnSocket())
+            {
+                return PollResult::CannotFlushSendBuffer;
+            }
+
+            if (readable && !receiveFromSocket())
+            {
+                return PollResult::AbnormalClose;
+            }
+        }
+
+        checkClosingDelay();
 
         return PollResult::Succeeded;
     }
 
+    void WebSocketTransport::setBlockingSend(bool blockingSend)
+    {
+        _blockingSend = blockingSend;
+    }
+
     bool WebSocketTransport::isSendBufferEmpty() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
         return _txbuf.empty();
     }
 
-    template<class Iterator>
-    void WebSocketTransport::appendToSendBuffer(const std::vector<uint8_t>& header,
-                                                Iterator begin,
-                                                Iterator end,
-                                                uint64_t message_size,
+    void WebSocketTransport::appendToSendBuffer(const std::array<uint8_t, 14>& header,
+                                                size_t headerSize,
+                                                const char* begin,
+                                                const char* end,
+                                                const std::shared_ptr<const std::string>& owner,
                                                 uint8_t masking_key[4])
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
 
-        _txbuf.insert(_txbuf.end(), header.begin(), header.end());
-        _txbuf.insert(_txbuf.end(), begin, end);
+        // Deque elements never move, so the segment can point into its own storage
+        _txbuf.emplace_back();
+        SendSegment& segment = _txbuf.back();
+        segment.header = header;
+        segment.headerSize = headerSize;
+        segment.payloadSize = (size_t) (end - begin);
 
-        if (_useMask)
+        if (owner && !_useMask)
+        {
+            segment.sharedPayload = owner;
+            segment.payload = begin;
+        }
+        else
         {
-            for (size_t i = 0; i != (size_t) message_size; ++i)
+            // Masked payloads differ per frame, and the caller's memory may not outlive
+            // a non blocking send
+            segment.ownedPayload.assign(begin, end);
+            segment.payload = segment.ownedPayload.data();
+
+            if (_useMask && segment.payloadSize != 0)
             {
-                *(_txbuf.end() - (size_t) message_size + i) ^= masking_key[i & 0x3];
+                applyMask(reinterpret_cast<uint8_t*>(&segment.ownedPayload[0]),
+                          segment.payloadSize,
+                          masking_key);
             }
         }
+
+        _txbufSize += segment.headerSize + segment.payloadSize;
     }
 
-    void WebSocketTransport::unmaskReceiveBuffer(const wsheader_type& ws)
+    void WebSocketTransport::consumeSendBuffer(size_t size)
     {
-        if (ws.mask)
+        _txbufSize -= size;
+
+        while (size != 0)
         {
-            for (size_t j = 0; j != ws.N; ++j)
+            const SendSegment& segment = _txbuf.front();
+            size_t remaining = segment.headerSize + segment.payloadSize - _txbufOffset;
+            if (size < remaining)
             {
-                _rxbuf[j + ws.header_size] ^= ws.masking_key[j & 0x3];
+                _txbufOffset += size;
+                return;
             }
+
+            size -= remaining;
+            _txbufOffset = 0;
+            _txbuf.pop_front();
+        }
+    }
+
+    void WebSocketTransport::unmaskReceiveBuffer(const wsheader_type& ws)
+    {
+        if (ws.mask && ws.N != 0)
+        {
+            applyMask(&_rxbuf[_rxbufOffset + ws.header_size], (size_t) ws.N, ws.masking_key);
         }
     }
 
@@ -458,8 +545,10 @@ namespace ix
         while (true)
         {
             wsheader_type ws;
-            if (_rxbuf.size() < 2) break;                /* Need at least 2 */
-            const uint8_t* data = (uint8_t*) &_rxbuf[0]; // peek, but don't consume
+            // Frames are parsed in place, consumed bytes are only skipped over
+            size_t available = _rxbuf.size() - _rxbufOffset;
+            if (available < 2) break;                               /* Need at least 2 */
+            const uint8_t* data = (uint8_t*) &_rxbuf[_rxbufOffset]; // peek, but don't consume
             ws.fin = (data[0] & 0x80) == 0x80;
             ws.rsv1 = (data[0] & 0x40) == 0x40;
             ws.rsv2 = (data[0] & 0x20) == 0x20;
@@ -469,13 +558,13 @@ namespace ix
             ws.N0 = (data[1] & 0x7f);
             ws.header_size =
                 2 + (ws.N0 == 126 ? 2 : 0) + (ws.N0 == 127 ? 8 : 0) + (ws.mask ? 4 : 0);
-            if (_rxbuf.size() < ws.header_size) break; /* Need: ws.header_size - _rxbuf.size() */
+            if (available < ws.header_size) break; /* Need: ws.header_size - available */
 
             if ((ws.rsv1 && !_enablePerMessageDeflate) || ws.rsv2 || ws.rsv3)
             {
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorReservedBitUsed,
-                      _rxbuf.size());
+                      available);
                 return;
             }
 
@@ -539,9 +628,9 @@ namespace ix
                 return;
             }
 
-            if (_rxbuf.size() < ws.header_size + ws.N)
+            if (available < ws.header_size + ws.N)
             {
-                return; /* Need: ws.header_size+ws.N - _rxbuf.size() */
+                return; /* Need: ws.header_size+ws.N - available */
             }
 
             if (!ws.fin && (ws.opcode == wsheader_type::PING || ws.opcode == wsheader_type::PONG ||
@@ -553,9 +642,11 @@ namespace ix
                 return;
             }
 
+            // Unmask in place and hand out a view, the payload is not copied
             unmaskReceiveBuffer(ws);
-            std::string frameData(_rxbuf.begin() + ws.header_size,
-                                  _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            std::string_view frameData(reinterpret_cast<const char*>(data) + ws.header_size,
+                                       (size_t) ws.N);
+            size_t nextFrameOffset = _rxbufOffset + ws.header_size + (size_t) ws.N;
 
             // We got a whole message, now do something with it:
             if (ws.opcode == wsheader_type::TEXT_FRAME ||
@@ -571,13 +662,13 @@ namespace ix
                     _receivedMessageCompressed = _enablePerMessageDeflate && ws.rsv1;
 
                     // Continuation message needs to follow a non-fin TEXT or BINARY message
-                    if (!_chunks.empty())
+                    if (_receivingFragmentedMessage)
                     {
                         close(WebSocketCloseConstants::kProtocolErrorCode,
                               WebSocketCloseConstants::kProtocolErrorCodeDataOpcodeOutOfSequence);
                     }
                 }
-                else if (_chunks.empty())
+                else if (!_receivingFragmentedMessage)
                 {
                     // Continuation message need to follow a non-fin TEXT or BINARY message
                     close(
@@ -588,7 +679,7 @@ namespace ix
                 //
                 // Usual case. Small unfragmented messages
                 //
-                if (ws.fin && _chunks.empty())
+                if (ws.fin && !_receivingFragmentedMessage)
                 {
                     emitMessage(_fragmentedMessageKind,
                                 frameData,
@@ -600,22 +691,40 @@ namespace ix
                 else
                 {
                     //
-                    // Add intermediary message to our chunk list.
-                    // We use a chunk list instead of a big buffer because resizing
-                    // large buffer can be very costly when we need to re-allocate
-                    // the internal buffer which is slow and can let the internal OS
-                    // receive buffer fill out.
+                    // Add intermediary message to the reassembly buffer.
                     //
-                    _chunks.emplace_back(frameData);
+                    bool validateText = _fragmentedMessageKind == MessageKind::MSG_TEXT &&
+                                        !_receivedMessageCompressed;
+                    if (!_receivingFragmentedMessage)
+                    {
+                        _fragmentedMessageValidator.reset();
+                    }
+                    appendFragment(frameData, nextFrameOffset);
+
+                    // Fail fast on invalid text, without waiting for the last fragment
+                    if (validateText && (!_fragmentedMessageValidator.decode(frameData) ||
+                                         (ws.fin && !_fragmentedMessageValidator.complete())))
+                    {
+                        close(WebSocketCloseConstants::kInvalidFramePayloadData,
+                              WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
+                        return;
+                    }
 
                     if (ws.fin)
                     {
                         emitMessage(_fragmentedMessageKind,
-                                    getMergedChunks(),
+                                    _fragmentedMessage,
                                     _receivedMessageCompressed,
-                                    onMessageCallback);
-
-                        _chunks.clear();
+                                    onMessageCallback,
+                                    validateText);
+
+                        _receivingFragmentedMessage = false;
+                        _fragmentedMessage.clear();
+                        if (_fragmentedMessage.capacity() > kChunkSize)
+                        {
+                            // Do not hold on to the memory of a large message
+                            std::string().swap(_fragmentedMessage);
+                        }
                         _receivedMessageCompressed = false;
                     }
                     else
@@ -639,7 +748,9 @@ namespace ix
                 {
                     // Reply back right away
                     bool compress = false;
-                    sendData(wsheader_type::PONG, frameData, compress);
+                    sendData(wsheader_type::PONG,
+                             IXWebSocketSendData(frameData.data(), frameData.size()),
+                             compress);
                 }
 
                 emitMessage(MessageKind::PING, frameData, false, onMessageCallback);
@@ -657,13 +768,13 @@ namespace ix
                 if (ws.N >= 2)
                 {
                     // Extract the close code first, available as the first 2 bytes
-                    code |= ((uint64_t) _rxbuf[ws.header_size]) << 8;
-                    code |= ((uint64_t) _rxbuf[ws.header_size + 1]) << 0;
+                    code |= ((uint64_t) data[ws.header_size]) << 8;
+                    code |= ((uint64_t) data[ws.header_size + 1]) << 0;
 
                     // Get the reason.
                     if (ws.N > 2)
                     {
-                        reason = frameData.substr(2, frameData.size());
+                        reason = std::string(frameData.substr(2));
                     }
 
                     // Validate that the reason is proper utf-8. Autobahn 7.5.1
@@ -706,7 +817,7 @@ namespace ix
                     wakeUpFromPoll(SelectInterrupt::kCloseRequest);
 
                     bool remote = true;
-                    closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                    closeSocketAndSwitchToClosedState(code, reason, available, remote);
                 }
                 else
                 {
@@ -717,7 +828,7 @@ namespace ix
                     if (identicalReason)
                     {
                         bool remote = false;
-                        closeSocketAndSwitchToClosedState(code, reason, _rxbuf.size(), remote);
+                        closeSocketAndSwitchToClosedState(code, reason, available, remote);
                     }
                 }
             }
@@ -726,18 +837,19 @@ namespace ix
                 // Unexpected frame type
                 close(WebSocketCloseConstants::kProtocolErrorCode,
                       WebSocketCloseConstants::kProtocolErrorMessage,
-                      _rxbuf.size());
+                      available);
             }
 
-            // Erase the message that has been processed from the input/read buffer
-            _rxbuf.erase(_rxbuf.begin(), _rxbuf.begin() + ws.header_size + (size_t) ws.N);
+            // Skip the message that has been processed, the buffer is compacted
+            // before the next read
+            _rxbufOffset = nextFrameOffset;
         }
 
         // if an abnormal closure was raised in poll, and nothing else triggered a CLOSED state in
         // the received and processed data then close the connection
         if (pollResult != PollResult::Succeeded)
         {
-            _rxbuf.clear();
+            clearReceiveBuffer();
 
             // if we previously closed the connection (CLOSING state), then set state to CLOSED
             // (code/reason were set before)
@@ -757,29 +869,77 @@ namespace ix
         }
     }
 
-    std::string WebSocketTransport::getMergedChunks() const
+    void WebSocketTransport::appendFragment(std::string_view fragment, size_t nextFrameOffset)
     {
-        size_t length = 0;
-        for (auto&& chunk : _chunks)
+        if (!_receivingFragmentedMessage)
         {
-            length += chunk.size();
+            _receivingFragmentedMessage = true;
+            _fragmentedMessage.clear();
         }
 
-        std::string msg;
-        msg.reserve(length);
-
-        for (auto&& chunk : _chunks)
+        // Reserve for every fragment of this message that was already received, or at
+        // least double, so that a message arriving in many reads is copied O(1) times.
+        size_t required = _fragmentedMessage.size() + fragment.size() +
+                          (size_t) getBufferedContinuationSize(nextFrameOffset);
+        if (required > _fragmentedMessage.capacity())
         {
-            msg += chunk;
+            _fragmentedMessage.reserve(std::max(required, 2 * _fragmentedMessage.capacity()));
         }
 
-        return msg;
+        _fragmentedMessage.append(fragment.data(), fragment.size());
+    }
+
+    uint64_t WebSocketTransport::getBufferedContinuationSize(size_t offset) const
+    {
+        uint64_t size = 0;
+        while (_rxbuf.size() - offset >= 2)
+        {
+            const uint8_t* data = &_rxbuf[offset];
+            bool fin = (data[0] & 0x80) == 0x80;
+            auto opcode = (wsheader_type::opcode_type)(data[0] & 0x0f);
+            bool mask = (data[1] & 0x80) == 0x80;
+            int N0 = data[1] & 0x7f;
+            size_t headerSize = 2 + (N0 == 126 ? 2 : 0) + (N0 == 127 ? 8 : 0) + (mask ? 4 : 0);
+            if (_rxbuf.size() - offset < headerSize) break;
+
+            uint64_t N = (uint64_t) N0;
+            if (N0 == 126)
+            {
+                N = ((uint64_t) data[2] << 8) | data[3];
+            }
+            else if (N0 == 127)
+            {
+                N = 0;
+                for (int i = 2; i < 10; ++i)
+                {
+                    N = (N << 8) | data[i];
+                }
+            }
+
+            // Only count frames whose payload was received, N comes from the peer and
+            // must not size an allocation by itself. The total stays below _rxbuf.size().
+            if (N > (uint64_t) (_rxbuf.size() - offset - headerSize)) break;
+
+            // Control frames may be interleaved with the fragments
+            if (opcode == wsheader_type::CONTINUATION)
+            {
+                size += N;
+                if (fin) break;
+            }
+            else if (opcode != wsheader_type::PING && opcode != wsheader_type::PONG)
+            {
+                break;
+            }
+            offset += headerSize + (size_t) N;
+        }
+        return size;
     }
 
     void WebSocketTransport::emitMessage(MessageKind messageKind,
-                                         const std::string& message,
+                                         std::string_view message,
                                          bool compressedMessage,
-                                         const OnMessageCallback& onMessageCallback)
+                                         const OnMessageCallback& onMessageCallback,
+                                         bool utf8Validated)
     {
         size_t wireSize = message.size();
 
@@ -800,7 +960,7 @@ namespace ix
         }
         else
         {
-            if (messageKind == MessageKind::MSG_TEXT && !validateUtf8(message))
+            if (messageKind == MessageKind::MSG_TEXT && !utf8Validated && !validateUtf8(message))
             {
                 close(WebSocketCloseConstants::kInvalidFramePayloadData,
                       WebSocketCloseConstants::kInvalidFramePayloadDataMessage);
@@ -823,7 +983,8 @@ namespace ix
     WebSocketSendInfo WebSocketTransport::sendData(wsheader_type::opcode_type type,
                                                    const IXWebSocketSendData& message,
                                                    bool compress,
-                                                   const OnProgressCallback& onProgressCallback)
+                                                   const OnProgressCallback& onProgressCallback,
+                                                   bool precompressed)
     {
         if (_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING)
         {
@@ -834,8 +995,9 @@ namespace ix
         size_t wireSize = message.size();
         bool compressionError = false;
 
-        auto message_begin = message.cbegin();
-        auto message_end = message.cend();
+        const char* message_begin = message.data();
+        const char* message_end = message_begin + message.size();
+        std::shared_ptr<const std::string> owner = message.owner();
 
         if (compress)
         {
@@ -850,22 +1012,20 @@ namespace ix
             compressionError = false;
             wireSize = _compressedMessage.size();
 
-            IXWebSocketSendData compressedSendData(_compressedMessage);
-            message_begin = compressedSendData.cbegin();
-            message_end = compressedSendData.cend();
-        }
-
-        {
-            std::lock_guard<std::mutex> lock(_txbufMutex);
-            _txbuf.reserve(wireSize);
+            // The fragments reference the compressed message instead of copying it
+            owner = std::make_shared<const std::string>(std::move(_compressedMessage));
+            message_begin = owner->data();
+            message_end = message_begin + owner->size();
         }
 
+        // rsv1 is set on the first frame of compressed messages
+        bool compressed = compress || precompressed;
         bool success = true;
 
         // Common case for most message. No fragmentation required.
         if (wireSize < kChunkSize)
         {
-            success = sendFragment(type, true, message_begin, message_end, compress);
+            success = sendFragment(type, true, message_begin, message_end, owner, compressed);
 
             if (onProgressCallback)
             {
@@ -906,7 +1066,7 @@ namespace ix
                 }
 
                 // Send message
-                if (!sendFragment(opcodeType, fin, begin, end, compress))
+                if (!sendFragment(opcodeType, fin, begin, end, owner, compressed))
                 {
                     return WebSocketSendInfo(false);
                 }
@@ -935,26 +1095,16 @@ namespace ix
         return WebSocketSendInfo(success, compressionError, payloadSize, wireSize);
     }
 
-    template<class Iterator>
-    bool WebSocketTransport::sendFragment(wsheader_type::opcode_type type,
-                                          bool fin,
-                                          Iterator message_begin,
-                                          Iterator message_end,
-                                          bool compress)
+    size_t WebSocketTransport::encodeFrameHeader(std::array<uint8_t, 14>& header,
+                                                 wsheader_type::opcode_type type,
+                                                 bool fin,
+                                                 bool compressed,
+                                                 uint64_t message_size,
+                                                 const uint8_t* masking_key)
     {
-        uint64_t message_size = static_cast<uint64_t>(message_end - message_begin);
-
-        unsigned x = getRandomUnsigned();
-        uint8_t masking_key[4] = {};
-        masking_key[0] = (x >> 24);
-        masking_key[1] = (x >> 16) & 0xff;
-        masking_key[2] = (x >> 8) & 0xff;
-        masking_key[3] = (x) &0xff;
-
-        std::vector<uint8_t> header;
-        header.assign(2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) +
-                          (_useMask ? 4 : 0),
-                      0);
+        bool useMask = masking_key != nullptr;
+        size_t headerSize = 2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) +
+                            (useMask ? 4 : 0);
         header[0] = type;
 
         // The fin bit indicate that this is the last fragment. Fin is French for end.
@@ -965,16 +1115,16 @@ namespace ix
 
         // The rsv1 bit indicate that the frame is compressed
         // continuation opcodes should not set it. Autobahn 12.2.10 and others 12.X
-        if (compress && type != wsheader_type::CONTINUATION)
+        if (compressed && type != wsheader_type::CONTINUATION)
         {
             header[0] |= 0x40;
         }
 
         if (message_size < 126)
         {
-            header[1] = (message_size & 0xff) | (_useMask ? 0x80 : 0);
+            header[1] = (message_size & 0xff) | (useMask ? 0x80 : 0);
 
-            if (_useMask)
+            if (useMask)
             {
                 header[2] = masking_key[0];
                 header[3] = masking_key[1];
@@ -984,11 +1134,11 @@ namespace ix
         }
         else if (message_size < 65536)
         {
-            header[1] = 126 | (_useMask ? 0x80 : 0);
+            header[1] = 126 | (useMask ? 0x80 : 0);
             header[2] = (message_size >> 8) & 0xff;
             header[3] = (message_size >> 0) & 0xff;
 
-            if (_useMask)
+            if (useMask)
             {
                 header[4] = masking_key[0];
                 header[5] = masking_key[1];
@@ -998,7 +1148,7 @@ namespace ix
         }
         else
         { // TODO: run coverage testing here
-            header[1] = 127 | (_useMask ? 0x80 : 0);
+            header[1] = 127 | (useMask ? 0x80 : 0);
             header[2] = (message_size >> 56) & 0xff;
             header[3] = (message_size >> 48) & 0xff;
             header[4] = (message_size >> 40) & 0xff;
@@ -1008,7 +1158,7 @@ namespace ix
             header[8] = (message_size >> 8) & 0xff;
             header[9] = (message_size >> 0) & 0xff;
 
-            if (_useMask)
+            if (useMask)
             {
                 header[10] = masking_key[0];
                 header[11] = masking_key[1];
@@ -1017,8 +1167,31 @@ namespace ix
             }
         }
 
+        return headerSize;
+    }
+
+    bool WebSocketTransport::sendFragment(wsheader_type::opcode_type type,
+                                          bool fin,
+                                          const char* message_begin,
+                                          const char* message_end,
+                                          const std::shared_ptr<const std::string>& owner,
+                                          bool compress)
+    {
+        uint64_t message_size = static_cast<uint64_t>(message_end - message_begin);
+
+        unsigned x = getRandomUnsigned();
+        uint8_t masking_key[4] = {};
+        masking_key[0] = (x >> 24);
+        masking_key[1] = (x >> 16) & 0xff;
+        masking_key[2] = (x >> 8) & 0xff;
+        masking_key[3] = (x) &0xff;
+
+        std::array<uint8_t, 14> header {};
+        size_t headerSize = encodeFrameHeader(
+            header, type, fin, compress, message_size, _useMask ? masking_key : nullptr);
+
         // _txbuf will keep growing until it can be transmitted over the socket:
-        appendToSendBuffer(header, message_begin, message_end, message_size, masking_key);
+        appendToSendBuffer(header, headerSize, message_begin, message_end, owner, masking_key);
 
         // Now actually send this data
         return sendOnSocket();
@@ -1054,16 +1227,141 @@ namespace ix
             wsheader_type::TEXT_FRAME, message, _enablePerMessageDeflate, onProgressCallback);
     }
 
+    bool WebSocketTransport::canSendPrecompressed(uint8_t windowBits) const
+    {
+        return _enablePerMessageDeflate && _perMessageDeflate &&
+               _perMessageDeflate->canShareCompressedMessages(windowBits);
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendPrecompressed(const IXWebSocketSendData& message,
+                                                            uint8_t windowBits,
+                                                            bool binary)
+    {
+        if (!canSendPrecompressed(windowBits))
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        bool compress = false;
+        bool precompressed = true;
+        return sendData(binary ? wsheader_type::BINARY_FRAME : wsheader_type::TEXT_FRAME,
+                        message,
+                        compress,
+                        nullptr,
+                        precompressed);
+    }
+
+    std::string WebSocketTransport::encodeFrames(const IXWebSocketSendData& message,
+                                                 bool binary,
+                                                 bool compressed)
+    {
+        auto type = binary ? wsheader_type::BINARY_FRAME : wsheader_type::TEXT_FRAME;
+
+        // Same fragmentation as sendData
+        size_t steps = (message.size() < kChunkSize) ? 1 : message.size() / kChunkSize;
+
+        std::string frames;
+        frames.reserve(message.size() + steps * 10);
+
+        const char* begin = message.data();
+        const char* message_end = begin + message.size();
+
+        for (size_t i = 0; i < steps; ++i)
+        {
+            bool lastStep = (i + 1) == steps;
+            const char* end = lastStep ? message_end : begin + kChunkSize;
+
+            std::array<uint8_t, 14> header {};
+            size_t headerSize = encodeFrameHeader(header,
+                                                  (i == 0) ? type : wsheader_type::CONTINUATION,
+                                                  lastStep,
+                                                  compressed,
+                                                  static_cast<uint64_t>(end - begin),
+                                                  nullptr);
+
+            frames.append(reinterpret_cast<const char*>(header.data()), headerSize);
+            frames.append(begin, end);
+            begin = end;
+        }
+
+        return frames;
+    }
+
+    WebSocketSendInfo WebSocketTransport::sendEncodedFrames(
+        const std::shared_ptr<const std::string>& frames, uint8_t windowBits)
+    {
+        if (_readyState != ReadyState::OPEN && _readyState != ReadyState::CLOSING)
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        // Clients mask every frame, and compressed frames must match the negotiation
+        if (!frames || _useMask || (windowBits != 0 && !canSendPrecompressed(windowBits)))
+        {
+            return WebSocketSendInfo(false);
+        }
+
+        std::array<uint8_t, 14> header {};
+        uint8_t masking_key[4] = {};
+        appendToSendBuffer(
+            header, 0, frames->data(), frames->data() + frames->size(), frames, masking_key);
+
+        bool success = sendOnSocket();
+
+        if (!isSendBufferEmpty())
+        {
+            wakeUpFromPoll(SelectInterrupt::kSendRequest);
+
+            if (_blockingSend && !flushSendBuffer())
+            {
+                success = false;
+            }
+        }
+
+        return WebSocketSendInfo(success, false, frames->size(), frames->size());
+    }
+
+    WebSocketPerMessageDeflateOptions WebSocketTransport::getPerMessageDeflateOptions() const
+    {
+        return _enablePerMessageDeflate ? _perMessageDeflateOptions
+                                        : WebSocketPerMessageDeflateOptions(false);
+    }
+
     bool WebSocketTransport::sendOnSocket()
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
 
-        while (_txbuf.size())
+        while (!_txbuf.empty())
         {
+            // Gather the headers and payloads of as many queued frames as possible
+            std::array<SendBuffer, Socket::kMaxSendBuffers> buffers;
+            size_t count = 0;
+            size_t offset = _txbufOffset;
+            for (auto it = _txbuf.begin(); it != _txbuf.end() && count + 2 <= buffers.size(); ++it)
+            {
+                if (offset < it->headerSize)
+                {
+                    buffers[count++] = {
+                        reinterpret_cast<const char*>(it->header.data()) + offset,
+                        it->headerSize - offset};
+                    offset = 0;
+                }
+                else
+                {
+                    offset -= it->headerSize;
+                }
+
+                if (offset < it->payloadSize)
+                {
+                    buffers[count++] = {it->payload + offset, it->payloadSize - offset};
+                }
+                offset = 0;
+            }
+
             ssize_t ret = 0;
             {
                 std::lock_guard<std::mutex> lock(_socketMutex);
-                ret = _socket->send((char*) &_txbuf[0], _txbuf.size());
+                ret = _socket->sendv(buffers.data(), count);
             }
 
             if (ret < 0 && Socket::isWaitNeeded())
@@ -1081,15 +1379,32 @@ namespace ix
             }
             else
             {
-                _txbuf.erase(_txbuf.begin(), _txbuf.begin() + ret);
+                consumeSendBuffer((size_t) ret);
             }
         }
 
         return true;
     }
 
+    void WebSocketTransport::compactReceiveBuffer()
+    {
+        if (_rxbufOffset == 0) return;
+
+        // Only the tail of a partially received frame is ever moved
+        _rxbuf.erase(_rxbuf.begin(), _rxbuf.begin() + _rxbufOffset);
+        _rxbufOffset = 0;
+    }
+
+    void WebSocketTransport::clearReceiveBuffer()
+    {
+        _rxbuf.clear();
+        _rxbufOffset = 0;
+    }
+
     bool WebSocketTransport::receiveFromSocket()
     {
+        compactReceiveBuffer();
+
         while (true)
         {
             ssize_t ret = _socket->recv((char*) &_readbuf[0], _readbuf.size());
@@ -1151,6 +1466,11 @@ namespace ix
         return _socket->wakeUpFromPoll(wakeUpCode);
     }
 
+    bool WebSocketTransport::requestWakeUp()
+    {
+        return wakeUpFromPoll(SelectInterrupt::kSendRequest);
+    }
+
     void WebSocketTransport::closeSocketAndSwitchToClosedState(uint16_t code,
                                                                const std::string& reason,
                                                                size_t closeWireSize,
@@ -1216,7 +1536,7 @@ namespace ix
     size_t WebSocketTransport::bufferedAmount() const
     {
         std::lock_guard<std::mutex> lock(_txbufMutex);
-        return _txbuf.size();
+        return _txbufSize;
     }
 
     bool WebSocketTransport::flushSendBuffer()
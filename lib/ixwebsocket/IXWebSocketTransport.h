@@ -13,6 +13,7 @@
 #include "IXCancellationRequest.h"
 #include "IXProgressCallback.h"
 #include "IXSocketTLSOptions.h"
+#include "IXUtf8Validator.h"
 #include "IXWebSocketCloseConstants.h"
 #include "IXWebSocketHandshake.h"
 #include "IXWebSocketHttpHeaders.h"
@@ -20,13 +21,15 @@
 #include "IXWebSocketPerMessageDeflateOptions.h"
 #include "IXWebSocketSendData.h"
 #include "IXWebSocketSendInfo.h"
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <deque>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace ix
@@ -67,8 +70,10 @@ namespace ix
             CannotFlushSendBuffer
         };
 
+        // The payload view points into the receive (or reassembly) buffer and is
+        // only valid for the duration of the callback.
         using OnMessageCallback =
-            std::function<void(const std::string&, size_t, bool, MessageKind)>;
+            std::function<void(std::string_view, size_t, bool, MessageKind)>;
         using OnCloseCallback = std::function<void(uint16_t, const std::string&, size_t, bool)>;
 
         WebSocketTransport();
@@ -85,18 +90,45 @@ namespace ix
                                          int timeoutSecs);
 
         // Server
-        WebSocketInitResult connectToSocket(std::unique_ptr<Socket> socket,
-                                            int timeoutSecs,
-                                            bool enablePerMessageDeflate,
-                                            HttpRequestPtr request = nullptr);
+        WebSocketInitResult connectToSocket(
+            std::unique_ptr<Socket> socket,
+            int timeoutSecs,
+            bool enablePerMessageDeflate,
+            HttpRequestPtr request = nullptr,
+            const std::vector<std::string>& subProtocols = std::vector<std::string>());
 
         PollResult poll();
+
+        // Event loop mode: the socket is watched by an EventLoop which calls this,
+        // without blocking, instead of poll() when the socket is ready and on every tick.
+        PollResult handleSocketEvents(bool readable, bool writable, bool closeRequested);
+        void setBlockingSend(bool blockingSend);
+
         WebSocketSendInfo sendBinary(const IXWebSocketSendData& message,
                                      const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendText(const IXWebSocketSendData& message,
                                    const OnProgressCallback& onProgressCallback);
         WebSocketSendInfo sendPing(const IXWebSocketSendData& message);
 
+        // Messages compressed on their own, by a fresh deflate stream with a window of
+        // windowBits, can be sent as is when this returns true
+        bool canSendPrecompressed(uint8_t windowBits) const;
+        WebSocketSendInfo sendPrecompressed(const IXWebSocketSendData& message,
+                                            uint8_t windowBits,
+                                            bool binary);
+
+        // Server side: the unmasked frames of a message only depend on the payload, so
+        // they can be encoded once and queued as is on many connections. windowBits is
+        // 0 for uncompressed frames, else the window the payload was deflated with.
+        static std::string encodeFrames(const IXWebSocketSendData& message,
+                                        bool binary,
+                                        bool compressed);
+        WebSocketSendInfo sendEncodedFrames(const std::shared_ptr<const std::string>& frames,
+                                            uint8_t windowBits);
+
+        // Parameters negotiated by the handshake, disabled if permessage-deflate is not used
+        WebSocketPerMessageDeflateOptions getPerMessageDeflateOptions() const;
+
         void close(uint16_t code = WebSocketCloseConstants::kNormalClosureCode,
                    const std::string& reason = WebSocketCloseConstants::kNormalClosureMessage,
                    size_t closeWireSize = 0,
@@ -110,6 +142,9 @@ namespace ix
         void dispatch(PollResult pollResult, const OnMessageCallback& onMessageCallback);
         size_t bufferedAmount() const;
 
+        // interrupt a pending poll() from another thread
+        bool requestWakeUp();
+
         // set ping heartbeat message
         void setPingMessage(const std::string& message, SendMessageKind pingType);
 
@@ -158,15 +193,39 @@ namespace ix
         // data messages. That buffer is resized
         std::vector<uint8_t> _rxbuf;
 
-        // Contains all messages that are waiting to be sent
-        std::vector<uint8_t> _txbuf;
+        // Bytes at the front of _rxbuf which were already dispatched. Consuming a
+        // frame only moves this offset, so a burst of small frames costs a single
+        // compaction (of the last partial frame) instead of one memmove per frame.
+        size_t _rxbufOffset;
+
+        // A frame waiting to be sent. The payload is either owned, or shared with the
+        // sender, so a broadcast payload is referenced by every client, not copied.
+        struct SendSegment
+        {
+            std::array<uint8_t, 14> header;
+            size_t headerSize;
+            std::string ownedPayload;
+            std::shared_ptr<const std::string> sharedPayload;
+            const char* payload;
+            size_t payloadSize;
+        };
+
+        // Contains all frames that are waiting to be sent, flushed with gathered sends.
+        // The first _txbufOffset bytes of the front frame were already sent.
+        std::deque<SendSegment> _txbuf;
+        size_t _txbufOffset;
+        size_t _txbufSize;
         mutable std::mutex _txbufMutex;
 
-        // Hold fragments for multi-fragments messages in a list. We support receiving very large
-        // messages (tested messages up to 700M) and we cannot put them in a single
-        // buffer that is resized, as this operation can be slow when a buffer has its
-        // size increased 2 fold, while appending to a list has a fixed cost.
-        std::list<std::string> _chunks;
+        // Reassembly buffer for multi-fragments messages. We support receiving very large
+        // messages (tested messages up to 700M), so it is reserved from the lengths of the
+        // fragments already sitting in _rxbuf, and grows at least 2 fold otherwise.
+        std::string _fragmentedMessage;
+        bool _receivingFragmentedMessage;
+
+        // Uncompressed text fragments are validated as they arrive, so the merged
+        // message does not need to be scanned again.
+        Utf8Validator _fragmentedMessageValidator;
 
         // Record the message kind (will be TEXT or BINARY) for a fragmented
         // message, present in the first chunk, since the final chunk will be a
@@ -238,6 +297,10 @@ namespace ix
         // should close the connexion
         bool closingDelayExceeded();
 
+        // Timers shared by poll() and handleSocketEvents()
+        void checkHeartBeat();
+        void checkClosingDelay();
+
         void sendCloseFrame(uint16_t code, const std::string& reason);
 
         void closeSocketAndSwitchToClosedState(uint16_t code,
@@ -250,34 +313,50 @@ namespace ix
         bool flushSendBuffer();
         bool sendOnSocket();
         bool receiveFromSocket();
+        void compactReceiveBuffer();
+        void clearReceiveBuffer();
 
         WebSocketSendInfo sendData(wsheader_type::opcode_type type,
                                    const IXWebSocketSendData& message,
                                    bool compress,
-                                   const OnProgressCallback& onProgressCallback = nullptr);
-
-        template<class Iterator>
-        bool sendFragment(
-            wsheader_type::opcode_type type, bool fin, Iterator begin, Iterator end, bool compress);
+                                   const OnProgressCallback& onProgressCallback = nullptr,
+                                   bool precompressed = false);
+
+        static size_t encodeFrameHeader(std::array<uint8_t, 14>& header,
+                                        wsheader_type::opcode_type type,
+                                        bool fin,
+                                        bool compressed,
+                                        uint64_t message_size,
+                                        const uint8_t* masking_key);
+
+        bool sendFragment(wsheader_type::opcode_type type,
+                          bool fin,
+                          const char* begin,
+                          const char* end,
+                          const std::shared_ptr<const std::string>& owner,
+                          bool compress);
 
         void emitMessage(MessageKind messageKind,
-                         const std::string& message,
+                         std::string_view message,
                          bool compressedMessage,
-                         const OnMessageCallback& onMessageCallback);
+                         const OnMessageCallback& onMessageCallback,
+                         bool utf8Validated = false);
 
         bool isSendBufferEmpty() const;
 
-        template<class Iterator>
-        void appendToSendBuffer(const std::vector<uint8_t>& header,
-                                Iterator begin,
-                                Iterator end,
-                                uint64_t message_size,
+        void appendToSendBuffer(const std::array<uint8_t, 14>& header,
+                                size_t headerSize,
+                                const char* begin,
+                                const char* end,
+                                const std::shared_ptr<const std::string>& owner,
                                 uint8_t masking_key[4]);
+        void consumeSendBuffer(size_t size);
 
         unsigned getRandomUnsigned();
         void unmaskReceiveBuffer(const wsheader_type& ws);
 
-        std::string getMergedChunks() const;
+        void appendFragment(std::string_view fragment, size_t nextFrameOffset);
+        uint64_t getBufferedContinuationSize(size_t offset) const;
 
         void setCloseReason(const std::string& reason);
         const std::string& getCloseReason() const;
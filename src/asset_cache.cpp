@@ -0,0 +1,421 @@
+/**
+ * @file asset_cache.cpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Implementation of the AssetCache and ETagCache classes.
+ *
+ * This file contains the implementation of the AssetCache class, which keeps the files under the web root in memory together with their precompressed variants,
+ * and of the ETagCache class, which remembers the ETags of the files streamed from disk.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <asset_cache.hpp>
+#include <httplib.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+#ifdef IXWEBSOCKET_USE_ZLIB
+// zlib is linked whenever the build enables it for the WebSocket server, see the --zlib option in wscript
+#include <zlib.h>
+#endif
+#include <log.h>
+
+using namespace httpservernp;
+
+/**
+ * @brief Stamp a file, following symbolic links.
+ *
+ * @param path The path to the file.
+ * @param stamp The stamp of the file, size is -1 if the file does not exist.
+ * @param mode The type and permissions of the file.
+ * @return True if the file exists.
+ */
+static bool stat_file(const std::string &path, FileStamp &stamp, mode_t &mode) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        stamp = FileStamp();
+        return false;
+    }
+    stamp = FileStamp::of(st);
+    mode = st.st_mode;
+    return true;
+}
+
+/**
+ * @brief Stamp a regular file.
+ *
+ * @param path The path to the file.
+ * @return The stamp of the file, size is -1 if it is not a regular file.
+ */
+static FileStamp stamp_regular_file(const std::string &path) {
+    FileStamp stamp;
+    mode_t mode = 0;
+    if (!stat_file(path, stamp, mode) || !S_ISREG(mode))
+        return FileStamp();
+    return stamp;
+}
+
+/**
+ * @brief Read a whole file.
+ *
+ * @param path The path to the file.
+ * @param content The file content.
+ * @return True if the file was read.
+ */
+static bool read_whole_file(const std::string &path, std::string &content) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.seekg(0, std::ios::end);
+    auto size = file.tellg();
+    if (size < 0)
+        return false;
+    content.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    file.read(&content[0], size);
+    return static_cast<bool>(file);
+}
+
+/**
+ * @brief Whether compressing a file of this type is worth it.
+ *
+ * @param content_type The MIME type of the file.
+ * @return bool
+ */
+static bool is_compressible(const std::string &content_type) {
+    return content_type.compare(0, 5, "text/") == 0 || content_type.find("javascript") != std::string::npos ||
+           content_type.find("json") != std::string::npos || content_type.find("xml") != std::string::npos ||
+           content_type == "application/wasm";
+}
+
+/**
+ * @brief gzip a buffer with the best compression.
+ *
+ * @param in The data to compress.
+ * @param out The compressed data.
+ * @return True if compressed, false if zlib is not available or fails.
+ */
+static bool gzip_compress(const std::string &in, std::string &out) {
+#ifdef IXWEBSOCKET_USE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // 15 + 16: largest window with a gzip header
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END;
+#else
+    (void)in;
+    (void)out;
+    return false;
+#endif
+}
+
+/**
+ * @brief Feed data to a 64-bit FNV-1a hash.
+ *
+ * @param hash The hash so far.
+ * @param data The data.
+ * @param size Bytes of data.
+ * @return uint64_t The updated hash.
+ */
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static constexpr uint64_t fnv1a_basis = 0xcbf29ce484222325ULL;
+
+/**
+ * @brief Format a strong ETag from a content hash and the content length.
+ *
+ * @param hash The 64-bit FNV-1a hash of the content.
+ * @param size The content length.
+ * @return std::string The ETag without quotes.
+ */
+static std::string hash_etag(uint64_t hash, size_t size) {
+    char etag[48];
+    snprintf(etag, sizeof(etag), "%016" PRIx64 "-%zx", hash, size);
+    return etag;
+}
+
+/**
+ * @brief Strong ETag of a content: 64-bit FNV-1a hash and the length.
+ *
+ * @param content The content.
+ * @return std::string The ETag without quotes.
+ */
+static std::string content_etag(const std::string &content) {
+    return hash_etag(fnv1a(fnv1a_basis, content.data(), content.size()), content.size());
+}
+
+AssetCache::AssetCache(size_t max_file_bytes, size_t max_total_bytes) : max_file_bytes(max_file_bytes),
+                                                                        max_total_bytes(max_total_bytes),
+                                                                        assets(std::make_shared<const AssetMap>()),
+                                                                        assets_bytes(0),
+                                                                        inotify_fd(-1),
+                                                                        stop_fd(-1) {}
+
+AssetCache::~AssetCache() {
+    this->close();
+}
+
+bool AssetCache::open(const std::string &root) {
+    this->close();
+    FileStamp stamp;
+    mode_t mode = 0;
+    if (!stat_file(root, stamp, mode) || !S_ISDIR(mode)) {
+        logf_warn("asset cache: %s is not a directory\n", root.c_str());
+        return false;
+    }
+    this->root = root;
+    while (this->root.size() > 1 && this->root.back() == '/')
+        this->root.pop_back();
+
+    this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotify_fd < 0)
+        logf_warn("asset cache: inotify unavailable, changes under %s will not be picked up: %s\n", this->root.c_str(), strerror(errno));
+    this->reload();
+
+    if (this->inotify_fd >= 0) {
+        this->stop_fd = eventfd(0, EFD_CLOEXEC);
+        if (this->stop_fd >= 0) {
+            this->watcher = std::thread(&AssetCache::watch, this);
+        } else {
+            logf_warn("asset cache: eventfd failed, changes under %s will not be picked up: %s\n", this->root.c_str(), strerror(errno));
+            ::close(this->inotify_fd);
+            this->inotify_fd = -1;
+        }
+    }
+    return true;
+}
+
+void AssetCache::close() {
+    if (this->watcher.joinable()) {
+        uint64_t one = 1;
+        if (write(this->stop_fd, &one, sizeof(one)) != sizeof(one))
+            logf_warn("asset cache: cannot wake the watcher up: %s\n", strerror(errno));
+        this->watcher.join();
+    }
+    if (this->stop_fd >= 0)
+        ::close(this->stop_fd);
+    if (this->inotify_fd >= 0)
+        ::close(this->inotify_fd);
+    this->stop_fd = -1;
+    this->inotify_fd = -1;
+    std::atomic_store(&this->assets, std::make_shared<const AssetMap>());
+    this->assets_bytes = 0;
+}
+
+std::shared_ptr<const Asset> AssetCache::find(const std::string &path) const {
+    auto snapshot = std::atomic_load(&this->assets);
+    auto it = snapshot->find(path);
+    return it == snapshot->end() ? nullptr : it->second;
+}
+
+size_t AssetCache::size() const {
+    return std::atomic_load(&this->assets)->size();
+}
+
+size_t AssetCache::total_bytes() const {
+    return this->assets_bytes.load();
+}
+
+void AssetCache::reload() {
+    auto previous = std::atomic_load(&this->assets);
+    auto updated = std::make_shared<AssetMap>();
+    size_t total = 0;
+    DirectorySet visited;
+    FileStamp stamp;
+    mode_t mode = 0;
+    if (stat_file(this->root, stamp, mode))
+        visited.emplace(stamp.device, stamp.inode);
+    this->scan(this->root, "/", *previous, *updated, total, visited);
+    std::atomic_store(&this->assets, std::shared_ptr<const AssetMap>(std::move(updated)));
+    this->assets_bytes = total;
+    logf_info("asset cache: %zu files, %zu bytes from %s\n", this->size(), total, this->root.c_str());
+}
+
+void AssetCache::scan(const std::string &dir, const std::string &prefix, const AssetMap &previous, AssetMap &assets, size_t &total, DirectorySet &visited) {
+    if (this->inotify_fd >= 0 &&
+        inotify_add_watch(this->inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+        logf_warn("asset cache: cannot watch %s: %s\n", dir.c_str(), strerror(errno));
+
+    DIR *handle = opendir(dir.c_str());
+    if (!handle) {
+        logf_warn("asset cache: cannot open %s: %s\n", dir.c_str(), strerror(errno));
+        return;
+    }
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(handle)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, ".."))
+            names.emplace_back(entry->d_name);
+    }
+    closedir(handle);
+
+    for (const auto &name : names) {
+        std::string file = dir + "/" + name;
+        FileStamp stamp;
+        mode_t mode = 0;
+        if (!stat_file(file, stamp, mode))
+            continue;
+        if (S_ISDIR(mode)) {
+            // a symbolic link back to a directory already scanned would recurse forever
+            if (visited.emplace(stamp.device, stamp.inode).second)
+                this->scan(file, prefix + name + "/", previous, assets, total, visited);
+            continue;
+        }
+        if (!S_ISREG(mode) || static_cast<size_t>(stamp.size) > this->max_file_bytes)
+            continue;
+        // .gz and .br files next to an original are its variants, not assets of their own
+        auto is_variant_of = [&](const char *suffix) {
+            size_t length = strlen(suffix);
+            return name.size() > length && name.compare(name.size() - length, length, suffix) == 0 &&
+                   stamp_regular_file(file.substr(0, file.size() - length)).size >= 0;
+        };
+        if (is_variant_of(".gz") || is_variant_of(".br"))
+            continue;
+
+        std::string path = prefix + name;
+        auto it = previous.find(path);
+        auto asset = this->load(file, stamp, it == previous.end() ? nullptr : it->second);
+        if (!asset)
+            continue;
+        size_t bytes = asset->identity->size() + (asset->gzip ? asset->gzip->size() : 0) + (asset->brotli ? asset->brotli->size() : 0);
+        if (total + bytes > this->max_total_bytes) {
+            logf_debug("asset cache: %s left on disk, cache is full\n", file.c_str());
+            continue;
+        }
+        total += bytes;
+        assets.emplace(std::move(path), std::move(asset));
+    }
+}
+
+std::shared_ptr<const Asset> AssetCache::load(const std::string &file, const FileStamp &stamp, const std::shared_ptr<const Asset> &previous) {
+    FileStamp gzip_stamp = stamp_regular_file(file + ".gz");
+    FileStamp brotli_stamp = stamp_regular_file(file + ".br");
+    if (previous && previous->stamp == stamp && previous->gzip_stamp == gzip_stamp && previous->brotli_stamp == brotli_stamp)
+        return previous;
+
+    auto asset = std::make_shared<Asset>();
+    std::string content;
+    if (!read_whole_file(file, content)) {
+        logf_warn("asset cache: cannot read %s\n", file.c_str());
+        return nullptr;
+    }
+    const char *type = httplib::detail::find_content_type(file, {});
+    asset->content_type = type ? type : "application/octet-stream";
+    asset->etag = content_etag(content);
+    asset->stamp = stamp;
+    asset->gzip_stamp = gzip_stamp;
+    asset->brotli_stamp = brotli_stamp;
+
+    std::string encoded;
+    if (brotli_stamp.size >= 0 && read_whole_file(file + ".br", encoded))
+        asset->brotli = std::make_shared<const std::string>(std::move(encoded));
+    encoded.clear();
+    if (gzip_stamp.size >= 0) {
+        if (read_whole_file(file + ".gz", encoded))
+            asset->gzip = std::make_shared<const std::string>(std::move(encoded));
+    } else if (content.size() >= 256 && is_compressible(asset->content_type) && gzip_compress(content, encoded) &&
+               encoded.size() < content.size() - content.size() / 10) {
+        // saving less than a tenth is not worth the decompression on the client
+        asset->gzip = std::make_shared<const std::string>(std::move(encoded));
+    }
+    asset->identity = std::make_shared<const std::string>(std::move(content));
+    return asset;
+}
+
+void AssetCache::watch() {
+    pollfd fds[2] = {{this->inotify_fd, POLLIN, 0}, {this->stop_fd, POLLIN, 0}};
+    alignas(struct inotify_event) char buffer[4096];
+    bool dirty = false;
+    while (true) {
+        int ready = poll(fds, 2, dirty ? reload_delay_ms : -1);
+        if (ready < 0) {
+            if (errno == EINTR)
+                continue;
+            logf_err("asset cache: poll failed: %s\n", strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        if (ready == 0) {
+            // a deployment touches many files at once, reload once it has settled
+            dirty = false;
+            this->reload();
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            while (read(this->inotify_fd, buffer, sizeof(buffer)) > 0) {
+            }
+            dirty = true;
+        }
+    }
+}
+
+ETagCache::ETagCache(size_t max_entries, size_t max_hash_bytes) : max_entries(max_entries),
+                                                                  max_hash_bytes(max_hash_bytes) {}
+
+std::string ETagCache::get(const std::string &path, int fd, const FileStamp &stamp) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->entries.find(path);
+        if (it != this->entries.end() && it->second.first == stamp)
+            return it->second.second;
+    }
+
+    std::string etag;
+    if (static_cast<size_t>(stamp.size) > this->max_hash_bytes) {
+        // inode, size and modification time change together with the content of a file replaced or rewritten in place
+        char buffer[80];
+        snprintf(buffer, sizeof(buffer), "%" PRIx64 "-%" PRIx64 "-%" PRIx64 ".%lx", static_cast<uint64_t>(stamp.inode),
+                 static_cast<uint64_t>(stamp.size), static_cast<uint64_t>(stamp.mtime), stamp.mtime_ns);
+        etag = buffer;
+    } else {
+        // hashed outside the lock, two requests racing on a new file both hash it
+        uint64_t hash = fnv1a_basis;
+        char buffer[64 * 1024];
+        size_t offset = 0;
+        while (offset < static_cast<size_t>(stamp.size)) {
+            ssize_t n = pread(fd, buffer, sizeof(buffer), static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                logf_warn("etag cache: cannot read %s\n", path.c_str());
+                return std::string();
+            }
+            hash = fnv1a(hash, buffer, static_cast<size_t>(n));
+            offset += static_cast<size_t>(n);
+        }
+        etag = hash_etag(hash, offset);
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->entries.size() >= this->max_entries)
+        this->entries.clear();
+    this->entries[path] = std::make_pair(stamp, etag);
+    return etag;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file asset_cache.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Declaration of the AssetCache and ETagCache classes.
+ *
+ * This file contains the declaration of the AssetCache class, which keeps the files under the web root in memory together with their precompressed variants,
+ * and of the ETagCache class, which remembers the ETags of the files streamed from disk.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace httpservernp
+{
+    /**
+     * @brief Identity of a file on disk, used to tell whether it changed since it was loaded.
+     */
+    struct FileStamp {
+        dev_t device = 0;  /** Device of the file. */
+        ino_t inode = 0;   /** Inode of the file. */
+        off_t size = -1;   /** Size in bytes, -1 if the file does not exist. */
+        time_t mtime = 0;  /** Modification time, seconds. */
+        long mtime_ns = 0; /** Modification time, nanoseconds part. */
+
+        /**
+         * @brief Stamp of a file from its status.
+         *
+         * @param st The status returned by stat or fstat.
+         * @return FileStamp
+         */
+        static FileStamp of(const struct stat &st) {
+            FileStamp stamp;
+            stamp.device = st.st_dev;
+            stamp.inode = st.st_ino;
+            stamp.size = st.st_size;
+            stamp.mtime = st.st_mtim.tv_sec;
+            stamp.mtime_ns = st.st_mtim.tv_nsec;
+            return stamp;
+        }
+
+        bool operator==(const FileStamp &other) const {
+            return this->device == other.device && this->inode == other.inode && this->size == other.size && this->mtime == other.mtime && this->mtime_ns == other.mtime_ns;
+        }
+
+        bool operator!=(const FileStamp &other) const {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * @brief A static file held in memory.
+     *
+     * Assets are immutable once published, responses keep a reference to the content they are sending.
+     */
+    struct Asset {
+        std::shared_ptr<const std::string> identity; /** The file content. */
+        std::shared_ptr<const std::string> gzip;     /** gzip encoded content, null if not available. */
+        std::shared_ptr<const std::string> brotli;   /** brotli encoded content from a .br file next to the original, null if not available. */
+        std::string content_type;                    /** MIME type of the file. */
+        std::string etag;                            /** Strong ETag of the identity content, without quotes. */
+        FileStamp stamp;                             /** Stamp of the file when it was loaded. */
+        FileStamp gzip_stamp;                        /** Stamp of the .gz file next to the original. */
+        FileStamp brotli_stamp;                      /** Stamp of the .br file next to the original. */
+    };
+
+    /**
+     * @brief In-memory cache of the files under the web root.
+     *
+     * The whole tree is loaded once and reloaded when inotify reports a change, files whose stamp did not change are reused.
+     * The cache is published as an immutable snapshot, lookups never block on a reload.
+     * Compressible files get a gzip variant unless a .gz file sits next to them, brotli variants come only from .br files.
+     */
+    class AssetCache
+    {
+    public:
+        /**
+         * @brief Constructor for the AssetCache class.
+         *
+         * @param max_file_bytes Files bigger than this are not cached.
+         * @param max_total_bytes Upper bound of the memory used by all cached content, including the compressed variants.
+         */
+        AssetCache(size_t max_file_bytes, size_t max_total_bytes);
+
+        /**
+         * @brief Destructor for the AssetCache class, stops watching the web root.
+         */
+        ~AssetCache();
+
+        AssetCache(const AssetCache &) = delete;
+        AssetCache &operator=(const AssetCache &) = delete;
+
+        /**
+         * @brief Load the web root and start watching it for changes.
+         *
+         * @param root The path to the web root directory.
+         * @return True if the web root was loaded, false otherwise.
+         */
+        bool open(const std::string &root);
+
+        /**
+         * @brief Stop watching the web root and drop the cached files.
+         */
+        void close();
+
+        /**
+         * @brief Find a cached file.
+         *
+         * @param path The URL path of the file, relative to the web root and starting with '/'.
+         * @return The cached file, nullptr if it is not cached.
+         */
+        std::shared_ptr<const Asset> find(const std::string &path) const;
+
+        /**
+         * @brief Number of cached files.
+         *
+         * @return size_t
+         */
+        size_t size() const;
+
+        /**
+         * @brief Memory used by the cached content in bytes.
+         *
+         * @return size_t
+         */
+        size_t total_bytes() const;
+
+    private:
+        using AssetMap = std::unordered_map<std::string, std::shared_ptr<const Asset>>;
+        using DirectorySet = std::set<std::pair<dev_t, ino_t>>;
+
+        /**
+         * @brief Rescan the web root and publish a new snapshot.
+         */
+        void reload();
+
+        /**
+         * @brief Scan a directory recursively and add inotify watches for it.
+         *
+         * @param dir The directory on disk.
+         * @param prefix The URL path of the directory, ending with '/'.
+         * @param previous The snapshot before this scan, unchanged files are taken from it.
+         * @param assets The new snapshot.
+         * @param total Memory used by the new snapshot so far.
+         * @param visited Directories already scanned, by device and inode.
+         */
+        void scan(const std::string &dir, const std::string &prefix, const AssetMap &previous, AssetMap &assets, size_t &total, DirectorySet &visited);
+
+        /**
+         * @brief Load a file and its compressed variants.
+         *
+         * @param file The path to the file.
+         * @param stamp The stamp of the file.
+         * @param previous The cached version of the file, nullptr if there is none.
+         * @return The loaded file, nullptr if it cannot be read.
+         */
+        std::shared_ptr<const Asset> load(const std::string &file, const FileStamp &stamp, const std::shared_ptr<const Asset> &previous);
+
+        /**
+         * @brief Watcher thread main loop, reloads after the web root has been quiet for a short while.
+         */
+        void watch();
+
+        static constexpr int reload_delay_ms = 200; /** Quiet time after the last change before reloading. */
+
+        std::string root;                       /** The path to the web root directory. */
+        size_t max_file_bytes;                  /** Files bigger than this are not cached. */
+        size_t max_total_bytes;                 /** Upper bound of the memory used by all cached content. */
+        std::shared_ptr<const AssetMap> assets; /** The current snapshot. */
+        std::atomic<size_t> assets_bytes;       /** Memory used by the current snapshot. */
+        int inotify_fd;                         /** inotify instance watching the web root, -1 if not watching. */
+        int stop_fd;                            /** eventfd waking the watcher thread up to stop. */
+        std::thread watcher;                    /** The watcher thread. */
+    };
+
+    /**
+     * @brief ETags of the files streamed from disk, keyed by path.
+     *
+     * The ETag of a file is computed once from its content and reused as long as the file keeps the same stamp,
+     * so revalidating a file only costs a stat. Files too big to hash get an ETag derived from their stamp instead.
+     */
+    class ETagCache
+    {
+    public:
+        /**
+         * @brief Constructor for the ETagCache class.
+         *
+         * @param max_entries Number of files remembered, the cache starts over when it is full.
+         * @param max_hash_bytes Files bigger than this are not hashed.
+         */
+        explicit ETagCache(size_t max_entries = 4096, size_t max_hash_bytes = 64 * 1024 * 1024);
+
+        /**
+         * @brief Get the ETag of an open file, hashing it if it changed since it was last seen.
+         *
+         * @param path The path to the file, the cache key.
+         * @param fd The open file.
+         * @param stamp The stamp of the open file.
+         * @return The strong ETag without quotes, empty if the file cannot be read.
+         */
+        std::string get(const std::string &path, int fd, const FileStamp &stamp);
+
+    private:
+        size_t max_entries;                                                        /** Number of files remembered. */
+        size_t max_hash_bytes;                                                     /** Files bigger than this are not hashed. */
+        std::mutex mutex;                                                          /** Protects entries. */
+        std::unordered_map<std::string, std::pair<FileStamp, std::string>> entries; /** Stamp and ETag of each file. */
+    };
+
+} // namespace httpservernp
@@ -0,0 +1,492 @@
+/**
+ * @file command_dispatch.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 命令分发: 只扫描顶层type/value的JSON解析, 以及注册时构建的完美哈希表
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace websocketnp
+{
+    /**
+     * @struct CommandEnvelope
+     * @brief 命令消息的顶层字段, 均指向原始消息中的数据
+     */
+    struct CommandEnvelope {
+        bool has_type = false;  // 消息中有type键
+        bool has_value = false; // 消息中有value键
+        bool has_id = false;    // 消息中有id键
+        std::string_view type;  // type的字符串内容, 不含引号
+        std::string_view value; // value的原始JSON文本, 交给回调前再解析
+        std::string_view id;    // id的原始JSON文本, 异步回复时原样带回
+    };
+
+    namespace detail
+    {
+        /**
+         * @brief 构造字符查找表, 表中的字符为true
+         *
+         * @param chars
+         * @return std::array<bool, 256>
+         */
+        constexpr std::array<bool, 256> char_table(std::string_view chars) {
+            std::array<bool, 256> table{};
+            for (char c : chars)
+                table[static_cast<uint8_t>(c)] = true;
+            return table;
+        }
+    } // namespace detail
+
+    /**
+     * @brief 只扫描JSON对象的顶层type, value和id, 不构建DOM
+     *
+     * type, value和id的值只找出结尾, 之后由调用者解析时校验, 解析失败时调用者应退回完整解析.
+     * 其他键的值不会再被解析, 按JSON语法校验(字面量拼写, 数字格式, 括号配对, 转义序列).
+     * 字符串的UTF-8编码不检查, 文本帧在传输层已校验.
+     * 遇到带转义的键, 非字符串或带转义的type, 以及其他键不合语法时都返回false,
+     * 由调用者退回完整解析, 保证报错与完整解析一致
+     *
+     * @param data 收到的文本消息
+     * @param envelope 输出的顶层字段
+     * @return bool 能否使用扫描结果
+     */
+    inline bool scan_command(std::string_view data, CommandEnvelope &envelope) {
+        static constexpr std::array<bool, 256> quoted_delimiters = detail::char_table("\"\\");
+        static constexpr std::array<bool, 256> span_delimiters = detail::char_table("\"{}[]");
+        const char *p = data.data();
+        const char *end = p + data.size();
+
+        auto skip_space = [&]() {
+            while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+                ++p;
+        };
+        // p指向\u之后, 读取4位十六进制数
+        auto read_hex4 = [&](uint32_t &code) {
+            if (end - p < 4)
+                return false;
+            code = 0;
+            for (int i = 0; i < 4; ++i, ++p) {
+                char c = *p;
+                uint32_t digit;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    digit = c - 'A' + 10;
+                else
+                    return false;
+                code = (code << 4) | digit;
+            }
+            return true;
+        };
+        // p指向开头的引号, 返回后p指向结尾引号之后, escaped表示内容中有转义
+        auto skip_string = [&](bool &escaped) {
+            escaped = false;
+            for (++p; p != end;) {
+                char c = *p++;
+                if (c == '"')
+                    return true;
+                if (static_cast<unsigned char>(c) < 0x20)
+                    return false;
+                if (c != '\\')
+                    continue;
+                escaped = true;
+                if (p == end)
+                    return false;
+                c = *p++;
+                if (c != 'u') {
+                    if (c != '"' && c != '\\' && c != '/' && c != 'b' && c != 'f' && c != 'n' && c != 'r' && c != 't')
+                        return false;
+                    continue;
+                }
+                // 代理项必须成对出现, 与完整解析一致
+                uint32_t code;
+                if (!read_hex4(code) || (code >= 0xdc00 && code <= 0xdfff))
+                    return false;
+                if (code >= 0xd800 && code <= 0xdbff) {
+                    if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                        return false;
+                    p += 2;
+                    if (!read_hex4(code) || code < 0xdc00 || code > 0xdfff)
+                        return false;
+                }
+            }
+            return false;
+        };
+        auto skip_digits = [&]() {
+            const char *begin = p;
+            while (p != end && *p >= '0' && *p <= '9')
+                ++p;
+            return p != begin;
+        };
+        // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, 完整解析会拒绝超出double范围的数,
+        // 整数位数加指数不超过300时一定在范围内, 只有更大的数才交给strtod判断
+        auto skip_number = [&]() {
+            const char *begin = p;
+            if (p != end && *p == '-')
+                ++p;
+            if (p == end || *p < '0' || *p > '9')
+                return false;
+            long magnitude = 0;
+            if (*p == '0') {
+                ++p;
+            } else {
+                const char *digits = p;
+                skip_digits();
+                magnitude = p - digits;
+            }
+            if (p != end && *p == '.') {
+                ++p;
+                if (!skip_digits())
+                    return false;
+            }
+            if (p != end && (*p == 'e' || *p == 'E')) {
+                ++p;
+                bool negative = p != end && *p == '-';
+                if (p != end && (*p == '+' || *p == '-'))
+                    ++p;
+                long exponent = 0;
+                const char *digits = p;
+                for (; p != end && *p >= '0' && *p <= '9'; ++p)
+                    exponent = std::min(exponent * 10 + (*p - '0'), 100000L);
+                if (p == digits)
+                    return false;
+                magnitude += negative ? -exponent : exponent;
+            }
+            return magnitude <= 300 || std::isfinite(std::strtod(std::string(begin, p).c_str(), nullptr));
+        };
+        auto skip_literal = [&](std::string_view word) {
+            if (static_cast<size_t>(end - p) < word.size() || std::string_view(p, word.size()) != word)
+                return false;
+            p += word.size();
+            return true;
+        };
+        // 对象中的键和冒号, 以及其后的空白
+        auto skip_key = [&]() {
+            bool escaped;
+            if (p == end || *p != '"' || !skip_string(escaped))
+                return false;
+            skip_space();
+            if (p == end || *p != ':')
+                return false;
+            ++p;
+            skip_space();
+            return true;
+        };
+        // p指向开头的引号, 只找配对的结尾引号, 不校验转义
+        auto skip_quoted = [&]() {
+            for (++p; p != end; ++p) {
+                while (p != end && !quoted_delimiters[static_cast<uint8_t>(*p)])
+                    ++p;
+                if (p == end)
+                    return false;
+                if (*p == '\\') {
+                    if (++p == end)
+                        return false;
+                } else if (*p == '"') {
+                    ++p;
+                    return true;
+                }
+            }
+            return false;
+        };
+        // 只找出值的结尾: 字符串跳到结尾引号, 对象和数组按括号深度跳过, 其余跳到分隔符
+        auto skip_span = [&]() {
+            if (p == end)
+                return false;
+            if (*p == '"')
+                return skip_quoted();
+            if (*p == '{' || *p == '[') {
+                size_t depth = 0;
+                while (true) {
+                    // 数字, 字面量和分隔符不影响结尾, 一次跳过
+                    while (p != end && !span_delimiters[static_cast<uint8_t>(*p)])
+                        ++p;
+                    if (p == end)
+                        return false;
+                    switch (*p) {
+                    case '"':
+                        if (!skip_quoted())
+                            return false;
+                        continue;
+                    case '{':
+                    case '[':
+                        ++depth;
+                        break;
+                    case '}':
+                    case ']':
+                        if (--depth == 0) {
+                            ++p;
+                            return true;
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    ++p;
+                }
+            }
+            const char *begin = p;
+            while (p != end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+                ++p;
+            return p != begin;
+        };
+        // 按语法跳过一个完整的值, 嵌套的对象和数组用栈记录待匹配的右括号, 不递归
+        std::string closers;
+        auto skip_value = [&]() {
+            bool escaped;
+            closers.clear();
+            while (true) {
+                if (p == end)
+                    return false;
+                switch (*p) {
+                case '{':
+                case '[': {
+                    char closer = *p == '{' ? '}' : ']';
+                    ++p;
+                    skip_space();
+                    if (p != end && *p == closer) {
+                        ++p;
+                        break;
+                    }
+                    closers.push_back(closer);
+                    if (closer == '}' && !skip_key())
+                        return false;
+                    continue;
+                }
+                case '"':
+                    if (!skip_string(escaped))
+                        return false;
+                    break;
+                case 't':
+                    if (!skip_literal("true"))
+                        return false;
+                    break;
+                case 'f':
+                    if (!skip_literal("false"))
+                        return false;
+                    break;
+                case 'n':
+                    if (!skip_literal("null"))
+                        return false;
+                    break;
+                default:
+                    if (!skip_number())
+                        return false;
+                    break;
+                }
+                // 一个值结束后, 关闭已完成的容器, 或者在逗号后继续下一个元素
+                while (true) {
+                    if (closers.empty())
+                        return true;
+                    skip_space();
+                    if (p == end)
+                        return false;
+                    if (*p == ',') {
+                        ++p;
+                        skip_space();
+                        if (closers.back() == '}' && !skip_key())
+                            return false;
+                        break;
+                    }
+                    if (*p != closers.back())
+                        return false;
+                    ++p;
+                    closers.pop_back();
+                }
+            }
+        };
+
+        envelope = CommandEnvelope();
+        skip_space();
+        if (p == end || *p != '{')
+            return false;
+        ++p;
+        skip_space();
+        if (p != end && *p == '}') {
+            ++p;
+        } else {
+            while (true) {
+                if (p == end || *p != '"')
+                    return false;
+                const char *key_begin = p + 1;
+                bool escaped;
+                if (!skip_string(escaped) || escaped)
+                    return false;
+                std::string_view key(key_begin, p - 1 - key_begin);
+                skip_space();
+                if (p == end || *p != ':')
+                    return false;
+                ++p;
+                skip_space();
+
+                const char *value_begin = p;
+                bool parsed_later = key == "type" || key == "value" || key == "id";
+                if (!(parsed_later ? skip_span() : skip_value()))
+                    return false;
+                // 重复的键以最后一个为准, 与完整解析一致
+                if (key == "type") {
+                    if (*value_begin != '"')
+                        return false;
+                    std::string_view type(value_begin + 1, p - value_begin - 2);
+                    if (type.find('\\') != std::string_view::npos)
+                        return false;
+                    envelope.has_type = true;
+                    envelope.type = type;
+                } else if (key == "value") {
+                    envelope.has_value = true;
+                    envelope.value = std::string_view(value_begin, p - value_begin);
+                } else if (key == "id") {
+                    envelope.has_id = true;
+                    envelope.id = std::string_view(value_begin, p - value_begin);
+                }
+
+                skip_space();
+                if (p == end)
+                    return false;
+                if (*p == '}') {
+                    ++p;
+                    break;
+                }
+                if (*p != ',')
+                    return false;
+                ++p;
+                skip_space();
+            }
+        }
+        skip_space();
+        return p == end;
+    }
+
+    /**
+     * @class PerfectHashMap
+     * @brief 构建后只读的字符串键完美哈希表
+     *
+     * 构建时寻找一个哈希种子使所有键落在不同的槽位, 查找只需一次哈希和一次字符串比较.
+     * 命令表只在注册回调时重建, 构建的开销不影响收消息
+     *
+     * @tparam T 值类型
+     */
+    template <typename T>
+    class PerfectHashMap
+    {
+    public:
+        using Item = std::pair<std::string, T>;
+
+        PerfectHashMap() = default;
+
+        /**
+         * @brief 由不重复的键构建哈希表
+         *
+         * @param items 键值对, 键不能重复
+         */
+        explicit PerfectHashMap(std::vector<Item> items) : entries(std::move(items)) {
+            size_t table_size = 1;
+            while (table_size < this->entries.size() * 2)
+                table_size <<= 1;
+            // 每个尺寸试若干种子, 都有冲突时加倍, 键越多需要的槽位越稀疏
+            while (true) {
+                for (uint32_t seed = 0; seed < max_seeds_per_size; ++seed) {
+                    if (this->try_build(table_size, seed))
+                        return;
+                }
+                table_size <<= 1;
+            }
+        }
+
+        /**
+         * @brief 查找键对应的值
+         *
+         * @param key
+         * @return const T* 不存在时返回nullptr
+         */
+        const T *find(std::string_view key) const {
+            if (this->slots.empty())
+                return nullptr;
+            uint32_t index = this->slots[hash(key, this->seed) & this->mask];
+            if (index == 0)
+                return nullptr;
+            const Item &item = this->entries[index - 1];
+            return item.first == key ? &item.second : nullptr;
+        }
+
+        /**
+         * @brief 表中的全部键值对, 用于复制后重建
+         *
+         * @return const std::vector<Item>&
+         */
+        const std::vector<Item> &items() const {
+            return this->entries;
+        }
+
+        /**
+         * @brief 槽位数
+         *
+         * @return size_t
+         */
+        size_t table_size() const {
+            return this->slots.size();
+        }
+
+    private:
+        static constexpr uint32_t max_seeds_per_size = 64;
+
+        std::vector<Item> entries;   // 键值对
+        std::vector<uint32_t> slots; // 槽位对应的entries下标加1, 0表示空槽
+        uint32_t seed = 0;           // 无冲突的哈希种子
+        uint32_t mask = 0;           // 槽位数减1
+
+        /**
+         * @brief 带种子的FNV-1a哈希
+         *
+         * @param key
+         * @param seed
+         * @return uint32_t
+         */
+        static uint32_t hash(std::string_view key, uint32_t seed) {
+            uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+            for (char c : key) {
+                h ^= static_cast<uint8_t>(c);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        /**
+         * @brief 以给定的尺寸和种子尝试构建
+         *
+         * @param table_size 槽位数, 2的幂
+         * @param seed 哈希种子
+         * @return bool 有冲突时返回false
+         */
+        bool try_build(size_t table_size, uint32_t seed) {
+            std::vector<uint32_t> candidate(table_size, 0);
+            uint32_t candidate_mask = static_cast<uint32_t>(table_size - 1);
+            for (size_t i = 0; i < this->entries.size(); ++i) {
+                uint32_t &slot = candidate[hash(this->entries[i].first, seed) & candidate_mask];
+                if (slot != 0)
+                    return false;
+                slot = static_cast<uint32_t>(i + 1);
+            }
+            this->slots = std::move(candidate);
+            this->seed = seed;
+            this->mask = candidate_mask;
+            return true;
+        }
+    };
+} // namespace websocketnp
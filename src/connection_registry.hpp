@@ -0,0 +1,216 @@
+/**
+ * @file connection_registry.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocket连接表
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <ixwebsocket/IXConnectionState.h>
+#include <ixwebsocket/IXWebSocket.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <message_arena.hpp>
+#include <message_format.hpp>
+#include <send_queue.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @class Connection
+     * @brief 已建立连接的客户端信息
+     */
+    class Connection
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @brief 构造函数
+         *
+         * @param id 数值形式的连接id
+         * @param websocket IX连接对象
+         * @param url 客户端地址
+         * @param queue 发送队列
+         * @param encoding 广播消息的编码分组
+         * @param format 消息格式
+         */
+        Connection(uint64_t id, std::weak_ptr<ix::WebSocket> websocket, std::string url, std::shared_ptr<SendQueue> queue, uint8_t encoding = plain_frames, MessageFormat format = MessageFormat::Json)
+            : id(id), websocket(std::move(websocket)), url(std::move(url)), queue(std::move(queue)), encoding(encoding), last_active(clock::now().time_since_epoch().count()), message_format(format) {}
+
+        /// 未协商压缩, 共享未压缩的帧. 9~15表示共享按该窗口大小压缩的帧
+        static constexpr uint8_t plain_frames = 0;
+        /// 压缩保留上下文, 帧无法共享, 由连接自己压缩
+        static constexpr uint8_t own_deflate = 0xff;
+
+        const uint64_t id;                            // 数值形式的连接id
+        const std::weak_ptr<ix::WebSocket> websocket; // 连接对象, 由IX连接线程持有
+        const std::string url;                        // 客户端地址
+        const std::shared_ptr<SendQueue> queue;       // 发送队列
+        const uint8_t encoding;                       // 广播消息的编码分组, 由握手协商的压缩参数决定
+
+        /**
+         * @brief 刷新最后活跃时间
+         */
+        void touch() {
+            this->last_active.store(clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 获取最后活跃时间
+         *
+         * @return clock::time_point
+         */
+        clock::time_point last_active_time() const {
+            return clock::time_point(clock::duration(this->last_active.load(std::memory_order_relaxed)));
+        }
+
+        /**
+         * @brief 获取消息格式
+         *
+         * @return MessageFormat
+         */
+        MessageFormat format() const {
+            return this->message_format.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief 设置消息格式, 只由该连接线程调用
+         *
+         * @param format
+         */
+        void set_format(MessageFormat format) {
+            this->message_format.store(format, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<clock::rep> last_active;        // 最后活跃时间
+        std::atomic<MessageFormat> message_format; // 回复和广播使用的消息格式
+    };
+
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    /**
+     * @class ClientState
+     * @brief 附加在IX连接上的客户端状态
+     */
+    class ClientState : public ix::ConnectionState
+    {
+    public:
+        std::mutex callback_mutex;              // PerConnection模式下的回调互斥锁
+        ConnectionPtr connection;               // 握手完成后登记的连接信息, 只在该连接线程中读写
+        bool format_decided = false;            // 消息格式已由子协议或第一帧确定, 只在该连接线程中读写
+        MessageArena arena;                     // 处理一条消息期间的JSON对象从这里分配, 只在该连接线程中使用
+        std::string reply_buffer;               // 复用的回复序列化缓冲区, 只在该连接线程中使用
+        std::atomic<size_t> async_in_flight{0}; // 已提交还未回复的异步命令数
+
+        ClientState() : numeric_id(std::stoull(_id)) {}
+
+        /**
+         * @brief 获取数值形式的连接id
+         *
+         * @return uint64_t
+         */
+        uint64_t get_numeric_id() const {
+            return this->numeric_id;
+        }
+
+    private:
+        uint64_t numeric_id; // 数值形式的连接id
+    };
+
+    /**
+     * @class ConnectionRegistry
+     * @brief 按数值id索引的连接表
+     *
+     * 连接表以不可变快照的方式发布: 增删连接时复制一份新表再原子替换,
+     * 广播, 查询和超时检查只需取得当前快照即可遍历, 不会阻塞写者
+     */
+    class ConnectionRegistry
+    {
+    public:
+        /// 按id升序排列的连接快照
+        using Snapshot = std::shared_ptr<const std::vector<ConnectionPtr>>;
+
+        ConnectionRegistry() : connections(std::make_shared<const std::vector<ConnectionPtr>>()) {}
+
+        /**
+         * @brief 获取当前连接快照
+         *
+         * @return Snapshot
+         */
+        Snapshot snapshot() const {
+            return std::atomic_load(&this->connections);
+        }
+
+        /**
+         * @brief 添加连接, 已存在相同id时替换
+         *
+         * @param connection
+         */
+        void insert(const ConnectionPtr &connection) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto updated = std::make_shared<std::vector<ConnectionPtr>>(*this->snapshot());
+            auto it = std::lower_bound(updated->begin(), updated->end(), connection->id, less_id);
+            if (it != updated->end() && (*it)->id == connection->id)
+                *it = connection;
+            else
+                updated->insert(it, connection);
+            std::atomic_store(&this->connections, Snapshot(std::move(updated)));
+        }
+
+        /**
+         * @brief 删除连接
+         *
+         * @param id 数值形式的连接id
+         * @return ConnectionPtr 被删除的连接, 不存在时返回nullptr
+         */
+        ConnectionPtr erase(uint64_t id) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto current = this->snapshot();
+            auto it = std::lower_bound(current->begin(), current->end(), id, less_id);
+            if (it == current->end() || (*it)->id != id)
+                return nullptr;
+            ConnectionPtr erased = *it;
+            auto updated = std::make_shared<std::vector<ConnectionPtr>>();
+            updated->reserve(current->size() - 1);
+            updated->insert(updated->end(), current->begin(), it);
+            updated->insert(updated->end(), it + 1, current->end());
+            std::atomic_store(&this->connections, Snapshot(std::move(updated)));
+            return erased;
+        }
+
+        /**
+         * @brief 按id查找连接
+         *
+         * @param id 数值形式的连接id
+         * @return ConnectionPtr 不存在时返回nullptr
+         */
+        ConnectionPtr find(uint64_t id) const {
+            auto current = this->snapshot();
+            auto it = std::lower_bound(current->begin(), current->end(), id, less_id);
+            if (it == current->end() || (*it)->id != id)
+                return nullptr;
+            return *it;
+        }
+
+    private:
+        static bool less_id(const ConnectionPtr &connection, uint64_t id) {
+            return connection->id < id;
+        }
+
+        std::mutex writer_mutex; // 串行化写者
+        Snapshot connections;    // 当前连接快照
+    };
+} // namespace websocketnp
@@ -23,7 +23,8 @@ using namespace utilsnp;
 Controller::Controller(int wsport, int hsport, std::string host) : ws(wsport, host),
                                                                    hs(hsport, host),
                                                                    is_running(false),
-                                                                   working(false) {}
+                                                                   working(false),
+                                                                   stat_stream("DevStatRpt", "DevStatPatch", 10) {}
 
 Controller::~Controller() {
     this->deinit();
@@ -32,13 +33,14 @@ Controller::~Controller() {
 bool Controller::init() {
     try {
         // 初始化软硬件配置
-        this->ws.register_callbacks("StartWork", bind(&Controller::handle_start_work, this, placeholders::_1));
-        this->ws.register_callbacks("StopWork", bind(&Controller::handle_stop_work, this, placeholders::_1));
-        this->ws.register_callbacks("Working", bind(&Controller::handle_get_working, this, placeholders::_1));
-        this->ws.register_callbacks("VersionReq", [this](const nlohmann::json &msg) {
-            json verinfo;
+        // 以下回调只访问原子变量或常量, 可在各连接线程上并发执行
+        this->ws.register_callbacks("StartWork", bind(&Controller::handle_start_work, this, placeholders::_1), websocketnp::CallbackConcurrency::Reentrant);
+        this->ws.register_callbacks("StopWork", bind(&Controller::handle_stop_work, this, placeholders::_1), websocketnp::CallbackConcurrency::Reentrant);
+        this->ws.register_callbacks("Working", bind(&Controller::handle_get_working, this, placeholders::_1), websocketnp::CallbackConcurrency::Reentrant);
+        this->ws.register_callbacks("VersionReq", [this](const websocketnp::MessageJson &msg) {
+            websocketnp::MessageJson verinfo;
             verinfo["type"] = "OnVerInfo";
-            json ctrlinfo;
+            websocketnp::MessageJson ctrlinfo;
 #ifdef VERSION
             ctrlinfo["ver"] = VERSION;
 #endif
@@ -54,7 +56,41 @@ bool Controller::init() {
             }
 
             return verinfo;
+        }, websocketnp::CallbackConcurrency::Reentrant);
+        // HTTP工作线程池的负载: 线程数, 排队深度, 排队等待时间和因排队过多拒绝的连接数
+        this->ws.register_callbacks("HttpPoolReq", [this](const websocketnp::MessageJson &msg) {
+            auto stats = this->hs.task_queue_stats();
+            return websocketnp::MessageJson{
+                {"type", "HttpPoolRet"},
+                {"value", {
+                              {"threads", stats.threads},
+                              {"idle", stats.idle_threads},
+                              {"queued", stats.queued},
+                              {"executed", stats.executed},
+                              {"rejected", stats.rejected},
+                              {"stolen", stats.stolen},
+                              {"waitAvgUs", stats.executed ? stats.wait_ns_total / stats.executed / 1000 : 0},
+                              {"waitMaxUs", stats.wait_ns_max / 1000},
+                          }},
+            };
+        }, websocketnp::CallbackConcurrency::Reentrant);
+        // 状态平时只发送变化的部分, 新连接和请求重新同步的客户端先收到完整的关键帧
+        this->ws.register_callbacks("DevStatReq", [this](const websocketnp::MessageJson &msg) {
+            return websocketnp::MessageJson(this->stat_stream.keyframe());
+        }, websocketnp::CallbackConcurrency::Reentrant);
+        this->ws.set_connection_greeting([this]() {
+            return this->stat_stream.keyframe();
         });
+        // 状态上报走DevStatRpt主题, 新连接默认订阅, 不关心状态的客户端可以退订
+        this->ws.set_default_topics({"DevStatRpt"});
+        // 前端页面常驻内存, 按Accept-Encoding返回预压缩的版本
+        this->hs.enable_asset_cache();
+        // 固件和日志导出等大文件直接从磁盘发送, 不读入内存
+        this->hs.enable_file_streaming();
+        // 浏览器每次使用缓存的页面前向服务器确认, 未变化时只返回304
+        this->hs.set_cache_control("/", "no-cache");
+        // 连接在按负载伸缩的工作线程池上执行, 排队过多时直接返回503
+        this->hs.enable_work_stealing_pool();
 
         return true;
     } catch (const exception &e) {
@@ -65,7 +101,7 @@ bool Controller::init() {
 
 void Controller::deinit() {}
 
-json Controller::handle_start_work(const json &cmd) {
+websocketnp::MessageJson Controller::handle_start_work(const websocketnp::MessageJson &cmd) {
     this->working = true;
     return {
         {"type", "StartWorkRet"},
@@ -76,7 +112,7 @@ json Controller::handle_start_work(const json &cmd) {
     };
 }
 
-json Controller::handle_stop_work(const json &cmd) {
+websocketnp::MessageJson Controller::handle_stop_work(const websocketnp::MessageJson &cmd) {
     this->working = false;
     return {
         {"type", "StopWorkRet"},
@@ -87,17 +123,16 @@ json Controller::handle_stop_work(const json &cmd) {
     };
 }
 
-json Controller::handle_get_working(const nlohmann::json &cmd) {
+websocketnp::MessageJson Controller::handle_get_working(const websocketnp::MessageJson &cmd) {
     return {{"type", "WorkingRet"}, {"value", this->working.load()}};
 }
 
 void Controller::status_report_looper() {
     while (this->ws.is_running()) {
         json dev_stat = {};
-        this->ws.brodcast_message({
-            {"type", "DevStatRpt"},
-            {"value", dev_stat},
-        });
+        // 没有变化且不到关键帧时不广播
+        if (auto msg = this->stat_stream.update(std::move(dev_stat)))
+            this->ws.publish("DevStatRpt", std::move(*msg));
 
         sleep(1);
     }
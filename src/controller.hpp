@@ -14,6 +14,7 @@
 #include <future>
 
 #include <websocket_server.hpp>
+#include <status_stream.hpp>
 #include <http_server.hpp>
 
 namespace demonp
@@ -24,9 +25,10 @@ namespace demonp
         websocketnp::WebsocketServer ws; // websocket server
         httpservernp::HttpServer hs;     // http server
 
-        std::atomic<bool> is_running;      // 运行标志
-        std::atomic<bool> working;         // 设备工作状态
-        std::future<void> stat_rpt_future; // 状态上报线程
+        std::atomic<bool> is_running;          // 运行标志
+        std::atomic<bool> working;             // 设备工作状态
+        std::future<void> stat_rpt_future;     // 状态上报线程
+        websocketnp::StatusStream stat_stream; // 设备状态的关键帧和增量
 
         /**
          * @brief 初始化软硬件
@@ -47,25 +49,25 @@ namespace demonp
          * @brief 处理开始工作请求
          *
          * @param cmd
-         * @return nlohmann::json
+         * @return websocketnp::MessageJson
          */
-        nlohmann::json handle_start_work(const nlohmann::json &cmd);
+        websocketnp::MessageJson handle_start_work(const websocketnp::MessageJson &cmd);
 
         /**
          * @brief 处理停止工作请求
          *
          * @param cmd
-         * @return nlohmann::json
+         * @return websocketnp::MessageJson
          */
-        nlohmann::json handle_stop_work(const nlohmann::json &cmd);
+        websocketnp::MessageJson handle_stop_work(const websocketnp::MessageJson &cmd);
 
         /**
          * @brief 获取工作状态
          *
          * @param cmd
-         * @return nlohmann::json
+         * @return websocketnp::MessageJson
          */
-        nlohmann::json handle_get_working(const nlohmann::json &cmd);
+        websocketnp::MessageJson handle_get_working(const websocketnp::MessageJson &cmd);
 
         /**
          * @brief 状态周期性上报
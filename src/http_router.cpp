@@ -0,0 +1,231 @@
+/**
+ * @file http_router.cpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Implementation of the HttpRouter class.
+ *
+ * This file contains the implementation of the HttpRouter class, which maps request paths to handlers with a tree of path segments.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <http_router.hpp>
+#include <log.h>
+#include <algorithm>
+
+using namespace httplib;
+using namespace httpservernp;
+
+/**
+ * @brief Whether a pattern uses regular expression syntax.
+ *
+ * '.' alone does not count, a literal such as /favicon.ico is matched exactly.
+ *
+ * @param pattern The path pattern.
+ * @return bool
+ */
+static bool is_expression(const std::string &pattern) {
+    return pattern.find_first_of("\\^$|?*+()[]{}") != std::string::npos;
+}
+
+/**
+ * @brief Whether a segment is a decimal number.
+ *
+ * @param path The request path.
+ * @param begin Offset of the segment.
+ * @param end Offset just after the segment.
+ * @param sign Accept a leading '-' or '+'.
+ * @return bool
+ */
+static bool is_number(const std::string &path, size_t begin, size_t end, bool sign) {
+    if (sign && begin < end && (path[begin] == '-' || path[begin] == '+'))
+        ++begin;
+    if (begin == end)
+        return false;
+    for (size_t i = begin; i < end; ++i) {
+        if (path[i] < '0' || path[i] > '9')
+            return false;
+    }
+    return true;
+}
+
+bool HttpRouter::add(const std::string &method, const std::string &pattern, Handler handler) {
+    Route *route = this->route_of(method == "HEAD" ? "GET" : method, pattern);
+    if (!route || route->handler) {
+        logf_warn("cannot route %s %s: %s\n", method.c_str(), pattern.c_str(), route ? "already routed" : "invalid pattern");
+        return false;
+    }
+    route->handler = std::move(handler);
+    return true;
+}
+
+bool HttpRouter::add(const std::string &method, const std::string &pattern, HandlerWithContentReader handler) {
+    Route *route = this->route_of(method == "HEAD" ? "GET" : method, pattern);
+    if (!route || route->content_handler) {
+        logf_warn("cannot route %s %s: %s\n", method.c_str(), pattern.c_str(), route ? "already routed" : "invalid pattern");
+        return false;
+    }
+    route->content_handler = std::move(handler);
+    return true;
+}
+
+bool HttpRouter::dispatch(Request &req, Response &res, const ContentReader *content_reader) const {
+    const Route *route = this->find(req.method == "HEAD" ? "GET" : req.method, req);
+    // Before the body is read only a handler reading it itself is called, the other one gets the second call
+    if (!route || (content_reader && !route->content_handler) || (!content_reader && !route->handler))
+        return false;
+    if (content_reader)
+        route->content_handler(req, res, *content_reader);
+    else
+        route->handler(req, res);
+    return true;
+}
+
+size_t HttpRouter::size() const {
+    size_t count = 0;
+    for (const auto &table : this->tables) {
+        count += table.second.literals.size() + table.second.expressions.size();
+        std::vector<const Node *> pending = {&table.second.root};
+        while (!pending.empty()) {
+            const Node *node = pending.back();
+            pending.pop_back();
+            count += node->route ? 1 : 0;
+            for (const auto &child : node->literals)
+                pending.push_back(child.second.get());
+            for (const auto &child : node->params) {
+                if (child)
+                    pending.push_back(child.get());
+            }
+        }
+    }
+    return count;
+}
+
+HttpRouter::Route *HttpRouter::route_of(const std::string &method, const std::string &pattern) {
+    Table &table = this->tables[method];
+    if (is_expression(pattern)) {
+        for (auto &expression : table.expressions) {
+            if (expression.pattern == pattern)
+                return &expression.route;
+        }
+        Expression expression;
+        try {
+            expression.regex.assign(pattern);
+        } catch (const std::regex_error &e) {
+            logf_warn("invalid regular expression %s: %s\n", pattern.c_str(), e.what());
+            return nullptr;
+        }
+        expression.pattern = pattern;
+        table.expressions.push_back(std::move(expression));
+        return &table.expressions.back().route;
+    }
+    if (pattern.find(':') == std::string::npos || pattern.front() != '/')
+        return &table.literals[pattern];
+
+    Node *node = &table.root;
+    std::vector<std::string> names;
+    size_t begin = 1;
+    while (true) {
+        size_t end = std::min(pattern.find('/', begin), pattern.size());
+        std::string segment = pattern.substr(begin, end - begin);
+        if (!segment.empty() && segment.front() == ':') {
+            ParamType type = String;
+            size_t open = segment.find('<');
+            if (open != std::string::npos) {
+                std::string name = segment.substr(open);
+                if (name == "<uint>")
+                    type = UInt;
+                else if (name == "<int>")
+                    type = Int;
+                else if (name != "<string>")
+                    return nullptr;
+                segment.erase(open);
+            }
+            if (segment.size() == 1)
+                return nullptr;
+            names.push_back(segment.substr(1));
+            auto &child = node->params[type];
+            if (!child)
+                child = std::make_unique<Node>();
+            node = child.get();
+        } else {
+            auto it = node->literals.find(segment);
+            if (it == node->literals.end()) {
+                auto child = std::make_unique<Node>();
+                child->segment = std::move(segment);
+                std::string_view key = child->segment;
+                it = node->literals.emplace(key, std::move(child)).first;
+            }
+            node = it->second.get();
+        }
+        if (end == pattern.size())
+            break;
+        begin = end + 1;
+    }
+    if (!node->route) {
+        node->route = std::make_unique<Route>();
+        node->route->param_names = std::move(names);
+    } else if (node->route->param_names != names) {
+        // /dev/:id and /dev/:name are the same route, the names must agree
+        return nullptr;
+    }
+    return node->route.get();
+}
+
+const HttpRouter::Route *HttpRouter::find(const std::string &method, Request &req) const {
+    auto table = this->tables.find(method);
+    if (table == this->tables.end())
+        return nullptr;
+    const std::string &path = req.path;
+
+    auto literal = table->second.literals.find(path);
+    if (literal != table->second.literals.end())
+        return &literal->second;
+
+    if (!path.empty() && path.front() == '/') {
+        std::vector<std::pair<size_t, size_t>> values;
+        const Route *route = match(table->second.root, path, 1, values);
+        if (route) {
+            req.path_params.clear();
+            for (size_t i = 0; i < values.size(); ++i)
+                req.path_params[route->param_names[i]] = path.substr(values[i].first, values[i].second);
+            return route;
+        }
+    }
+
+    for (const auto &expression : table->second.expressions) {
+        if (std::regex_match(path, req.matches, expression.regex))
+            return &expression.route;
+    }
+    return nullptr;
+}
+
+const HttpRouter::Route *HttpRouter::match(const Node &node, const std::string &path, size_t begin, std::vector<std::pair<size_t, size_t>> &values) {
+    size_t end = std::min(path.find('/', begin), path.size());
+    bool last = end == path.size();
+    auto descend = [&](const Node &child) -> const Route * {
+        return last ? child.route.get() : match(child, path, end + 1, values);
+    };
+
+    if (!node.literals.empty()) {
+        auto it = node.literals.find(std::string_view(path).substr(begin, end - begin));
+        if (it != node.literals.end()) {
+            if (const Route *route = descend(*it->second))
+                return route;
+        }
+    }
+    if (begin == end)
+        return nullptr;
+    for (int type = UInt; type < ParamTypes; ++type) {
+        const Node *child = node.params[type].get();
+        if (!child || (type == UInt && !is_number(path, begin, end, false)) || (type == Int && !is_number(path, begin, end, true)))
+            continue;
+        values.emplace_back(begin, end - begin);
+        if (const Route *route = descend(*child))
+            return route;
+        values.pop_back();
+    }
+    return nullptr;
+}
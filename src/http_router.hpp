@@ -0,0 +1,164 @@
+/**
+ * @file http_router.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Declaration of the HttpRouter class.
+ *
+ * This file contains the declaration of the HttpRouter class, which maps request paths to handlers with a tree of path segments.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+
+#include <httplib.h>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace httpservernp
+{
+    /**
+     * @brief Route table matching request paths segment by segment.
+     *
+     * A pattern is made of literal segments and typed parameters:
+     * - /api/status        literal, matched with a single hash lookup of the whole path
+     * - /api/dev/:id       any non-empty segment
+     * - /api/dev/:id<int>  a decimal number, optionally signed
+     * - /api/dev/:id<uint> an unsigned decimal number
+     * Parameters are stored in Request::path_params. At each segment the literal child is tried first,
+     * then the uint, int and string parameters, the first route found wins.
+     * Patterns using regular expression syntax are matched with std::regex and set Request::matches as httplib does,
+     * they are tried in the order they were added and only when no other route matches.
+     * Routes must be added before the server starts, lookups do not lock.
+     */
+    class HttpRouter
+    {
+    public:
+        using Handler = httplib::Server::Handler;
+        using HandlerWithContentReader = httplib::Server::HandlerWithContentReader;
+
+        /**
+         * @brief Add a route.
+         *
+         * @param method The HTTP method, HEAD requests are routed to GET.
+         * @param pattern The path pattern.
+         * @param handler The handler, called once the body has been read.
+         * @return True if the route was added, false if the pattern is invalid or already has a handler.
+         */
+        bool add(const std::string &method, const std::string &pattern, Handler handler);
+
+        /**
+         * @brief Add a route reading the body itself.
+         *
+         * @param method The HTTP method.
+         * @param pattern The path pattern.
+         * @param handler The handler, called with a reader before the body is read.
+         * @return True if the route was added, false if the pattern is invalid or already has a handler.
+         */
+        bool add(const std::string &method, const std::string &pattern, HandlerWithContentReader handler);
+
+        /**
+         * @brief Route a request, used as the httplib::Server dispatcher.
+         *
+         * @param req The request, its path parameters or regex matches are filled in.
+         * @param res The response.
+         * @param content_reader The body reader if the body has not been read yet, nullptr otherwise.
+         * @return True if a handler was called.
+         */
+        bool dispatch(httplib::Request &req, httplib::Response &res, const httplib::ContentReader *content_reader) const;
+
+        /**
+         * @brief Number of patterns with at least one handler.
+         *
+         * @return size_t
+         */
+        size_t size() const;
+
+    private:
+        /**
+         * @brief Types of path parameters, in the order they are tried.
+         */
+        enum ParamType
+        {
+            UInt,   /** Unsigned decimal number. */
+            Int,    /** Decimal number, optionally signed. */
+            String, /** Any non-empty segment. */
+            ParamTypes
+        };
+
+        /**
+         * @brief Handlers of a pattern.
+         */
+        struct Route {
+            Handler handler;                          /** Handler called after the body is read, empty if none. */
+            HandlerWithContentReader content_handler; /** Handler reading the body itself, empty if none. */
+            std::vector<std::string> param_names;     /** Names of the path parameters in path order. */
+        };
+
+        /**
+         * @brief A segment of the tree.
+         */
+        struct Node {
+            std::string segment;                                                  /** The literal segment leading here, viewed by the key in the parent. */
+            std::unordered_map<std::string_view, std::unique_ptr<Node>> literals; /** Children by literal segment. */
+            std::unique_ptr<Node> params[ParamTypes];                             /** Children by parameter type. */
+            std::unique_ptr<Route> route;                                         /** Route of the pattern ending here, null if none. */
+        };
+
+        /**
+         * @brief A regular expression pattern.
+         */
+        struct Expression {
+            std::string pattern; /** The pattern as added. */
+            std::regex regex;    /** The compiled pattern. */
+            Route route;         /** Handlers of the pattern. */
+        };
+
+        /**
+         * @brief Routes of a method.
+         */
+        struct Table {
+            std::unordered_map<std::string, Route> literals; /** Patterns without parameters, by path. */
+            Node root;                                       /** Patterns with parameters, the root matches the leading '/'. */
+            std::vector<Expression> expressions;             /** Regular expression patterns in the order they were added. */
+        };
+
+        /**
+         * @brief Find or create the route of a pattern.
+         *
+         * @param method The HTTP method.
+         * @param pattern The path pattern.
+         * @return The route, nullptr if the pattern is invalid.
+         */
+        Route *route_of(const std::string &method, const std::string &pattern);
+
+        /**
+         * @brief Find the route of a path.
+         *
+         * @param method The HTTP method.
+         * @param req The request, its path parameters or regex matches are filled in.
+         * @return The route, nullptr if none matches.
+         */
+        const Route *find(const std::string &method, httplib::Request &req) const;
+
+        /**
+         * @brief Match the rest of a path below a node, backtracking through the parameters.
+         *
+         * @param node The node matching the segments before begin.
+         * @param path The request path.
+         * @param begin Offset of the first segment to match.
+         * @param values Offsets and lengths of the parameters matched so far.
+         * @return The route, nullptr if none matches.
+         */
+        static const Route *match(const Node &node, const std::string &path, size_t begin, std::vector<std::pair<size_t, size_t>> &values);
+
+        std::unordered_map<std::string, Table> tables; /** Routes by method. */
+    };
+
+} // namespace httpservernp
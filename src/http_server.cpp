@@ -13,23 +13,189 @@
 
 #include <http_server.hpp>
 #include <log.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 
 using namespace httpservernp;
 
+namespace
+{
+    /**
+     * @brief An open file shared by the response that streams it, closed with the last reference.
+     */
+    struct OpenFile {
+        explicit OpenFile(int fd) : fd(fd) {}
+        ~OpenFile() {
+            ::close(this->fd);
+        }
+        OpenFile(const OpenFile &) = delete;
+        OpenFile &operator=(const OpenFile &) = delete;
+
+        const int fd; /** The file descriptor. */
+    };
+} // namespace
+
+/**
+ * @brief Send part of a file, called repeatedly by the server until the whole range is sent.
+ *
+ * Each call sends at most 4 MiB so a stopping server gets a chance to cut long downloads short.
+ *
+ * @param fd The file descriptor.
+ * @param offset Offset of the first byte to send.
+ * @param length Bytes left in the range.
+ * @param sink The connection.
+ * @return True if some bytes were sent.
+ */
+static bool send_file_range(int fd, size_t offset, size_t length, DataSink &sink) {
+    length = std::min<size_t>(length, 4 * 1024 * 1024);
+    if (sink.write_file)
+        return sink.write_file(fd, offset, length);
+    // The stream cannot sendfile, bounce through a buffer of fixed size
+    char buffer[64 * 1024];
+    ssize_t n = pread(fd, buffer, std::min(length, sizeof(buffer)), static_cast<off_t>(offset));
+    return n > 0 && sink.write(buffer, static_cast<size_t>(n));
+}
+
+/**
+ * @brief Whether an Accept-Encoding header allows a content coding.
+ *
+ * @param accept_encoding The Accept-Encoding header value.
+ * @param coding The content coding, e.g. gzip.
+ * @return True if the coding is listed, or matched by '*', with a non-zero quality.
+ */
+static bool accepts_encoding(const std::string &accept_encoding, const std::string &coding) {
+    bool wildcard = false;
+    size_t begin = 0;
+    while (begin < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', begin);
+        if (end == std::string::npos)
+            end = accept_encoding.size();
+        std::string item = accept_encoding.substr(begin, end - begin);
+        begin = end + 1;
+
+        size_t params = item.find(';');
+        std::string name = item.substr(0, params);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        bool allowed = true;
+        if (params != std::string::npos) {
+            size_t q = item.find("q=", params);
+            allowed = q == std::string::npos || std::strtod(item.c_str() + q + 2, nullptr) > 0;
+        }
+        if (strcasecmp(name.c_str(), coding.c_str()) == 0)
+            return allowed;
+        if (name == "*")
+            wildcard = allowed;
+    }
+    return wildcard;
+}
+
+/**
+ * @brief Format a time as an HTTP date, e.g. Sun, 06 Nov 1994 08:49:37 GMT.
+ *
+ * @param time The time.
+ * @return std::string
+ */
+static std::string http_date(time_t time) {
+    static const char *const days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char *const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    struct tm tm;
+    gmtime_r(&time, &tm);
+    char date[32];
+    snprintf(date, sizeof(date), "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon],
+             tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return date;
+}
+
+/**
+ * @brief Parse an HTTP date in the preferred format, the obsolete formats are not accepted.
+ *
+ * @param date The HTTP date.
+ * @param time The parsed time.
+ * @return True if the date was parsed.
+ */
+static bool parse_http_date(const std::string &date, time_t &time) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    struct tm tm = {};
+    char month[4] = {};
+    if (sscanf(date.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return false;
+    const char *found = strstr(months, month);
+    if (strlen(month) != 3 || !found || (found - months) % 3 != 0)
+        return false;
+    tm.tm_mon = static_cast<int>(found - months) / 3;
+    tm.tm_year -= 1900;
+    time = timegm(&tm);
+    return time != -1;
+}
+
+/**
+ * @brief Whether an If-None-Match header lists an ETag, with the weak comparison.
+ *
+ * @param if_none_match The If-None-Match header value.
+ * @param etag The ETag without quotes.
+ * @return True if the ETag is listed or the header is '*'.
+ */
+static bool etag_listed(const std::string &if_none_match, const std::string &etag) {
+    size_t begin = 0;
+    while (begin < if_none_match.size()) {
+        size_t end = if_none_match.find(',', begin);
+        if (end == std::string::npos)
+            end = if_none_match.size();
+        std::string item = if_none_match.substr(begin, end - begin);
+        begin = end + 1;
+
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (item == "*")
+            return true;
+        if (item.compare(0, 2, "W/") == 0)
+            item.erase(0, 2);
+        if (item.size() == etag.size() + 2 && item.front() == '"' && item.back() == '"' && item.compare(1, etag.size(), etag) == 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Whether the ranges of a request apply to the current file, as decided by its If-Range header.
+ *
+ * @param req The request.
+ * @param etag The strong ETag of the file without quotes.
+ * @param mtime The modification time of the file.
+ * @return True if there is no If-Range header or it matches the file.
+ */
+static bool if_range_holds(const Request &req, const std::string &etag, time_t mtime) {
+    if (!req.has_header("If-Range"))
+        return true;
+    const std::string if_range = req.get_header_value("If-Range");
+    // weak ETags never match, a range of a different representation would corrupt the client copy
+    if (!if_range.empty() && (if_range.front() == '"' || if_range.compare(0, 2, "W/") == 0))
+        return !etag.empty() && if_range == "\"" + etag + "\"";
+    time_t date;
+    return parse_http_date(if_range, date) && date == mtime;
+}
+
 HttpServer::HttpServer(const int &port, const std::string &host) : webpath(WEB_HOME),
                                                                    port(port),
-                                                                   host(host) {}
+                                                                   host(host),
+                                                                   file_streaming(false) {}
 
 HttpServer::~HttpServer() {}
 
 bool HttpServer::register_handler(std::string path, HttpMethods method, http_handler handler) {
     switch (method) {
     case HttpMethods::GET:
-        this->srv.Get(path, handler);
-        return true;
+        return this->router.add("GET", path, handler);
     case HttpMethods::POST:
-        this->srv.Post(path, handler);
-        return true;
+        return this->router.add("POST", path, handler);
     default:
         int method_size = sizeof(http_methods) / sizeof(http_methods[0]);
         logf_warn("not supported method: %s\n", (int(method) < method_size && int(method) >= 0) ? http_methods[int(method)].c_str() : "Unknown");
@@ -40,8 +206,7 @@ bool HttpServer::register_handler(std::string path, HttpMethods method, http_han
 bool HttpServer::register_handler(std::string path, HttpMethods method, http_handler_with_content handler) {
     switch (method) {
     case HttpMethods::POST:
-        this->srv.Post(path, handler);
-        return true;
+        return this->router.add("POST", path, handler);
     default:
         return false;
     }
@@ -85,9 +250,46 @@ void HttpServer::set_keep_alive_timeout(time_t sec) {
     this->srv.set_keep_alive_timeout(sec);
 }
 
+void HttpServer::enable_asset_cache(size_t max_file_bytes, size_t max_total_bytes) {
+    this->asset_cache = std::make_unique<AssetCache>(max_file_bytes, max_total_bytes);
+}
+
+void HttpServer::enable_file_streaming() {
+    this->file_streaming = true;
+}
+
+void HttpServer::set_cache_control(const std::string &prefix, const std::string &value) {
+    for (auto &policy : this->cache_policies) {
+        if (policy.first == prefix) {
+            policy.second = value;
+            return;
+        }
+    }
+    this->cache_policies.emplace_back(prefix, value);
+}
+
+void HttpServer::set_task_queue(std::function<httplib::TaskQueue *()> factory) {
+    this->srv.new_task_queue = std::move(factory);
+    this->task_queue_metrics.reset();
+}
+
+void HttpServer::enable_work_stealing_pool(const WorkStealingPool::Options &options) {
+    auto metrics = std::make_shared<TaskQueueMetrics>();
+    this->srv.new_task_queue = [options, metrics]() {
+        return new WorkStealingPool(options, metrics);
+    };
+    this->task_queue_metrics = std::move(metrics);
+}
+
+TaskQueueStats HttpServer::task_queue_stats() const {
+    return this->task_queue_metrics ? this->task_queue_metrics->snapshot() : TaskQueueStats();
+}
+
 void HttpServer::stop() {
     this->srv.stop();
     this->run_future.wait();
+    if (this->asset_cache)
+        this->asset_cache->close();
     logf_info("stop http server\n");
 }
 
@@ -97,8 +299,124 @@ bool HttpServer::run() {
         logf_err("set mount point '/' to %s failed.\n", this->webpath.c_str());
         return ret;
     }
+    // The cache is consulted first, then the file is streamed from disk, anything else falls through to the mount point
+    if (this->asset_cache && !this->asset_cache->open(this->webpath))
+        this->asset_cache.reset();
+    if (this->asset_cache || this->file_streaming) {
+        this->srv.set_pre_routing_handler([this](const Request &req, Response &res) {
+            bool served = (this->asset_cache && this->serve_asset(req, res)) || (this->file_streaming && this->serve_file(req, res));
+            return served ? Server::HandlerResponse::Handled : Server::HandlerResponse::Unhandled;
+        });
+    }
+    // Routes are looked up in the tree instead of the linear regex scan of httplib
+    this->srv.set_dispatcher([this](Request &req, Response &res, const ContentReader *content_reader) {
+        return this->router.dispatch(req, res, content_reader);
+    });
     logf_info("start http server\n");
     logf_info("started to listen http://%s:%d\n", host.c_str(), port);
     ret = this->srv.listen(host, port);
     return ret;
 }
+
+bool HttpServer::serve_asset(const Request &req, Response &res) {
+    if (req.method != "GET" && req.method != "HEAD")
+        return false;
+    std::string path = req.path;
+    if (path.empty() || path.back() == '/')
+        path += "index.html";
+    auto asset = this->asset_cache->find(path);
+    if (!asset)
+        return false;
+
+    // Prefer the smallest variant the client accepts, every variant has its own ETag.
+    // Ranges are always taken from the original
+    const time_t mtime = asset->stamp.mtime;
+    const bool ranged = !req.ranges.empty() && if_range_holds(req, asset->etag, mtime);
+    auto body = asset->identity;
+    std::string etag = asset->etag;
+    const std::string accept_encoding = ranged ? std::string() : req.get_header_value("Accept-Encoding");
+    if (asset->brotli && accepts_encoding(accept_encoding, "br")) {
+        body = asset->brotli;
+        etag += "-br";
+        res.set_header("Content-Encoding", "br");
+    } else if (asset->gzip && accepts_encoding(accept_encoding, "gzip")) {
+        body = asset->gzip;
+        etag += "-gz";
+        res.set_header("Content-Encoding", "gzip");
+    }
+    if (asset->gzip || asset->brotli)
+        res.set_header("Vary", "Accept-Encoding");
+    res.set_header("Accept-Ranges", "bytes");
+    if (this->not_modified(req, res, etag, mtime))
+        return true;
+    res.status = ranged ? 206 : 200;
+    if (body->empty()) {
+        res.set_header("Content-Type", asset->content_type);
+        return true;
+    }
+    // The response keeps the content alive, a reload does not pull it from under a slow client
+    res.set_content_provider(body->size(), asset->content_type, [body](size_t offset, size_t length, DataSink &sink) {
+        return sink.write(body->data() + offset, length);
+    });
+    return true;
+}
+
+bool HttpServer::serve_file(const Request &req, Response &res) {
+    if ((req.method != "GET" && req.method != "HEAD") || !detail::is_valid_path(req.path))
+        return false;
+    std::string path = this->webpath + req.path;
+    if (path.back() == '/')
+        path += "index.html";
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    auto file = std::make_shared<const OpenFile>(fd);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Revalidation only costs the fstat above once the ETag of this version is known
+    const std::string etag = this->file_etags.get(path, fd, FileStamp::of(st));
+    const bool ranged = !req.ranges.empty() && if_range_holds(req, etag, st.st_mtim.tv_sec);
+    res.set_header("Accept-Ranges", "bytes");
+    if (this->not_modified(req, res, etag, st.st_mtim.tv_sec))
+        return true;
+    res.status = ranged ? 206 : 200;
+    const char *type = detail::find_content_type(path, {});
+    if (st.st_size == 0) {
+        if (type)
+            res.set_header("Content-Type", type);
+        return true;
+    }
+    // Only the range being sent passes through the process, memory use does not grow with the file
+    res.set_content_provider(static_cast<size_t>(st.st_size), type ? type : "application/octet-stream", [file](size_t offset, size_t length, DataSink &sink) {
+        return send_file_range(file->fd, offset, length, sink);
+    });
+    return true;
+}
+
+bool HttpServer::not_modified(const Request &req, Response &res, const std::string &etag, time_t mtime) const {
+    if (!etag.empty())
+        res.set_header("ETag", "\"" + etag + "\"");
+    res.set_header("Last-Modified", http_date(mtime));
+    const std::pair<std::string, std::string> *policy = nullptr;
+    for (const auto &candidate : this->cache_policies) {
+        if (req.path.compare(0, candidate.first.size(), candidate.first) == 0 && (!policy || candidate.first.size() > policy->first.size()))
+            policy = &candidate;
+    }
+    if (policy)
+        res.set_header("Cache-Control", policy->second);
+
+    // If-None-Match takes precedence, If-Modified-Since is only for clients that did not keep the ETag
+    bool fresh;
+    if (req.has_header("If-None-Match")) {
+        fresh = !etag.empty() && etag_listed(req.get_header_value("If-None-Match"), etag);
+    } else {
+        time_t since;
+        fresh = req.has_header("If-Modified-Since") && parse_http_date(req.get_header_value("If-Modified-Since"), since) && mtime <= since;
+    }
+    if (fresh)
+        res.status = 304;
+    return fresh;
+}
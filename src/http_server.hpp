@@ -13,7 +13,15 @@
 #pragma once
 
 #include <httplib.h>
+#include <asset_cache.hpp>
+#include <http_router.hpp>
+#include <work_stealing_pool.hpp>
+#include <functional>
 #include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifndef WEB_HOME
 #define WEB_HOME "/var/www/html"
@@ -48,7 +56,8 @@ namespace httpservernp
         /**
          * @brief Register a handler for a specific path and HTTP method.
          *
-         * @param path The URL path to register the handler for.
+         * @param path The URL path to register the handler for, literal or with parameters such as /api/dev/:id<uint>, see HttpRouter.
+         *             Regular expressions are still accepted and matched after the other routes.
          * @param method The HTTP method to register the handler for.
          * @param handler The handler function to be called for the specified path and method.
          * @return True if the registration is successful, false otherwise.
@@ -58,7 +67,7 @@ namespace httpservernp
         /**
          * @brief Register a handler with content reader for a specific path and HTTP method.
          *
-         * @param path The URL path to register the handler for.
+         * @param path The URL path to register the handler for, with the same syntax as above.
          * @param method The HTTP method to register the handler for.
          * @param handler The handler function with content reader to be called for the specified path and method.
          * @return True if the registration is successful, false otherwise.
@@ -140,6 +149,64 @@ namespace httpservernp
          */
         void set_keep_alive_timeout(time_t sec);
 
+        /**
+         * @brief Serve the web root from memory instead of reading each file on every request.
+         *
+         * Must be called before start. Files are loaded when the server starts and reloaded when they change on disk.
+         * Responses are negotiated with Accept-Encoding between the original and its gzip or brotli variants.
+         * Files that do not fit are still served from disk.
+         *
+         * @param max_file_bytes Files bigger than this are not cached.
+         * @param max_total_bytes Upper bound of the memory used by the cache.
+         */
+        void enable_asset_cache(size_t max_file_bytes = 16 * 1024 * 1024, size_t max_total_bytes = 64 * 1024 * 1024);
+
+        /**
+         * @brief Stream files under the web root from disk instead of reading each one into memory.
+         *
+         * Must be called before start. Bodies are sent with sendfile(2) a few MiB at a time, so memory use does not depend on the file size.
+         * Single and multiple byte ranges are supported. Files held by the asset cache are still served from it.
+         */
+        void enable_file_streaming();
+
+        /**
+         * @brief Set the Cache-Control header of the static files under a path prefix.
+         *
+         * Must be called before start. The longest matching prefix wins, files matching no prefix get no Cache-Control header.
+         * Applies to the files served by the asset cache or streamed from disk, which also carry ETag and Last-Modified
+         * and answer If-None-Match and If-Modified-Since with 304.
+         *
+         * @param prefix The URL path prefix, "/" for the whole web root.
+         * @param value The Cache-Control header value, e.g. "no-cache" or "public, max-age=31536000, immutable".
+         */
+        void set_cache_control(const std::string &prefix, const std::string &value);
+
+        /**
+         * @brief Set the task queue running the connections, replacing the fixed httplib thread pool.
+         *
+         * Must be called before start. The factory is called each time the server starts listening,
+         * a queue refusing a task makes the server answer that connection with 503.
+         *
+         * @param factory Creates the task queue, owned by the server until it stops.
+         */
+        void set_task_queue(std::function<httplib::TaskQueue *()> factory);
+
+        /**
+         * @brief Run the connections on a WorkStealingPool.
+         *
+         * Must be called before start. Its metrics are available from task_queue_stats.
+         *
+         * @param options Sizing of the pool.
+         */
+        void enable_work_stealing_pool(const WorkStealingPool::Options &options = WorkStealingPool::Options());
+
+        /**
+         * @brief Metrics of the work-stealing pool: workers, queue depth, wait time and refused connections.
+         *
+         * @return TaskQueueStats All zero if the work-stealing pool is not enabled.
+         */
+        TaskQueueStats task_queue_stats() const;
+
     private:
         /**
          * @brief Run the HTTP server.
@@ -148,11 +215,46 @@ namespace httpservernp
          */
         bool run();
 
-        std::future<bool> run_future; /** The future object for the running server. */
-        std::string webpath;          /** The path to the web root directory. */
-        Server srv;                   /** The underlying HTTP server instance. */
-        int port;                     /** The port number to listen on. */
-        std::string host;             /** The host IP address or name to bind the server to. */
+        /**
+         * @brief Serve a GET or HEAD request from the asset cache.
+         *
+         * @param req The request.
+         * @param res The response.
+         * @return True if the request was served, false to let the server handle it.
+         */
+        bool serve_asset(const Request &req, Response &res);
+
+        /**
+         * @brief Serve a GET or HEAD request by streaming a file under the web root.
+         *
+         * @param req The request.
+         * @param res The response.
+         * @return True if the request was served, false to let the server handle it.
+         */
+        bool serve_file(const Request &req, Response &res);
+
+        /**
+         * @brief Add the validators and the cache policy to a static response, then evaluate its conditional headers.
+         *
+         * @param req The request.
+         * @param res The response.
+         * @param etag The ETag of the representation being sent without quotes, empty if there is none.
+         * @param mtime The modification time of the file.
+         * @return True if the client copy is still fresh and the response has become a 304.
+         */
+        bool not_modified(const Request &req, Response &res, const std::string &etag, time_t mtime) const;
+
+        std::future<bool> run_future;                                    /** The future object for the running server. */
+        std::string webpath;                                             /** The path to the web root directory. */
+        Server srv;                                                      /** The underlying HTTP server instance. */
+        HttpRouter router;                                               /** Routes of the registered handlers. */
+        int port;                                                        /** The port number to listen on. */
+        std::string host;                                                /** The host IP address or name to bind the server to. */
+        std::unique_ptr<AssetCache> asset_cache;                         /** The in-memory copy of the web root, null if disabled. */
+        bool file_streaming;                                             /** Stream files from disk instead of reading them into memory. */
+        ETagCache file_etags;                                            /** ETags of the files streamed from disk. */
+        std::vector<std::pair<std::string, std::string>> cache_policies; /** Cache-Control values by path prefix. */
+        std::shared_ptr<TaskQueueMetrics> task_queue_metrics;            /** Metrics of the work-stealing pool, null if not enabled. */
     };
 
 } // namespace httpservernp
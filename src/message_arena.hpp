@@ -0,0 +1,228 @@
+/**
+ * @file message_arena.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 每个连接一个的单调内存池, 以及从中分配的消息JSON类型
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @class MessageArena
+     * @brief 单调分配的内存池, 处理完一条消息后整体回收
+     *
+     * 释放单个对象不做任何事, reset时回到第一块内存重新分配.
+     * 只在所属连接的线程中使用, 不加锁
+     */
+    class MessageArena
+    {
+    public:
+        /**
+         * @brief 构造函数, 第一次分配时才申请内存
+         *
+         * @param block_size 每块内存的字节数
+         * @param retained_bytes reset后最多保留的字节数, 处理过超大消息后把多余的块还给系统
+         */
+        explicit MessageArena(size_t block_size = 16 * 1024, size_t retained_bytes = 256 * 1024) : block_size(block_size), retained_bytes(retained_bytes) {}
+
+        MessageArena(const MessageArena &) = delete;
+        MessageArena &operator=(const MessageArena &) = delete;
+
+        /**
+         * @brief 分配内存
+         *
+         * @param size 字节数
+         * @param alignment 对齐, 不超过max_align_t
+         * @return void*
+         */
+        void *allocate(size_t size, size_t alignment) {
+            while (this->current < this->blocks.size()) {
+                Block &block = this->blocks[this->current];
+                size_t offset = (this->offset + alignment - 1) & ~(alignment - 1);
+                if (offset + size <= block.size) {
+                    this->offset = offset + size;
+                    this->used += size;
+                    return block.data.get() + offset;
+                }
+                ++this->current;
+                this->offset = 0;
+            }
+            // 超过块大小的分配单独占一块, 保证普通的块不会因此被撑大
+            Block block{std::unique_ptr<char[]>(new char[std::max(size, this->block_size)]), std::max(size, this->block_size)};
+            this->reserved += block.size;
+            ++this->block_allocations;
+            this->blocks.push_back(std::move(block));
+            this->current = this->blocks.size() - 1;
+            this->offset = size;
+            this->used += size;
+            return this->blocks.back().data.get();
+        }
+
+        /**
+         * @brief 回收全部分配, 保留的块留给下一条消息
+         */
+        void reset() {
+            while (this->blocks.size() > 1 && this->reserved > this->retained_bytes) {
+                this->reserved -= this->blocks.back().size;
+                this->blocks.pop_back();
+            }
+            this->current = 0;
+            this->offset = 0;
+            this->used = 0;
+        }
+
+        /**
+         * @brief 自上次reset以来分配的字节数
+         *
+         * @return size_t
+         */
+        size_t bytes_used() const {
+            return this->used;
+        }
+
+        /**
+         * @brief 向系统申请内存块的累计次数
+         *
+         * @return uint64_t
+         */
+        uint64_t block_allocation_count() const {
+            return this->block_allocations;
+        }
+
+        /**
+         * @brief 当前线程正在使用的内存池
+         *
+         * @return MessageArena* 不在Scope内时返回nullptr
+         */
+        static MessageArena *active() {
+            return active_arena();
+        }
+
+        /**
+         * @class Scope
+         * @brief 作用域内当前线程的MessageJson都从该内存池分配, 离开时回收
+         *
+         * 作用域内创建的MessageJson必须在离开作用域前销毁
+         */
+        class Scope
+        {
+        public:
+            explicit Scope(MessageArena &arena) : arena(arena), previous(active_arena()) {
+                active_arena() = &arena;
+            }
+
+            ~Scope() {
+                active_arena() = this->previous;
+                this->arena.reset();
+            }
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            MessageArena &arena;
+            MessageArena *previous;
+        };
+
+    private:
+        struct Block {
+            std::unique_ptr<char[]> data; // 内存
+            size_t size;                  // 字节数
+        };
+
+        std::vector<Block> blocks;      // 已申请的块
+        size_t block_size;              // 普通块的字节数
+        size_t retained_bytes;          // reset后最多保留的字节数
+        size_t reserved = 0;            // 已申请的总字节数
+        size_t current = 0;             // 正在分配的块
+        size_t offset = 0;              // 当前块内已分配到的位置
+        size_t used = 0;                // 自上次reset以来分配的字节数
+        uint64_t block_allocations = 0; // 向系统申请块的次数
+
+        static MessageArena *&active_arena() {
+            static thread_local MessageArena *arena = nullptr;
+            return arena;
+        }
+    };
+
+    /**
+     * @brief 从当前线程的MessageArena分配的分配器, 不在Scope内时使用堆
+     *
+     * 每次分配前有一个头部记录来源, 释放时据此决定是否交还给堆,
+     * 这样在Scope之外销毁从堆分配的对象也是安全的
+     *
+     * @tparam T
+     */
+    template <typename T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+        using is_always_equal = std::true_type;
+
+        ArenaAllocator() noexcept = default;
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U> &) noexcept {}
+
+        T *allocate(size_t n) {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+            size_t size = header_size + n * sizeof(T);
+            char *memory;
+            MessageArena *arena = MessageArena::active();
+            if (arena) {
+                memory = static_cast<char *>(arena->allocate(size, alignof(std::max_align_t)));
+                *reinterpret_cast<uintptr_t *>(memory) = from_arena;
+            } else {
+                memory = static_cast<char *>(::operator new(size));
+                *reinterpret_cast<uintptr_t *>(memory) = from_heap;
+            }
+            return reinterpret_cast<T *>(memory + header_size);
+        }
+
+        void deallocate(T *p, size_t) noexcept {
+            char *memory = reinterpret_cast<char *>(p) - header_size;
+            if (*reinterpret_cast<uintptr_t *>(memory) == from_heap)
+                ::operator delete(memory);
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U> &) const noexcept {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const ArenaAllocator<U> &) const noexcept {
+            return false;
+        }
+
+    private:
+        static constexpr size_t header_size = alignof(std::max_align_t);
+        static constexpr uintptr_t from_heap = 0;
+        static constexpr uintptr_t from_arena = 1;
+    };
+
+    /**
+     * @brief 消息处理中使用的JSON类型, 对象和数组的节点从MessageArena分配
+     *
+     * 超过短字符串优化长度的字符串内容仍在堆上. 可与nlohmann::json互相转换,
+     * 回调中需要保留到消息处理之后的数据应先转换为nlohmann::json
+     */
+    using MessageJson = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double, ArenaAllocator>;
+} // namespace websocketnp
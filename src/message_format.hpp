@@ -0,0 +1,185 @@
+/**
+ * @file message_format.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocket消息的序列化格式: JSON, MessagePack, CBOR
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @brief 消息的序列化格式
+     *
+     * 客户端可通过子协议(Sec-WebSocket-Protocol)协商, 未协商时由收到的第一帧决定
+     */
+    enum class MessageFormat : uint8_t
+    {
+        Json,        /** 文本帧, JSON */
+        MessagePack, /** 二进制帧, MessagePack */
+        Cbor         /** 二进制帧, CBOR */
+    };
+
+    /**
+     * @brief 格式对应的子协议名
+     *
+     * @param format
+     * @return const char*
+     */
+    inline const char *subprotocol_name(MessageFormat format) {
+        switch (format) {
+        case MessageFormat::MessagePack:
+            return "msgpack";
+        case MessageFormat::Cbor:
+            return "cbor";
+        case MessageFormat::Json:
+        default:
+            return "json";
+        }
+    }
+
+    /**
+     * @brief 服务端支持的全部子协议
+     *
+     * @return std::vector<std::string>
+     */
+    inline std::vector<std::string> supported_subprotocols() {
+        return {subprotocol_name(MessageFormat::Json), subprotocol_name(MessageFormat::MessagePack), subprotocol_name(MessageFormat::Cbor)};
+    }
+
+    /**
+     * @brief 由握手选中的子协议确定格式
+     *
+     * @param subprotocol 子协议名
+     * @param format 输出的格式
+     * @return bool 不是支持的子协议时返回false
+     */
+    inline bool parse_subprotocol(const std::string &subprotocol, MessageFormat &format) {
+        for (MessageFormat candidate : {MessageFormat::Json, MessageFormat::MessagePack, MessageFormat::Cbor}) {
+            if (subprotocol == subprotocol_name(candidate)) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 格式是否使用二进制帧
+     *
+     * @param format
+     * @return bool
+     */
+    inline bool is_binary_format(MessageFormat format) {
+        return format != MessageFormat::Json;
+    }
+
+    /**
+     * @brief 按格式解析消息, 出错时抛出nlohmann::json::exception
+     *
+     * @tparam Json 解析结果的JSON类型
+     * @param format
+     * @param data
+     * @return Json
+     */
+    template <typename Json = nlohmann::json>
+    Json decode_message(MessageFormat format, std::string_view data) {
+        switch (format) {
+        case MessageFormat::MessagePack:
+            return Json::from_msgpack(data.begin(), data.end());
+        case MessageFormat::Cbor:
+            return Json::from_cbor(data.begin(), data.end());
+        case MessageFormat::Json:
+        default:
+            return Json::parse(data.begin(), data.end());
+        }
+    }
+
+    /**
+     * @brief 区分二进制消息的格式
+     *
+     * 消息是对象或命令数组. CBOR的map以0xa0~0xbf开头, 在MessagePack中是fixstr, 不会是消息;
+     * MessagePack的map16/32和array16/32以0xdc~0xdf开头, 在CBOR中是附加信息为28~30的保留tag头和附加信息为31的tag头, 都不能作为CBOR消息的开头;
+     * 0x9c~0x9e是附加信息保留的CBOR array头, 同样无效.
+     * 其余0x80~0x9f两者都可能: MessagePack的fixmap/fixarray, CBOR的array. 这时先按MessagePack解析, 失败再按CBOR解析
+     *
+     * @param data 收到的二进制消息
+     * @param format 输出的格式
+     * @return bool 无法识别时返回false
+     */
+    inline bool detect_binary_format(std::string_view data, MessageFormat &format) {
+        if (data.empty())
+            return false;
+        uint8_t first = static_cast<uint8_t>(data[0]);
+        if ((first >= 0xdc && first <= 0xdf) || (first >= 0x9c && first <= 0x9e)) {
+            format = MessageFormat::MessagePack;
+            return true;
+        }
+        if (first >= 0xa0 && first <= 0xbf) {
+            format = MessageFormat::Cbor;
+            return true;
+        }
+        if (first < 0x80 || first > 0x9f)
+            return false;
+        if (!nlohmann::json::from_msgpack(data.begin(), data.end(), true, false).is_discarded()) {
+            format = MessageFormat::MessagePack;
+            return true;
+        }
+        if (!nlohmann::json::from_cbor(data.begin(), data.end(), true, false).is_discarded()) {
+            format = MessageFormat::Cbor;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 按格式序列化消息到已有的缓冲区, 缓冲区的容量可以重复利用
+     *
+     * @tparam Json
+     * @param format
+     * @param msg
+     * @param out 输出, 原有内容被清空. JSON为UTF-8文本, 其余为二进制数据
+     */
+    template <typename Json>
+    void encode_message(MessageFormat format, const Json &msg, std::string &out) {
+        out.clear();
+        switch (format) {
+        case MessageFormat::MessagePack:
+            Json::to_msgpack(msg, out);
+            break;
+        case MessageFormat::Cbor:
+            Json::to_cbor(msg, out);
+            break;
+        case MessageFormat::Json:
+        default:
+            // 与basic_json::dump相同, 只是写入调用者的缓冲区
+            nlohmann::detail::serializer<Json>(nlohmann::detail::output_adapter<char>(out), ' ').dump(msg, false, false, 0);
+            break;
+        }
+    }
+
+    /**
+     * @brief 按格式序列化消息
+     *
+     * @tparam Json
+     * @param format
+     * @param msg
+     * @return std::string JSON为UTF-8文本, 其余为二进制数据
+     */
+    template <typename Json>
+    std::string encode_message(MessageFormat format, const Json &msg) {
+        std::string out;
+        encode_message(format, msg, out);
+        return out;
+    }
+} // namespace websocketnp
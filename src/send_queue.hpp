@@ -0,0 +1,185 @@
+/**
+ * @file send_queue.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocket客户端的有界发送队列
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace websocketnp
+{
+    /// 序列化后的共享只读消息
+    using SharedPayload = std::shared_ptr<const std::string>;
+
+    /**
+     * @struct SharedMessage
+     * @brief 一条广播消息按某组协商参数编码的结果, 由该组所有客户端共享
+     */
+    struct SharedMessage {
+        SharedPayload payload;   // 按该组的消息格式序列化后的数据
+        bool binary = false;     // payload是否以二进制帧发送
+        SharedPayload frames;    // 编码好的完整帧, 为空时由连接自己编码payload
+        uint8_t window_bits = 0; // frames的压缩窗口大小, 0表示未压缩
+    };
+
+    using SharedMessagePtr = std::shared_ptr<const SharedMessage>;
+
+    /**
+     * @brief 慢消费者处理策略
+     */
+    enum class SlowConsumerPolicy
+    {
+        DropOldest,     /** 丢弃队列中最早的消息 */
+        CoalesceLatest, /** 丢弃所有积压的消息, 只保留最新一条 */
+        Disconnect      /** 断开该客户端 */
+    };
+
+    /**
+     * @struct SendQueueCounters
+     * @brief 发送队列的累计计数
+     */
+    struct SendQueueCounters {
+        std::atomic<uint64_t> enqueued{0};     // 入队消息数
+        std::atomic<uint64_t> sent{0};         // 已发送消息数
+        std::atomic<uint64_t> dropped{0};      // DropOldest丢弃的消息数
+        std::atomic<uint64_t> coalesced{0};    // CoalesceLatest合并掉的消息数
+        std::atomic<uint64_t> disconnected{0}; // Disconnect断开的客户端数
+    };
+
+    /**
+     * @class SendQueue
+     * @brief 单个客户端的有界发送队列
+     *
+     * 广播线程只负责入队, 由该客户端自己的连接线程出队并发送,
+     * 因此一个阻塞的客户端不会拖慢其他客户端
+     */
+    class SendQueue
+    {
+    public:
+        /**
+         * @brief 入队结果
+         */
+        enum class PushResult
+        {
+            Queued,   /** 已入队, 队列原本非空 */
+            Wakeup,   /** 已入队, 队列原本为空, 需要唤醒连接线程 */
+            Overflow, /** 队列已满且策略为Disconnect, 消息未入队, 需要断开客户端 */
+            Rejected  /** 已因溢出断开, 消息未入队 */
+        };
+
+        /**
+         * @brief 构造函数
+         *
+         * @param capacity 队列容量
+         * @param policy 队列满时的处理策略
+         * @param counters 全局计数
+         */
+        SendQueue(size_t capacity, SlowConsumerPolicy policy, std::shared_ptr<SendQueueCounters> counters)
+            : capacity(capacity == 0 ? 1 : capacity), policy(policy), counters(std::move(counters)) {}
+
+        /**
+         * @brief 消息入队
+         *
+         * @param message 要发送的消息
+         * @return PushResult
+         */
+        PushResult push(const SharedMessagePtr &message) {
+            std::lock_guard<std::mutex> lock(this->queue_mutex);
+            if (this->overflowed)
+                return PushResult::Rejected;
+            if (this->queue.size() >= this->capacity) {
+                switch (this->policy) {
+                case SlowConsumerPolicy::DropOldest:
+                    this->queue.pop_front();
+                    ++this->dropped;
+                    ++this->counters->dropped;
+                    break;
+                case SlowConsumerPolicy::CoalesceLatest:
+                    this->dropped += this->queue.size();
+                    this->counters->coalesced += this->queue.size();
+                    this->queue.clear();
+                    break;
+                case SlowConsumerPolicy::Disconnect:
+                    this->overflowed = true;
+                    ++this->counters->disconnected;
+                    return PushResult::Overflow;
+                }
+            }
+            bool was_empty = this->queue.empty();
+            this->queue.push_back(message);
+            ++this->counters->enqueued;
+            return was_empty ? PushResult::Wakeup : PushResult::Queued;
+        }
+
+        /**
+         * @brief 取出队首消息
+         *
+         * @return SharedMessagePtr 队列为空时返回nullptr
+         */
+        SharedMessagePtr pop() {
+            std::lock_guard<std::mutex> lock(this->queue_mutex);
+            if (this->queue.empty())
+                return nullptr;
+            SharedMessagePtr message = std::move(this->queue.front());
+            this->queue.pop_front();
+            return message;
+        }
+
+        /**
+         * @brief 在连接线程中发送积压的消息, 直到队列为空或连接暂时不可写
+         *
+         * @tparam Ready bool()
+         * @tparam Sender bool(const SharedMessage &)
+         * @param ready 连接是否还能继续写入, 返回false时剩余消息留在队列中
+         * @param sender 实际的发送函数
+         */
+        template <typename Ready, typename Sender>
+        void drain(Ready &&ready, Sender &&sender) {
+            while (ready()) {
+                SharedMessagePtr message = this->pop();
+                if (!message || !sender(*message))
+                    break;
+                ++this->counters->sent;
+            }
+        }
+
+        /**
+         * @brief 当前队列长度
+         *
+         * @return size_t
+         */
+        size_t size() {
+            std::lock_guard<std::mutex> lock(this->queue_mutex);
+            return this->queue.size();
+        }
+
+        /**
+         * @brief 该客户端被丢弃的消息数
+         *
+         * @return uint64_t
+         */
+        uint64_t dropped_count() const {
+            return this->dropped.load();
+        }
+
+    private:
+        std::mutex queue_mutex;                      // 保护队列的互斥锁
+        std::deque<SharedMessagePtr> queue;          // 待发送的消息
+        size_t capacity;                             // 队列容量
+        SlowConsumerPolicy policy;                   // 慢消费者处理策略
+        bool overflowed = false;                     // 已因溢出被断开
+        std::atomic<uint64_t> dropped{0};            // 该客户端被丢弃的消息数
+        std::shared_ptr<SendQueueCounters> counters; // 全局计数
+    };
+} // namespace websocketnp
@@ -0,0 +1,148 @@
+/**
+ * @file status_stream.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 状态上报的增量编码: 周期性的关键帧加RFC 7386合并补丁
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @class StatusStream
+     * @brief 记录最近发布的状态, 每次更新时生成需要广播的消息
+     *
+     * 关键帧: {"type": 关键帧类型, "seq": 序号, "value": 完整状态}
+     * 补丁:   {"type": 补丁类型, "seq": 序号, "base": 上一条的序号, "value": 合并补丁}
+     * 客户端收到base与自己当前序号不一致的补丁时应丢弃, 等待下一个关键帧或主动请求关键帧
+     */
+    class StatusStream
+    {
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param keyframe_type 关键帧的消息类型
+         * @param patch_type 补丁的消息类型
+         * @param keyframe_interval 每隔多少次更新发送一次关键帧, 0表示只在第一次更新时发送
+         */
+        StatusStream(std::string keyframe_type, std::string patch_type, uint64_t keyframe_interval)
+            : keyframe_type(std::move(keyframe_type)), patch_type(std::move(patch_type)), keyframe_interval(keyframe_interval) {}
+
+        /**
+         * @brief 更新状态
+         *
+         * @param state 最新的完整状态
+         * @return std::optional<nlohmann::json> 需要广播的关键帧或补丁, 状态没有变化且不到关键帧时为空
+         */
+        std::optional<nlohmann::json> update(nlohmann::json state) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            bool keyframe_due = !this->published || (this->keyframe_interval != 0 && ++this->updates_since_keyframe >= this->keyframe_interval);
+            if (!keyframe_due && state == this->state)
+                return std::nullopt;
+
+            nlohmann::json patch;
+            if (!keyframe_due && !merge_patch_diff(this->state, state, patch))
+                keyframe_due = true;
+
+            ++this->seq;
+            this->state = std::move(state);
+            this->published = true;
+            if (keyframe_due) {
+                this->updates_since_keyframe = 0;
+                return this->make_keyframe();
+            }
+            return nlohmann::json{{"type", this->patch_type}, {"seq", this->seq}, {"base", this->seq - 1}, {"value", std::move(patch)}};
+        }
+
+        /**
+         * @brief 最近发布的状态对应的关键帧, 用于新连接和客户端重新同步
+         *
+         * @return nlohmann::json 还没有发布过时为null
+         */
+        nlohmann::json keyframe() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->published ? this->make_keyframe() : nlohmann::json();
+        }
+
+        /**
+         * @brief 生成把from变为to的RFC 7386合并补丁
+         *
+         * 合并补丁用null表示删除键, 无法表示对象中值为null的键, 遇到时返回false
+         *
+         * @param from 原状态
+         * @param to 新状态
+         * @param patch 输出的补丁, 对from调用merge_patch后与to相等
+         * @return bool
+         */
+        static bool merge_patch_diff(const nlohmann::json &from, const nlohmann::json &to, nlohmann::json &patch) {
+            if (!from.is_object() || !to.is_object()) {
+                if (to.is_null() || has_null_member(to))
+                    return false;
+                patch = to;
+                return true;
+            }
+
+            patch = nlohmann::json::object();
+            for (auto it = from.begin(); it != from.end(); ++it) {
+                if (!to.contains(it.key()))
+                    patch[it.key()] = nullptr;
+            }
+            for (auto it = to.begin(); it != to.end(); ++it) {
+                auto old = from.find(it.key());
+                if (old != from.end() && *old == *it)
+                    continue;
+                nlohmann::json sub;
+                if (!merge_patch_diff(old != from.end() ? *old : nlohmann::json(), *it, sub))
+                    return false;
+                patch[it.key()] = std::move(sub);
+            }
+            return true;
+        }
+
+    private:
+        std::string keyframe_type;           // 关键帧的消息类型
+        std::string patch_type;              // 补丁的消息类型
+        uint64_t keyframe_interval;          // 关键帧间隔的更新次数
+        std::mutex mutex;                    // 保护以下状态
+        nlohmann::json state;                // 最近发布的状态
+        bool published = false;              // 已发布过状态
+        uint64_t seq = 0;                    // 最近发布的消息序号
+        uint64_t updates_since_keyframe = 0; // 上一个关键帧之后的更新次数
+
+        /**
+         * @brief 对象中是否有值为null的键, 数组中的元素不受合并补丁影响
+         *
+         * @param value
+         * @return bool
+         */
+        static bool has_null_member(const nlohmann::json &value) {
+            if (!value.is_object())
+                return false;
+            for (const auto &member : value) {
+                if (member.is_null() || has_null_member(member))
+                    return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief 生成当前状态的关键帧, 调用者持有锁
+         *
+         * @return nlohmann::json
+         */
+        nlohmann::json make_keyframe() const {
+            return {{"type", this->keyframe_type}, {"seq", this->seq}, {"value", this->state}};
+        }
+    };
+} // namespace websocketnp
@@ -0,0 +1,140 @@
+/**
+ * @file timer_wheel.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 连接空闲超时的哈希时间轮
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <connection_registry.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @class TimerWheel
+     * @brief 按连接最后活跃时间判定空闲超时的哈希时间轮
+     *
+     * 刷新活跃时间只需更新连接上的原子时间戳, 不访问时间轮.
+     * 槽位到期时再检查真实的最后活跃时间: 已超时则回调, 否则按新的截止时间重新挂入,
+     * 因此刷新和到期处理对每个连接都是O(1)
+     */
+    class TimerWheel
+    {
+    public:
+        using clock = Connection::clock;
+
+        /**
+         * @brief 构造函数
+         *
+         * @param timeout 空闲超时时间
+         * @param granularity 时间轮的刻度, 即超时判定的精度
+         */
+        TimerWheel(std::chrono::milliseconds timeout, std::chrono::milliseconds granularity)
+            : timeout(timeout),
+              granularity(granularity.count() > 0 ? granularity : std::chrono::milliseconds(1)),
+              slots(static_cast<size_t>(timeout / this->granularity) + 2),
+              current_tick(this->to_tick(clock::now())) {}
+
+        /**
+         * @brief 按连接当前的最后活跃时间挂入时间轮
+         *
+         * @param connection
+         */
+        void schedule(const ConnectionPtr &connection) {
+            std::lock_guard<std::mutex> lock(this->wheel_mutex);
+            this->schedule_locked(connection, connection->last_active_time() + this->timeout);
+        }
+
+        /**
+         * @brief 推进时间轮到指定时刻, 收集所有已空闲超时的连接
+         *
+         * @param now 当前时刻
+         * @return std::vector<ConnectionPtr> 已超时的连接
+         */
+        std::vector<ConnectionPtr> advance(clock::time_point now) {
+            std::vector<ConnectionPtr> expired;
+            std::lock_guard<std::mutex> lock(this->wheel_mutex);
+            uint64_t target = this->to_tick(now);
+            while (this->current_tick < target) {
+                ++this->current_tick;
+                auto &slot = this->slots[this->current_tick % this->slots.size()];
+                std::vector<Entry> pending;
+                pending.swap(slot);
+                for (auto &entry : pending) {
+                    if (entry.tick > this->current_tick) {
+                        slot.push_back(std::move(entry));
+                        continue;
+                    }
+                    auto connection = entry.connection.lock();
+                    if (!connection)
+                        continue;
+                    auto deadline = connection->last_active_time() + this->timeout;
+                    if (deadline <= now)
+                        expired.push_back(std::move(connection));
+                    else
+                        this->schedule_locked(connection, deadline);
+                }
+            }
+            return expired;
+        }
+
+        /**
+         * @brief 时间轮的刻度
+         *
+         * @return std::chrono::milliseconds
+         */
+        std::chrono::milliseconds tick_interval() const {
+            return this->granularity;
+        }
+
+    private:
+        /**
+         * @struct Entry
+         * @brief 时间轮槽位中的一项
+         */
+        struct Entry {
+            uint64_t tick;                        // 截止时间所在的刻度
+            std::weak_ptr<Connection> connection; // 连接关闭后自动失效
+        };
+
+        /**
+         * @brief 时刻转换为刻度, 向上取整
+         *
+         * @param time_point
+         * @return uint64_t
+         */
+        uint64_t to_tick(clock::time_point time_point) const {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time_point.time_since_epoch());
+            return static_cast<uint64_t>((elapsed + this->granularity - std::chrono::milliseconds(1)) / this->granularity);
+        }
+
+        /**
+         * @brief 挂入时间轮, 调用者需持有wheel_mutex
+         *
+         * @param connection
+         * @param deadline 截止时间
+         */
+        void schedule_locked(const ConnectionPtr &connection, clock::time_point deadline) {
+            uint64_t tick = this->to_tick(deadline);
+            if (tick <= this->current_tick)
+                tick = this->current_tick + 1;
+            this->slots[tick % this->slots.size()].push_back({tick, connection});
+        }
+
+        std::chrono::milliseconds timeout;     // 空闲超时时间
+        std::chrono::milliseconds granularity; // 刻度
+        std::vector<std::vector<Entry>> slots; // 槽位
+        uint64_t current_tick;                 // 已处理到的刻度
+        std::mutex wheel_mutex;                // 保护时间轮
+    };
+} // namespace websocketnp
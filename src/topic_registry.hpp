@@ -0,0 +1,184 @@
+/**
+ * @file topic_registry.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 主题到订阅连接的索引, 按主题发布时只遍历订阅了该主题的连接
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <connection_registry.hpp>
+
+namespace websocketnp
+{
+    /**
+     * @class TopicRegistry
+     * @brief 主题订阅表
+     *
+     * 主题表和每个主题的订阅者列表都以不可变快照的方式发布: 订阅和退订时复制受影响的列表再原子替换,
+     * 发布时取得快照即可遍历, 不会阻塞订阅者的增删
+     */
+    class TopicRegistry
+    {
+    public:
+        /// 按id升序排列的订阅者快照
+        using Subscribers = ConnectionRegistry::Snapshot;
+
+        TopicRegistry() : topics(std::make_shared<const TopicMap>()) {}
+
+        /**
+         * @brief 获取主题的订阅者快照
+         *
+         * @param topic 主题名
+         * @return Subscribers 没有订阅者时返回nullptr
+         */
+        Subscribers subscribers(const std::string &topic) const {
+            auto snapshot = std::atomic_load(&this->topics);
+            auto it = snapshot->find(topic);
+            return it == snapshot->end() ? nullptr : it->second;
+        }
+
+        /**
+         * @brief 订阅主题, 已订阅时不做任何事
+         *
+         * @param connection 订阅的连接
+         * @param topic 主题名
+         * @return bool 超过每个连接的主题数上限时返回false
+         */
+        bool subscribe(const ConnectionPtr &connection, const std::string &topic) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto &joined = this->connection_topics[connection->id];
+            if (std::find(joined.begin(), joined.end(), topic) != joined.end())
+                return true;
+            if (joined.size() >= max_topics_per_connection)
+                return false;
+            joined.push_back(topic);
+
+            auto updated = std::make_shared<TopicMap>(*std::atomic_load(&this->topics));
+            auto &list = (*updated)[topic];
+            auto copied = list ? std::make_shared<std::vector<ConnectionPtr>>(*list) : std::make_shared<std::vector<ConnectionPtr>>();
+            copied->insert(std::lower_bound(copied->begin(), copied->end(), connection->id, less_id), connection);
+            list = std::move(copied);
+            std::atomic_store(&this->topics, std::shared_ptr<const TopicMap>(std::move(updated)));
+            return true;
+        }
+
+        /**
+         * @brief 退订主题
+         *
+         * @param id 数值形式的连接id
+         * @param topic 主题名
+         * @return bool 没有订阅该主题时返回false
+         */
+        bool unsubscribe(uint64_t id, const std::string &topic) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto joined = this->connection_topics.find(id);
+            if (joined == this->connection_topics.end())
+                return false;
+            auto it = std::find(joined->second.begin(), joined->second.end(), topic);
+            if (it == joined->second.end())
+                return false;
+            joined->second.erase(it);
+            if (joined->second.empty())
+                this->connection_topics.erase(joined);
+
+            auto updated = std::make_shared<TopicMap>(*std::atomic_load(&this->topics));
+            erase_subscriber(*updated, topic, id);
+            std::atomic_store(&this->topics, std::shared_ptr<const TopicMap>(std::move(updated)));
+            return true;
+        }
+
+        /**
+         * @brief 退订连接的所有主题, 连接关闭时调用
+         *
+         * @param id 数值形式的连接id
+         */
+        void remove(uint64_t id) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto joined = this->connection_topics.find(id);
+            if (joined == this->connection_topics.end())
+                return;
+            auto updated = std::make_shared<TopicMap>(*std::atomic_load(&this->topics));
+            for (const auto &topic : joined->second)
+                erase_subscriber(*updated, topic, id);
+            this->connection_topics.erase(joined);
+            std::atomic_store(&this->topics, std::shared_ptr<const TopicMap>(std::move(updated)));
+        }
+
+        /**
+         * @brief 连接订阅的主题, 按订阅的先后排列
+         *
+         * @param id 数值形式的连接id
+         * @return std::vector<std::string>
+         */
+        std::vector<std::string> topics_of(uint64_t id) {
+            std::lock_guard<std::mutex> lock(this->writer_mutex);
+            auto joined = this->connection_topics.find(id);
+            return joined == this->connection_topics.end() ? std::vector<std::string>() : joined->second;
+        }
+
+        /**
+         * @brief 每个主题的订阅者数
+         *
+         * @return std::map<std::string, size_t>
+         */
+        std::map<std::string, size_t> counts() const {
+            std::map<std::string, size_t> result;
+            for (const auto &topic : *std::atomic_load(&this->topics))
+                result.emplace(topic.first, topic.second->size());
+            return result;
+        }
+
+        static constexpr size_t max_topics_per_connection = 64; // 每个连接最多订阅的主题数
+        static constexpr size_t max_topic_length = 128;         // 主题名的最大长度
+
+    private:
+        using TopicMap = std::unordered_map<std::string, Subscribers>;
+
+        static bool less_id(const ConnectionPtr &connection, uint64_t id) {
+            return connection->id < id;
+        }
+
+        /**
+         * @brief 从主题表的副本中删除一个订阅者, 列表为空时删除主题, 调用者持有锁
+         *
+         * @param table 主题表的副本
+         * @param topic 主题名
+         * @param id 数值形式的连接id
+         */
+        static void erase_subscriber(TopicMap &table, const std::string &topic, uint64_t id) {
+            auto list = table.find(topic);
+            if (list == table.end())
+                return;
+            const auto &current = *list->second;
+            auto it = std::lower_bound(current.begin(), current.end(), id, less_id);
+            if (it == current.end() || (*it)->id != id)
+                return;
+            if (current.size() == 1) {
+                table.erase(list);
+                return;
+            }
+            auto copied = std::make_shared<std::vector<ConnectionPtr>>();
+            copied->reserve(current.size() - 1);
+            copied->insert(copied->end(), current.begin(), it);
+            copied->insert(copied->end(), it + 1, current.end());
+            list->second = std::move(copied);
+        }
+
+        std::mutex writer_mutex;                                                  // 串行化写者, 同时保护connection_topics
+        std::shared_ptr<const TopicMap> topics;                                   // 当前主题表快照
+        std::unordered_map<uint64_t, std::vector<std::string>> connection_topics; // 每个连接订阅的主题
+    };
+} // namespace websocketnp
@@ -11,18 +11,53 @@
 #pragma once
 
 #include <ixwebsocket/IXWebSocketServer.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflateCodec.h>
+#include <ixwebsocket/IXWebSocketPerMessageDeflateOptions.h>
 #include <functional>
 #include <string>
 #include <nlohmann/json.hpp>
 #include <map>
+#include <optional>
+#include <utility>
+#include <vector>
 #include <mutex>
 #include <chrono>
 #include <future>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <time.h>
 
 #include <log.h>
+#include <command_dispatch.hpp>
+#include <connection_registry.hpp>
+#include <message_format.hpp>
+#include <send_queue.hpp>
+#include <timer_wheel.hpp>
+#include <topic_registry.hpp>
+#include <worker_pool.hpp>
 
 namespace websocketnp
 {
+    /**
+     * @brief 消息回调的并发模式
+     */
+    enum class CallbackConcurrency
+    {
+        Reentrant,    /** 不加锁, 回调可在任意连接上并发执行 */
+        PerType,      /** 同一回调同一时刻只执行一个 */
+        PerConnection /** 同一连接上的回调串行执行, 不同连接之间并发 */
+    };
+
+    /**
+     * @brief 批量命令的执行方式
+     */
+    enum class BatchExecution
+    {
+        Sequential, /** 在连接线程上按顺序执行 */
+        Parallel    /** 同时执行, 回调仍受各自并发模式的约束, 回复按请求的顺序排列 */
+    };
+
     /**
      * @class WebsocketServer
      * @brief 用于处理WebSocket连接和消息的服务器类
@@ -30,18 +65,56 @@ namespace websocketnp
     class WebsocketServer
     {
     public:
-        /// 定义消息回调类型
-        using MessageCallback = std::function<nlohmann::json(const nlohmann::json &)>;
+        /// 定义消息回调类型, 参数和返回值都从连接的MessageArena分配, 也可使用接受和返回nlohmann::json的回调
+        using MessageCallback = std::function<MessageJson(const MessageJson &)>;
+        /// 异步回调的完成函数, 可在任意线程调用, 只有第一次调用有效
+        using Responder = std::function<void(nlohmann::json)>;
+        /// 异步消息回调, 在工作线程池中执行, 处理完成后调用Responder回复
+        using AsyncMessageCallback = std::function<void(const nlohmann::json &, Responder)>;
+        /// 生成新连接的第一条消息, 返回null时不发送
+        using GreetingCallback = std::function<nlohmann::json()>;
+        /**
+         * @struct BroadcastStats
+         * @brief 单次广播的统计信息
+         */
+        struct BroadcastStats {
+            size_t clients = 0;                          // 成功入队的客户端数
+            size_t overflowed = 0;                       // 因队列溢出被断开的客户端数
+            size_t bytes = 0;                            // 消息字节数
+            size_t encodings = 0;                        // 按协商参数分组编码的次数
+            size_t shared_bytes = 0;                     // 组内共享而不必重复编码的帧字节数
+            size_t deflate_saved_bytes = 0;              // 压缩帧比原始文本少发送的字节数
+            std::chrono::microseconds serialize_time{0}; // 序列化耗时
+            std::chrono::microseconds encode_time{0};    // 压缩和组帧占用的CPU时间
+            std::chrono::microseconds send_time{0};      // 编码和入队耗时
+        };
 
         /**
          * @brief 构造函数
          *
          * @param port 监听的端口号
          * @param host 监听的主机名
+         * @param timeout_duration 空闲超时时间, 为0时不检测
+         * @param timeout_granularity 超时检测的精度
          */
         WebsocketServer(int port,
                          std::string host,
-                         std::chrono::seconds timeout_duration = std::chrono::seconds(5)) : server(port, host), timeout_duration(timeout_duration), running(false) {}
+                         std::chrono::seconds timeout_duration = std::chrono::seconds(5),
+                         std::chrono::milliseconds timeout_granularity = std::chrono::milliseconds(100)) : server(port, host),
+                                                                                                           timeout_duration(timeout_duration),
+                                                                                                           running(false),
+                                                                                                           timeout_wheel(timeout_duration, timeout_granularity),
+                                                                                                           send_queue_capacity(64),
+                                                                                                           slow_consumer_policy(SlowConsumerPolicy::DropOldest),
+                                                                                                           send_queue_counters(std::make_shared<SendQueueCounters>()),
+                                                                                                           callbacks(std::make_shared<const CallbackTable>()),
+                                                                                                           batch_execution(BatchExecution::Sequential),
+                                                                                                           worker_thread_count(0),
+                                                                                                           default_topics(std::make_shared<const std::vector<std::string>>()) {
+            this->server.setConnectionStateFactory([]() {
+                return std::make_shared<ClientState>();
+            });
+        }
 
         /**
          * @brief 析构函数
@@ -53,9 +126,23 @@ namespace websocketnp
          * @brief 启动WebSocket服务器
          */
         void start() {
-            this->server.setOnClientMessageCallback([this](std::shared_ptr<ix::ConnectionState> connection_state, ix::WebSocket &websocket, const ix::WebSocketMessagePtr &msg) {
-                this->handle_message(connection_state, websocket, msg);
+            this->server.setOnConnectionCallback([this](std::weak_ptr<ix::WebSocket> weak_websocket, std::shared_ptr<ix::ConnectionState> connection_state) {
+                auto websocket = weak_websocket.lock();
+                if (!websocket)
+                    return;
+                ix::WebSocket *websocket_ptr = websocket.get();
+                // 消息在回调内同步解析, 直接使用接收缓冲区中的数据, 不再复制一份
+                websocket->enableZeroCopyDelivery();
+                // 客户端请求压缩时要求双方都不保留上下文: 空闲连接不占用zlib状态, 广播消息也只需压缩一次
+                websocket->setPerMessageDeflateOptions(ix::WebSocketPerMessageDeflateOptions(true, true, true));
+                // 按客户端请求的顺序选择第一个支持的子协议作为消息格式
+                for (const auto &subprotocol : supported_subprotocols())
+                    websocket->addSubProtocol(subprotocol);
+                websocket->setOnMessageCallback([this, weak_websocket, websocket_ptr, connection_state](const ix::WebSocketMessagePtr &msg) {
+                    this->handle_message(connection_state, weak_websocket, *websocket_ptr, msg);
+                });
             });
+            this->workers = std::make_unique<WorkerPool>(this->worker_thread_count);
             this->running = true;
             this->server.listen();
             this->server.start();
@@ -69,7 +156,13 @@ namespace websocketnp
          */
         void stop() {
             this->server.stop();
-            this->running = false;
+            // 连接线程都已退出, 执行完已提交的异步任务
+            this->workers.reset();
+            {
+                std::lock_guard<std::mutex> lock(this->timeout_mutex);
+                this->running = false;
+            }
+            this->timeout_cv.notify_all();
             if (this->timeout_future.valid())
                 this->timeout_future.wait();
         }
@@ -77,23 +170,233 @@ namespace websocketnp
         /**
          * @brief 广播消息给所有连接的客户端
          *
+         * 每种消息格式只序列化一次. 客户端按消息格式和握手协商的压缩参数分组, 每组只压缩和组帧一次,
+         * 组内所有客户端共享同一份不可变的帧数据.
+         * 广播线程只入队, 由各客户端的连接线程负责发送
+         *
          * @param msg 要广播的JSON消息
+         * @return BroadcastStats 本次广播的统计信息
          */
-        void brodcast_message(nlohmann::json &&msg) {
-            std::lock_guard<std::mutex> lock(this->websocket_mutex);
-            std::for_each(this->websockets.begin(), this->websockets.end(), [msg](const std::pair<const std::string, std::pair<std::pair<ix::WebSocket *, std::string>, std::chrono::steady_clock::time_point>> &entry) {
-                entry.second.first.first->send(msg.dump());
-            });
+        BroadcastStats brodcast_message(nlohmann::json &&msg) {
+            auto begin = std::chrono::steady_clock::now();
+            SharedPayload payload = std::make_shared<const std::string>(msg.dump());
+            auto serialized = std::chrono::steady_clock::now();
+
+            BroadcastStats stats = this->fan_out(this->websockets.snapshot(), payload, &msg);
+            stats.serialize_time = std::chrono::duration_cast<std::chrono::microseconds>(serialized - begin);
+            this->store_broadcast_stats(stats);
+            return stats;
+        }
+
+        /**
+         * @brief 广播已序列化的消息给所有连接的客户端
+         *
+         * 有使用二进制格式的客户端时才解析一次文本, 再转换为对应格式
+         *
+         * @param payload 已序列化的JSON文本, 由调用者保证编码合法
+         * @return BroadcastStats 本次广播的统计信息
+         */
+        BroadcastStats brodcast_payload(const SharedPayload &payload) {
+            BroadcastStats stats = this->fan_out(this->websockets.snapshot(), payload, nullptr);
+            this->store_broadcast_stats(stats);
+            return stats;
+        }
+
+        /**
+         * @brief 发布消息给订阅了主题的客户端
+         *
+         * 只遍历该主题的订阅者, 编码方式与brodcast_message相同. 没有订阅者时不序列化消息
+         *
+         * @param topic 主题名
+         * @param msg 要发布的JSON消息
+         * @return BroadcastStats 本次发布的统计信息
+         */
+        BroadcastStats publish(const std::string &topic, nlohmann::json &&msg) {
+            auto subscribers = this->topics.subscribers(topic);
+            if (!subscribers)
+                return {};
+            auto begin = std::chrono::steady_clock::now();
+            SharedPayload payload = std::make_shared<const std::string>(msg.dump());
+            auto serialized = std::chrono::steady_clock::now();
+
+            BroadcastStats stats = this->fan_out(subscribers, payload, &msg);
+            stats.serialize_time = std::chrono::duration_cast<std::chrono::microseconds>(serialized - begin);
+            this->store_broadcast_stats(stats);
+            return stats;
+        }
+
+        /**
+         * @brief 发布已序列化的消息给订阅了主题的客户端
+         *
+         * @param topic 主题名
+         * @param payload 已序列化的JSON文本, 由调用者保证编码合法
+         * @return BroadcastStats 本次发布的统计信息
+         */
+        BroadcastStats publish_payload(const std::string &topic, const SharedPayload &payload) {
+            auto subscribers = this->topics.subscribers(topic);
+            if (!subscribers)
+                return {};
+            BroadcastStats stats = this->fan_out(subscribers, payload, nullptr);
+            this->store_broadcast_stats(stats);
+            return stats;
+        }
+
+        /**
+         * @brief 设置新连接默认订阅的主题, 只对之后建立的连接生效
+         *
+         * 客户端也可以发送subscribe和unsubscribe命令自行订阅和退订, value为主题名或主题名数组
+         *
+         * @param topics 主题名
+         */
+        void set_default_topics(std::vector<std::string> topics) {
+            std::atomic_store(&this->default_topics, std::make_shared<const std::vector<std::string>>(std::move(topics)));
+        }
+
+        /**
+         * @brief 使用epoll事件循环代替每连接一个线程, 需在start之前调用
+         *
+         * 回调会在事件循环线程上执行, 耗时的回调会拖慢同一循环上的其他连接
+         *
+         * @param loop_count 事件循环线程数, 0表示与CPU核数相同
+         */
+        void set_event_loops(size_t loop_count = 0) {
+            this->server.enableEventLoops(loop_count);
+        }
+
+        /**
+         * @brief 设置客户端发送队列的容量和慢消费者策略, 只对之后建立的连接生效
+         *
+         * @param capacity 每个客户端最多积压的消息数
+         * @param policy 队列满时的处理策略
+         */
+        void set_send_queue_policy(size_t capacity, SlowConsumerPolicy policy) {
+            this->send_queue_capacity = capacity;
+            this->slow_consumer_policy = policy;
+        }
+
+        /**
+         * @brief 设置批量命令的执行方式
+         *
+         * 客户端在一帧中发送命令数组时批量执行, 回复数组与命令一一对应, 命令带id时回复中带回同一个id
+         *
+         * @param execution 执行方式, 默认按顺序执行
+         */
+        void set_batch_execution(BatchExecution execution) {
+            this->batch_execution = execution;
+        }
+
+        /**
+         * @brief 输出发送队列的累计计数
+         *
+         * @return nlohmann::json
+         */
+        nlohmann::json show_send_queue_counters() {
+            return {
+                {"enqueued", this->send_queue_counters->enqueued.load()},
+                {"sent", this->send_queue_counters->sent.load()},
+                {"dropped", this->send_queue_counters->dropped.load()},
+                {"coalesced", this->send_queue_counters->coalesced.load()},
+                {"disconnected", this->send_queue_counters->disconnected.load()},
+            };
+        }
+
+        /**
+         * @brief 输出广播编码的累计计数
+         *
+         * @return nlohmann::json
+         */
+        nlohmann::json show_broadcast_counters() {
+            return {
+                {"broadcasts", this->broadcast_counters.broadcasts.load()},
+                {"encodings", this->broadcast_counters.encodings.load()},
+                {"encodings_avoided", this->broadcast_counters.encodings_avoided.load()},
+                {"shared_bytes", this->broadcast_counters.shared_bytes.load()},
+                {"deflate_saved_bytes", this->broadcast_counters.deflate_saved_bytes.load()},
+                {"encode_cpu_us", this->broadcast_counters.encode_cpu_us.load()},
+            };
+        }
+
+        /**
+         * @brief 输出每个主题的订阅者数
+         *
+         * @return nlohmann::json
+         */
+        nlohmann::json show_topics() {
+            nlohmann::json j = nlohmann::json::object();
+            for (const auto &topic : this->topics.counts())
+                j[topic.first] = topic.second;
+            return j;
+        }
+
+        /**
+         * @brief 获取最近一次广播的统计信息
+         *
+         * @return BroadcastStats
+         */
+        BroadcastStats last_broadcast_stats() {
+            std::lock_guard<std::mutex> lock(this->stats_mutex);
+            return this->broadcast_stats;
         }
 
         /**
          * @brief 注册消息回调函数
          *
+         * 回调表以不可变快照的方式发布, 收消息时查表无需加锁.
+         * 每次注册都重建完美哈希表, 键已存在时保留原来的回调
+         *
          * @param key 回调函数的键
          * @param callback 回调函数
+         * @param concurrency 回调的并发模式, 默认同一回调串行执行
+         */
+        void register_callbacks(std::string key, MessageCallback callback, CallbackConcurrency concurrency = CallbackConcurrency::PerType) {
+            std::lock_guard<std::mutex> lock(this->callback_mutex);
+            auto snapshot = std::atomic_load(&this->callbacks);
+            if (snapshot->find(key))
+                return;
+            auto items = snapshot->items();
+            items.emplace_back(std::move(key), CallbackEntry{std::move(callback), concurrency, std::make_shared<std::mutex>()});
+            std::atomic_store(&this->callbacks, std::shared_ptr<const CallbackTable>(std::make_shared<CallbackTable>(std::move(items))));
+        }
+
+        /**
+         * @brief 注册异步消息回调函数
+         *
+         * 回调在所有连接共享的工作线程池中执行, 连接线程不等待回复就继续处理后续消息,
+         * 同一连接可以有多条命令同时在处理中. 请求带id时回复中带回同一个id, 客户端据此匹配请求和回复.
+         * 批量命令中的异步回调在执行批量命令的线程上调用, 并等待其回复
+         *
+         * @param key 回调函数的键
+         * @param callback 回调函数, 必须且只能调用一次Responder, 未调用时不回复
+         * @param concurrency 回调的并发模式, 只约束回调本身的调用, 不包括之后异步完成的部分
+         */
+        void register_async_callbacks(std::string key, AsyncMessageCallback callback, CallbackConcurrency concurrency = CallbackConcurrency::Reentrant) {
+            std::lock_guard<std::mutex> lock(this->callback_mutex);
+            auto snapshot = std::atomic_load(&this->callbacks);
+            if (snapshot->find(key))
+                return;
+            auto items = snapshot->items();
+            items.emplace_back(std::move(key), CallbackEntry{nullptr, concurrency, std::make_shared<std::mutex>(), std::move(callback)});
+            std::atomic_store(&this->callbacks, std::shared_ptr<const CallbackTable>(std::make_shared<CallbackTable>(std::move(items))));
+        }
+
+        /**
+         * @brief 设置新连接的问候消息, 例如当前状态的关键帧
+         *
+         * 在连接线程上调用, 消息按连接握手时的格式编码, 排在该连接收到的所有广播之前
+         *
+         * @param greeting 生成问候消息, 为空时取消
+         */
+        void set_connection_greeting(GreetingCallback greeting) {
+            std::atomic_store(&this->greeting, greeting ? std::make_shared<const GreetingCallback>(std::move(greeting)) : nullptr);
+        }
+
+        /**
+         * @brief 设置异步回调和并行批量命令使用的工作线程数, 需在start之前调用
+         *
+         * @param thread_count 线程数, 0表示与CPU核数相同
          */
-        void register_callbacks(std::string key, MessageCallback callback) {
-            this->callbacks.insert(std::make_pair(key, callback));
+        void set_worker_threads(size_t thread_count) {
+            this->worker_thread_count = thread_count;
         }
 
         /**
@@ -102,7 +405,15 @@ namespace websocketnp
          * @param key 要注销的回调函数的键
          */
         void unregister_callbacks(std::string key) {
-            this->callbacks.erase(key);
+            std::lock_guard<std::mutex> lock(this->callback_mutex);
+            auto items = std::atomic_load(&this->callbacks)->items();
+            for (auto it = items.begin(); it != items.end(); ++it) {
+                if (it->first == key) {
+                    items.erase(it);
+                    break;
+                }
+            }
+            std::atomic_store(&this->callbacks, std::shared_ptr<const CallbackTable>(std::make_shared<CallbackTable>(std::move(items))));
         }
 
         /**
@@ -112,9 +423,13 @@ namespace websocketnp
          */
         nlohmann::json show_all_connections() {
             nlohmann::json j;
-            std::for_each(this->websockets.begin(), this->websockets.end(), [&j](const std::pair<const std::string, std::pair<std::pair<ix::WebSocket *, std::string>, std::chrono::steady_clock::time_point>> &entry) {
-                j.push_back({{"id", entry.first}, {"url", entry.second.first.second}});
-            });
+            auto snapshot = this->websockets.snapshot();
+            for (const auto &connection : *snapshot) {
+                j.push_back({{"id", std::to_string(connection->id)},
+                             {"url", connection->url},
+                             {"queued", connection->queue->size()},
+                             {"dropped", connection->queue->dropped_count()}});
+            }
             return j;
         }
 
@@ -123,73 +438,168 @@ namespace websocketnp
         }
 
     private:
+        /**
+         * @struct CallbackEntry
+         * @brief 已注册的回调及其并发模式
+         */
+        struct CallbackEntry {
+            MessageCallback callback;               // 回调函数
+            CallbackConcurrency concurrency;        // 并发模式
+            std::shared_ptr<std::mutex> type_mutex; // PerType模式下的回调互斥锁
+            AsyncMessageCallback async_callback;    // 异步回调函数, 不为空时代替callback
+        };
+        using CallbackTable = PerfectHashMap<CallbackEntry>;
+
+        /**
+         * @struct BroadcastCounters
+         * @brief 广播编码的累计计数
+         */
+        struct BroadcastCounters {
+            std::atomic<uint64_t> broadcasts{0};          // 广播次数
+            std::atomic<uint64_t> encodings{0};           // 分组编码次数
+            std::atomic<uint64_t> encodings_avoided{0};   // 因组内共享省去的编码次数
+            std::atomic<uint64_t> shared_bytes{0};        // 组内共享而不必重复编码的帧字节数
+            std::atomic<uint64_t> deflate_saved_bytes{0}; // 压缩帧比原始文本少发送的字节数
+            std::atomic<uint64_t> encode_cpu_us{0};       // 压缩和组帧占用的CPU时间, 微秒
+        };
+
+        static constexpr size_t max_buffered_bytes = 64 * 1024;      // 发送缓冲区超过该值时暂停从队列取消息
+        static constexpr size_t max_reply_buffer_bytes = 256 * 1024; // 回复缓冲区超过该容量时发送后释放
+        static constexpr size_t max_batch_commands = 256;            // 一帧中最多的批量命令数
+        static constexpr size_t max_async_in_flight = 256;           // 每个连接最多同时处理中的异步命令数
+
         ix::WebSocketServer server;                                                                                                  // WebSocket服务器实例
-        std::map<std::string, MessageCallback> callbacks;                                                                           // 消息回调函数映射表
-        std::map<std::string, std::pair<std::pair<ix::WebSocket *, std::string>, std::chrono::steady_clock::time_point>> websockets; // WebSocket连接映射表
-        std::mutex websocket_mutex;                                                                                                  // 保护WebSocket连接映射表的互斥锁
-        std::mutex callback_mutex;                                                                                                   // 回调函数互斥量
+        ConnectionRegistry websockets;                                                                                               // WebSocket连接表
+        TopicRegistry topics;                                                                                                        // 主题订阅表
+        std::mutex callback_mutex;                                                                                                   // 串行化回调表的更新
         std::chrono::seconds timeout_duration;                                                                                       // 超时时间
         std::future<void> timeout_future;                                                                                            // 超时检查的future
         std::atomic<bool> running;                                                                                                   // 用于控制超时检查的运行
+        std::mutex timeout_mutex;                                                                                                    // 超时检查等待用的互斥锁
+        std::condition_variable timeout_cv;                                                                                          // 用于停止时立即唤醒超时检查
+        TimerWheel timeout_wheel;                                                                                                    // 空闲超时时间轮
+        std::mutex stats_mutex;                                                                                                      // 保护广播统计的互斥锁
+        BroadcastStats broadcast_stats;                                                                                              // 最近一次广播的统计
+        BroadcastCounters broadcast_counters;                                                                                        // 广播编码累计计数
+        std::atomic<size_t> send_queue_capacity;                                                                                     // 客户端发送队列容量
+        std::atomic<SlowConsumerPolicy> slow_consumer_policy;                                                                        // 慢消费者处理策略
+        std::shared_ptr<SendQueueCounters> send_queue_counters;                                                                      // 发送队列累计计数
+        std::shared_ptr<const CallbackTable> callbacks;                                                                              // 消息回调函数表快照
+        std::atomic<BatchExecution> batch_execution;                                                                                 // 批量命令的执行方式
+        size_t worker_thread_count;                                                                                                  // 工作线程数
+        std::unique_ptr<WorkerPool> workers;                                                                                         // 异步回调和并行批量命令的工作线程池, 在start和stop之间有效
+        std::shared_ptr<const GreetingCallback> greeting;                                                                            // 新连接的问候消息
+        std::shared_ptr<const std::vector<std::string>> default_topics;                                                              // 新连接默认订阅的主题
 
         /**
          * @brief 处理接收消息
          *
          * @param connection_state
+         * @param weak_websocket 供连接表持有的弱引用
          * @param websocket
          * @param msg
          */
-        void handle_message(std::shared_ptr<ix::ConnectionState> connection_state, ix::WebSocket &websocket, const ix::WebSocketMessagePtr &msg) {
+        void handle_message(const std::shared_ptr<ix::ConnectionState> &connection_state, const std::weak_ptr<ix::WebSocket> &weak_websocket, ix::WebSocket &websocket, const ix::WebSocketMessagePtr &msg) {
+            auto client_state = std::static_pointer_cast<ClientState>(connection_state);
             switch (msg->type) {
             case ix::WebSocketMessageType::Message: {
+                // 请求, 回调的返回值和错误回复都从连接的内存池分配, 处理完这条消息后整体回收
+                MessageArena::Scope arena_scope(client_state->arena);
                 try {
-                    auto json_msg = nlohmann::json::parse(msg->str);
-                    if (!json_msg.contains("value") || !json_msg.contains("type")) {
-                        nlohmann::json ret = {{"error", "Wrong JSON format"}};
-                        websocket.send(ret.dump());
-                        this->update_last_active_time(connection_state->getId());
-                        return;
-                    }
-                    std::string parse_type = json_msg.value("type", "");
-                    if (parse_type == "ping") {
-                        nlohmann::json ret = {{"type", "pong"}};
-                        websocket.send(ret.dump());
-                        this->update_last_active_time(connection_state->getId());
-                        return;
-                    }
-                    if (this->callbacks.find(parse_type) != this->callbacks.end()) {
-                        {
-                            std::lock_guard<std::mutex> lock(this->callback_mutex);
-                            auto ret = this->callbacks[parse_type](json_msg["value"]);
-                            websocket.send(ret.dump());
+                    MessageFormat format = this->incoming_format(*client_state, msg);
+                    // JSON命令只扫描顶层的type和value, value留到找到回调后再解析.
+                    // 缺少字段, 没有对应的命令, 或者value和id解析失败时退回完整解析, 报错与完整解析一致
+                    CommandEnvelope envelope;
+                    if (format == MessageFormat::Json && scan_command(msg->view, envelope) && envelope.has_type && envelope.has_value &&
+                        this->is_known_command(envelope.type) && (!envelope.has_id || nlohmann::json::accept(envelope.id.begin(), envelope.id.end()))) {
+                        // 解析value前置位, 解析成功后清除, 回调本身抛出的解析错误不会被当作消息写错
+                        bool malformed = false;
+                        try {
+                            bool submitted = this->submit_async(
+                                client_state, weak_websocket, format, envelope.type,
+                                [&envelope, &malformed]() {
+                                    malformed = true;
+                                    auto value = nlohmann::json::parse(envelope.value.begin(), envelope.value.end());
+                                    malformed = false;
+                                    return value;
+                                },
+                                [&envelope]() { return envelope.has_id ? std::optional<nlohmann::json>(nlohmann::json::parse(envelope.id.begin(), envelope.id.end())) : std::nullopt; });
+                            if (!submitted) {
+                                this->reply(websocket, *client_state, this->execute(*client_state, envelope.type, [&envelope, &malformed]() {
+                                    malformed = true;
+                                    auto value = MessageJson::parse(envelope.value.begin(), envelope.value.end());
+                                    malformed = false;
+                                    return value;
+                                }));
+                            }
+                            this->update_last_active_time(*client_state);
+                            return;
+                        } catch (const nlohmann::json::parse_error &) {
+                            if (!malformed)
+                                throw;
                         }
-                    } else {
-                        logf_warn("%s.\n", parse_type.c_str());
-                        nlohmann::json ret = {{"error", "Unknown type: " + parse_type}};
-                        websocket.send(ret.dump());
                     }
 
-                    this->update_last_active_time(connection_state->getId());
+                    auto json_msg = decode_message<MessageJson>(format, msg->view);
+                    // 命令数组在一帧内批量执行, 所有回复合并成一帧
+                    if (json_msg.is_array()) {
+                        this->reply(websocket, *client_state, this->execute_batch(*client_state, json_msg));
+                    } else if (!json_msg.contains("value") || !json_msg.contains("type") ||
+                               !this->submit_async(
+                                   client_state, weak_websocket, format, json_msg.value("type", ""),
+                                   [&json_msg]() { return nlohmann::json(json_msg["value"]); },
+                                   [&json_msg]() { return json_msg.contains("id") ? std::optional<nlohmann::json>(json_msg["id"]) : std::nullopt; })) {
+                        this->reply(websocket, *client_state, this->execute(*client_state, json_msg));
+                    }
+                    this->update_last_active_time(*client_state);
                 } catch (const std::exception &e) {
-                    nlohmann::json ret = {{"error", e.what()}};
-                    websocket.send(ret.dump());
-                    logf_warn("Invalid JSON message: %s\n", e.what());
+                    this->reply(websocket, *client_state, {{"error", e.what()}});
+                    logf_warn("Invalid message: %s\n", e.what());
                 }
                 break;
             }
             case ix::WebSocketMessageType::Open: {
                 {
-                    std::lock_guard<std::mutex> lock(this->websocket_mutex);
-                    this->websockets[connection_state->getId()] = {{&websocket, connection_state->getRemoteIp() + ":" + std::to_string(connection_state->getRemotePort())}, std::chrono::steady_clock::now()};
+                    // 握手选中了子协议时按其确定格式, 否则默认JSON, 由收到的第一帧再决定
+                    MessageFormat format = MessageFormat::Json;
+                    if (parse_subprotocol(msg->openInfo.protocol, format))
+                        client_state->format_decided = true;
+                    auto queue = std::make_shared<SendQueue>(this->send_queue_capacity.load(), this->slow_consumer_policy.load(), this->send_queue_counters);
+                    // 在连接线程自己的poll循环中发送积压的广播消息
+                    // 事件循环模式下发送不阻塞, 内核缓冲区写满后留在队列中, 由可写事件继续发送
+                    websocket.setOnPollCallback([queue, &websocket]() {
+                        queue->drain([&websocket]() { return websocket.bufferedAmount() < max_buffered_bytes; },
+                                     [&websocket](const SharedMessage &message) {
+                                         // 以共享引用入队, 同一条广播不会复制到每个客户端的发送缓冲区
+                                         if (message.frames)
+                                             return websocket.sendEncodedFrames(message.frames, message.window_bits).success;
+                                         if (message.binary)
+                                             return websocket.sendBinary(ix::IXWebSocketSendData(message.payload)).success;
+                                         // nlohmann::json::dump 输出的一定是合法UTF-8, 无需重复校验
+                                         return websocket.sendUtf8Text(ix::IXWebSocketSendData(message.payload)).success;
+                                     });
+                    });
+                    client_state->connection = std::make_shared<Connection>(client_state->get_numeric_id(),
+                                                                             weak_websocket,
+                                                                             connection_state->getRemoteIp() + ":" + std::to_string(connection_state->getRemotePort()),
+                                                                             queue,
+                                                                             broadcast_encoding(websocket),
+                                                                             format);
+                    // 在登记到连接表之前入队, 问候消息一定排在所有广播之前
+                    this->queue_greeting(websocket, *queue, format);
+                    for (const auto &topic : *std::atomic_load(&this->default_topics))
+                        this->topics.subscribe(client_state->connection, topic);
+                    this->websockets.insert(client_state->connection);
+                    if (this->timeout_duration.count() > 0)
+                        this->timeout_wheel.schedule(client_state->connection);
                 }
                 logf_info("%s:%d %s connected.\n", connection_state->getRemoteIp().c_str(), connection_state->getRemotePort(), connection_state->getId().c_str());
                 break;
             }
             case ix::WebSocketMessageType::Close: {
-                {
-                    std::lock_guard<std::mutex> lock(this->websocket_mutex);
-                    this->websockets.erase(connection_state->getId());
-                }
+                this->topics.remove(client_state->get_numeric_id());
+                this->websockets.erase(client_state->get_numeric_id());
+                client_state->connection.reset();
                 logf_info("%s:%d %s disconnected.\n", connection_state->getRemoteIp().c_str(), connection_state->getRemotePort(), connection_state->getId().c_str());
                 break;
             }
@@ -199,36 +609,589 @@ namespace websocketnp
         }
 
         /**
-         * @brief 更新活跃时间
+         * @brief 按回调的并发模式调用回调
          *
-         * @param id
+         * @param entry 回调
+         * @param client_state 连接状态
+         * @param value 请求内容
+         * @return MessageJson 回调的返回值
          */
-        void update_last_active_time(const std::string &id) {
-            std::lock_guard<std::mutex> lock(this->websocket_mutex);
-            if (this->websockets.find(id) != this->websockets.end()) {
-                this->websockets[id].second = std::chrono::steady_clock::now();
+        MessageJson invoke_callback(const CallbackEntry &entry, ClientState &client_state, const MessageJson &value) {
+            switch (entry.concurrency) {
+            case CallbackConcurrency::PerType: {
+                std::lock_guard<std::mutex> lock(*entry.type_mutex);
+                return entry.callback(value);
+            }
+            case CallbackConcurrency::PerConnection: {
+                std::lock_guard<std::mutex> lock(client_state.callback_mutex);
+                return entry.callback(value);
+            }
+            case CallbackConcurrency::Reentrant:
+            default:
+                return entry.callback(value);
             }
         }
 
+        /**
+         * @brief 将共享消息放入一组客户端的发送队列
+         *
+         * @param snapshot 接收消息的连接快照
+         * @param payload 已序列化的JSON文本
+         * @param object 消息对象, 为nullptr时按需从payload解析
+         * @return BroadcastStats 不含JSON序列化耗时的统计信息, 其他格式的序列化计入encode_time
+         */
+        BroadcastStats fan_out(const ConnectionRegistry::Snapshot &snapshot, const SharedPayload &payload, const nlohmann::json *object) {
+            BroadcastStats stats;
+            if (!payload)
+                return stats;
+
+            auto begin = std::chrono::steady_clock::now();
+
+            // 按消息格式和协商参数分组, 每组只编码一次
+            // 先记下每个连接的分组, 分组之后连接的格式可能被第一帧修改
+            using GroupKey = std::pair<MessageFormat, uint8_t>;
+            std::vector<GroupKey> keys;
+            keys.reserve(snapshot->size());
+            std::map<GroupKey, size_t> group_sizes;
+            for (const auto &connection : *snapshot) {
+                keys.emplace_back(connection->format(), connection->encoding);
+                ++group_sizes[keys.back()];
+            }
+
+            auto cpu_begin = thread_cpu_time();
+            std::map<MessageFormat, SharedPayload> payloads{{MessageFormat::Json, payload}};
+            nlohmann::json parsed;
+            auto serialize = [&](MessageFormat format) -> SharedPayload {
+                auto it = payloads.find(format);
+                if (it != payloads.end())
+                    return it->second;
+                try {
+                    if (!object) {
+                        parsed = nlohmann::json::parse(*payload);
+                        object = &parsed;
+                    }
+                    return payloads[format] = std::make_shared<const std::string>(encode_message(format, *object));
+                } catch (const std::exception &e) {
+                    logf_warn("Cannot convert broadcast to %s: %s\n", subprotocol_name(format), e.what());
+                    return payloads[format] = nullptr;
+                }
+            };
+
+            std::map<GroupKey, SharedMessagePtr> groups;
+            size_t encodings_avoided = 0;
+            for (const auto &group : group_sizes) {
+                // 无法转换时退回原始的JSON文本
+                bool binary = is_binary_format(group.first.first);
+                SharedPayload data = serialize(group.first.first);
+                if (!data) {
+                    data = payload;
+                    binary = false;
+                }
+                SharedMessagePtr message = encode(data, binary, group.first.second);
+                if (message->frames) {
+                    ++stats.encodings;
+                    encodings_avoided += group.second - 1;
+                    stats.shared_bytes += message->frames->size() * (group.second - 1);
+                    if (message->window_bits != 0 && message->frames->size() < data->size())
+                        stats.deflate_saved_bytes += (data->size() - message->frames->size()) * group.second;
+                }
+                groups.emplace(group.first, std::move(message));
+            }
+            stats.encode_time = std::chrono::duration_cast<std::chrono::microseconds>(thread_cpu_time() - cpu_begin);
+
+            for (size_t i = 0; i < snapshot->size(); ++i) {
+                const auto &connection = (*snapshot)[i];
+                switch (connection->queue->push(groups[keys[i]])) {
+                case SendQueue::PushResult::Wakeup:
+                    if (auto websocket = connection->websocket.lock())
+                        websocket->wakeUp();
+                    ++stats.clients;
+                    break;
+                case SendQueue::PushResult::Queued:
+                    ++stats.clients;
+                    break;
+                case SendQueue::PushResult::Overflow:
+                    logf_warn("Closing connection: %s %llu due to send queue overflow\n", connection->url.c_str(), static_cast<unsigned long long>(connection->id));
+                    if (auto websocket = connection->websocket.lock())
+                        websocket->close();
+                    ++stats.overflowed;
+                    break;
+                case SendQueue::PushResult::Rejected:
+                    break;
+                }
+            }
+            stats.bytes = payload->size();
+
+            ++this->broadcast_counters.broadcasts;
+            this->broadcast_counters.encodings += stats.encodings;
+            this->broadcast_counters.encodings_avoided += encodings_avoided;
+            this->broadcast_counters.shared_bytes += stats.shared_bytes;
+            this->broadcast_counters.deflate_saved_bytes += stats.deflate_saved_bytes;
+            this->broadcast_counters.encode_cpu_us += stats.encode_time.count();
+            stats.send_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin);
+            return stats;
+        }
+
+        /**
+         * @brief 根据握手协商的压缩参数确定连接的广播编码分组
+         *
+         * @param websocket 已完成握手的连接
+         * @return uint8_t 见Connection::encoding
+         */
+        static uint8_t broadcast_encoding(const ix::WebSocket &websocket) {
+            auto options = websocket.getNegotiatedPerMessageDeflateOptions();
+            if (!options.enabled())
+                return Connection::plain_frames;
+            uint8_t window_bits = options.getServerMaxWindowBits();
+            return websocket.canSendPrecompressed(window_bits) ? window_bits : Connection::own_deflate;
+        }
+
+        /**
+         * @brief 按编码分组压缩并组帧
+         *
+         * 服务端发出的帧不加掩码, 帧内容只取决于消息和压缩参数, 同组的客户端可以共享
+         *
+         * @param payload 序列化后的消息
+         * @param binary 是否以二进制帧发送
+         * @param encoding 编码分组
+         * @return SharedMessagePtr 压缩失败时退回未压缩的帧
+         */
+        static SharedMessagePtr encode(const SharedPayload &payload, bool binary, uint8_t encoding) {
+            auto message = std::make_shared<SharedMessage>();
+            message->payload = payload;
+            message->binary = binary;
+            if (encoding == Connection::own_deflate)
+                return message;
+
+            if (encoding != Connection::plain_frames) {
+                ix::WebSocketPerMessageDeflateCompressor compressor;
+                std::string deflated;
+                if (compressor.init(encoding, true) && compressor.compress(*payload, deflated)) {
+                    message->frames = std::make_shared<const std::string>(ix::WebSocket::encodeFrames(ix::IXWebSocketSendData(deflated), binary, true));
+                    message->window_bits = encoding;
+                    return message;
+                }
+            }
+            message->frames = std::make_shared<const std::string>(ix::WebSocket::encodeFrames(ix::IXWebSocketSendData(*payload), binary, false));
+            return message;
+        }
+
+        /**
+         * @brief 当前线程占用的CPU时间
+         *
+         * @return std::chrono::microseconds
+         */
+        static std::chrono::microseconds thread_cpu_time() {
+            timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return std::chrono::seconds(ts.tv_sec) + std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(ts.tv_nsec));
+        }
+
+        /**
+         * @brief 记录广播统计信息
+         *
+         * @param stats
+         */
+        void store_broadcast_stats(const BroadcastStats &stats) {
+            std::lock_guard<std::mutex> lock(this->stats_mutex);
+            this->broadcast_stats = stats;
+            logf_debug("broadcast %zu bytes to %zu clients in %zu encodings, serialize %lld us, encode %lld us cpu, send %lld us\n", stats.bytes, stats.clients, stats.encodings,
+                       static_cast<long long>(stats.serialize_time.count()), static_cast<long long>(stats.encode_time.count()), static_cast<long long>(stats.send_time.count()));
+        }
+
+        /**
+         * @brief 将问候消息放入新连接的发送队列
+         *
+         * @param websocket 新连接
+         * @param queue 新连接的发送队列
+         * @param format 新连接的消息格式
+         */
+        void queue_greeting(ix::WebSocket &websocket, SendQueue &queue, MessageFormat format) {
+            auto greeting = std::atomic_load(&this->greeting);
+            if (!greeting)
+                return;
+            try {
+                nlohmann::json hello = (*greeting)();
+                if (hello.is_null())
+                    return;
+                auto message = std::make_shared<SharedMessage>();
+                message->payload = std::make_shared<const std::string>(encode_message(format, hello));
+                message->binary = is_binary_format(format);
+                if (queue.push(std::move(message)) == SendQueue::PushResult::Wakeup)
+                    websocket.wakeUp();
+            } catch (const std::exception &e) {
+                logf_warn("Connection greeting failed: %s\n", e.what());
+            }
+        }
+
+        /**
+         * @brief 按type查找并调用回调
+         *
+         * @tparam ValueLoader 返回value的可调用对象, 只在找到回调时调用
+         * @param client_state 连接状态
+         * @param type 命令类型
+         * @param load_value 取得value
+         * @return MessageJson 回复内容
+         */
+        template <typename ValueLoader>
+        MessageJson execute(ClientState &client_state, std::string_view type, ValueLoader &&load_value) {
+            if (type == "ping")
+                return {{"type", "pong"}};
+            if (type == "subscribe" || type == "unsubscribe")
+                return this->update_subscriptions(client_state, type == "subscribe", load_value());
+            if (const CallbackEntry *entry = std::atomic_load(&this->callbacks)->find(type)) {
+                if (entry->async_callback)
+                    return this->invoke_async_and_wait(*entry, client_state, load_value());
+                return this->invoke_callback(*entry, client_state, load_value());
+            }
+            std::string parse_type(type);
+            logf_warn("%s.\n", parse_type.c_str());
+            return {{"error", "Unknown type: " + parse_type}};
+        }
+
+        /**
+         * @brief type是否有对应的命令, 内置命令或已注册的回调
+         *
+         * @param type 命令类型
+         * @return bool
+         */
+        bool is_known_command(std::string_view type) const {
+            return type == "ping" || type == "subscribe" || type == "unsubscribe" || std::atomic_load(&this->callbacks)->find(type);
+        }
+
+        /**
+         * @brief 处理subscribe和unsubscribe命令
+         *
+         * @param client_state 连接状态
+         * @param subscribe true为订阅, false为退订
+         * @param value 主题名或主题名数组
+         * @return MessageJson 回复中带有连接当前订阅的所有主题
+         */
+        MessageJson update_subscriptions(ClientState &client_state, bool subscribe, const MessageJson &value) {
+            const char *ret_type = subscribe ? "subscribeRet" : "unsubscribeRet";
+            if (!client_state.connection)
+                return {{"error", "Connection closed"}};
+            if (!value.is_string() && !value.is_array())
+                return {{"error", "Topic must be a string or an array of strings"}};
+            const MessageJson names = value.is_string() ? MessageJson::array({value}) : value;
+            for (const auto &name : names) {
+                if (!name.is_string() || name.get_ref<const std::string &>().empty() || name.get_ref<const std::string &>().size() > TopicRegistry::max_topic_length)
+                    return {{"error", "Invalid topic name"}};
+            }
+            for (const auto &name : names) {
+                const std::string &topic = name.get_ref<const std::string &>();
+                if (!subscribe)
+                    this->topics.unsubscribe(client_state.connection->id, topic);
+                else if (!this->topics.subscribe(client_state.connection, topic))
+                    return {{"error", "Too many topics"}};
+            }
+            MessageJson joined = MessageJson::array();
+            for (const auto &topic : this->topics.topics_of(client_state.connection->id))
+                joined.push_back(topic);
+            return {{"type", ret_type}, {"value", std::move(joined)}};
+        }
+
+        /**
+         * @brief 执行已解析的命令
+         *
+         * @param client_state 连接状态
+         * @param command 含type和value的命令
+         * @return MessageJson 回复内容
+         */
+        MessageJson execute(ClientState &client_state, const MessageJson &command) {
+            if (!command.contains("value") || !command.contains("type"))
+                return {{"error", "Wrong JSON format"}};
+            std::string parse_type = command.value("type", "");
+            return this->execute(client_state, parse_type, [&command]() -> const MessageJson & {
+                return command["value"];
+            });
+        }
+
+        /**
+         * @brief 在回复中带回请求的id, 回复不是对象时放在value中
+         *
+         * @tparam Json 回复的JSON类型
+         * @tparam Id id的JSON类型
+         * @param ret 回复
+         * @param id 请求的id
+         */
+        template <typename Json, typename Id>
+        static void attach_id(Json &ret, const Id &id) {
+            if (!ret.is_object())
+                ret = {{"value", std::move(ret)}};
+            ret["id"] = id;
+        }
+
+        /**
+         * @struct AsyncReply
+         * @brief 一条异步命令的回复状态, 由Responder的所有副本共享
+         *
+         * 不持有服务器, 回调保存Responder到服务器停止之后再调用也是安全的.
+         * 所有副本销毁时仍未回复则释放该连接的在途名额
+         */
+        struct AsyncReply {
+            std::shared_ptr<ClientState> client_state; // 请求所属的连接
+            std::weak_ptr<ix::WebSocket> websocket;    // 回复发往的连接
+            std::optional<nlohmann::json> id;          // 请求的id
+            MessageFormat format;                      // 提交时连接的消息格式
+            std::atomic<bool> done{false};             // 已回复
+
+            ~AsyncReply() {
+                if (!this->done)
+                    --this->client_state->async_in_flight;
+            }
+
+            /**
+             * @brief 发送回复, 只有第一次调用有效
+             *
+             * @param ret 回复内容
+             */
+            void respond(nlohmann::json ret) {
+                if (this->done.exchange(true)) {
+                    logf_warn("Ignoring duplicate async reply\n");
+                    return;
+                }
+                --this->client_state->async_in_flight;
+                auto websocket = this->websocket.lock();
+                if (!websocket)
+                    return;
+                if (this->id)
+                    attach_id(ret, *this->id);
+                // IX的发送可在任意线程调用, 这里不能使用连接线程专用的回复缓冲区
+                websocket->send(encode_message(this->format, ret), is_binary_format(this->format));
+            }
+        };
+
+        /**
+         * @brief 命令对应异步回调时提交到工作线程池
+         *
+         * @tparam ValueLoader 返回nlohmann::json的value
+         * @tparam IdLoader 返回std::optional<nlohmann::json>的id
+         * @param client_state 连接状态
+         * @param weak_websocket 回复发往的连接
+         * @param format 连接的消息格式
+         * @param type 命令类型
+         * @param load_value 取得value, 复制到堆上以便在消息处理之后使用
+         * @param load_id 取得id
+         * @return bool 不是异步回调时返回false, 由调用者同步执行
+         */
+        template <typename ValueLoader, typename IdLoader>
+        bool submit_async(const std::shared_ptr<ClientState> &client_state, const std::weak_ptr<ix::WebSocket> &weak_websocket, MessageFormat format, std::string_view type,
+                          ValueLoader &&load_value, IdLoader &&load_id) {
+            auto snapshot = std::atomic_load(&this->callbacks);
+            const CallbackEntry *entry = snapshot->find(type);
+            if (!entry || !entry->async_callback)
+                return false;
+
+            nlohmann::json value = load_value();
+            auto reply = std::make_shared<AsyncReply>();
+            reply->client_state = client_state;
+            reply->websocket = weak_websocket;
+            reply->id = load_id();
+            reply->format = format;
+            if (++client_state->async_in_flight > max_async_in_flight) {
+                reply->respond({{"error", "Too many requests in flight"}});
+                return true;
+            }
+
+            // 任务持有回调表快照, 回调在执行期间被注销也不会失效
+            bool posted = this->workers->post([this, snapshot, entry, client_state, value = std::move(value), reply]() {
+                try {
+                    this->invoke_async(*entry, *client_state, value, [reply](nlohmann::json ret) { reply->respond(std::move(ret)); });
+                } catch (const std::exception &e) {
+                    reply->respond({{"error", e.what()}});
+                }
+            });
+            if (!posted)
+                reply->respond({{"error", "Server is stopping"}});
+            return true;
+        }
+
+        /**
+         * @brief 按回调的并发模式调用异步回调
+         *
+         * @param entry 回调
+         * @param client_state 连接状态
+         * @param value 请求内容
+         * @param respond 完成函数
+         */
+        void invoke_async(const CallbackEntry &entry, ClientState &client_state, const nlohmann::json &value, Responder respond) {
+            switch (entry.concurrency) {
+            case CallbackConcurrency::PerType: {
+                std::lock_guard<std::mutex> lock(*entry.type_mutex);
+                entry.async_callback(value, std::move(respond));
+                break;
+            }
+            case CallbackConcurrency::PerConnection: {
+                std::lock_guard<std::mutex> lock(client_state.callback_mutex);
+                entry.async_callback(value, std::move(respond));
+                break;
+            }
+            case CallbackConcurrency::Reentrant:
+            default:
+                entry.async_callback(value, std::move(respond));
+                break;
+            }
+        }
+
+        /**
+         * @brief 在当前线程调用异步回调并等待回复, 用于批量命令
+         *
+         * @param entry 回调
+         * @param client_state 连接状态
+         * @param value 请求内容
+         * @return MessageJson 回复内容, 回调未调用Responder时返回错误
+         */
+        MessageJson invoke_async_and_wait(const CallbackEntry &entry, ClientState &client_state, const nlohmann::json &value) {
+            struct Waiter {
+                std::promise<nlohmann::json> promise; // 回复
+                std::atomic<bool> done{false};        // 已回复
+
+                ~Waiter() {
+                    if (!this->done)
+                        this->promise.set_value({{"error", "No reply"}});
+                }
+            };
+            auto waiter = std::make_shared<Waiter>();
+            auto result = waiter->promise.get_future();
+            this->invoke_async(entry, client_state, value, [waiter](nlohmann::json ret) {
+                if (!waiter->done.exchange(true))
+                    waiter->promise.set_value(std::move(ret));
+            });
+            waiter.reset();
+            return result.get();
+        }
+
+        /**
+         * @brief 执行批量命令中的一条, 错误只作为这一条的回复
+         *
+         * 命令带id时回复中原样带回, 回复不是对象时放在value中
+         *
+         * @param client_state 连接状态
+         * @param command 命令
+         * @return MessageJson 回复内容
+         */
+        MessageJson execute_batch_item(ClientState &client_state, const MessageJson &command) {
+            MessageJson ret;
+            try {
+                ret = this->execute(client_state, command);
+            } catch (const std::exception &e) {
+                ret = {{"error", e.what()}};
+            }
+            if (command.is_object() && command.contains("id"))
+                attach_id(ret, command["id"]);
+            return ret;
+        }
+
+        /**
+         * @brief 执行批量命令
+         *
+         * 并行模式下第一条在连接线程上执行, 其余提交到工作线程池.
+         * 工作线程中没有连接的内存池, 回复从堆分配
+         *
+         * @param client_state 连接状态
+         * @param commands 命令数组
+         * @return MessageJson 与命令顺序一致的回复数组
+         */
+        MessageJson execute_batch(ClientState &client_state, const MessageJson &commands) {
+            if (commands.size() > max_batch_commands)
+                return {{"error", "Too many commands in batch: " + std::to_string(commands.size())}};
+
+            MessageJson responses = MessageJson::array();
+            if (this->batch_execution.load() == BatchExecution::Parallel && commands.size() > 1) {
+                std::vector<std::future<MessageJson>> pending;
+                pending.reserve(commands.size() - 1);
+                for (size_t i = 1; i < commands.size(); ++i) {
+                    pending.push_back(this->workers->submit([this, &client_state, &commands, i]() {
+                        return this->execute_batch_item(client_state, commands[i]);
+                    }));
+                }
+                responses.push_back(this->execute_batch_item(client_state, commands[0]));
+                for (auto &result : pending)
+                    responses.push_back(result.get());
+            } else {
+                for (const auto &command : commands)
+                    responses.push_back(this->execute_batch_item(client_state, command));
+            }
+            return responses;
+        }
+
+        /**
+         * @brief 确定收到的消息使用的格式
+         *
+         * 文本帧总是JSON. 二进制帧优先使用连接的格式, 连接还是JSON时按内容识别.
+         * 握手未协商子协议时, 第一个能识别格式的帧决定该连接之后回复和广播的格式
+         *
+         * @param client_state 连接状态
+         * @param msg 收到的消息
+         * @return MessageFormat
+         */
+        MessageFormat incoming_format(ClientState &client_state, const ix::WebSocketMessagePtr &msg) {
+            MessageFormat format = MessageFormat::Json;
+            if (msg->binary) {
+                if (client_state.connection)
+                    format = client_state.connection->format();
+                if (!is_binary_format(format) && !detect_binary_format(msg->view, format)) {
+                    // 无法识别的帧按MessagePack回复解析错误, 不锁定格式
+                    return MessageFormat::MessagePack;
+                }
+            }
+            if (!client_state.format_decided && client_state.connection) {
+                client_state.connection->set_format(format);
+                client_state.format_decided = true;
+            }
+            return format;
+        }
+
+        /**
+         * @brief 按连接的格式回复消息
+         *
+         * 序列化到连接复用的缓冲区, 发送时复制到发送缓冲区
+         *
+         * @param websocket
+         * @param client_state 连接状态
+         * @param ret 回复内容
+         */
+        void reply(ix::WebSocket &websocket, ClientState &client_state, const MessageJson &ret) {
+            MessageFormat format = client_state.connection ? client_state.connection->format() : MessageFormat::Json;
+            encode_message(format, ret, client_state.reply_buffer);
+            websocket.send(client_state.reply_buffer, is_binary_format(format));
+            // 偶尔的大回复之后不长期占用内存
+            if (client_state.reply_buffer.capacity() > max_reply_buffer_bytes)
+                std::string().swap(client_state.reply_buffer);
+        }
+
+        /**
+         * @brief 更新活跃时间
+         *
+         * @param client_state
+         */
+        void update_last_active_time(ClientState &client_state) {
+            if (client_state.connection)
+                client_state.connection->touch();
+        }
+
         /**
          * @brief 超时检测
          *
+         * 每个时间轮刻度醒来一次, 只处理到期的槽位
          */
         void check_timeouts() {
+            std::unique_lock<std::mutex> lock(this->timeout_mutex);
             while (running) {
-                std::this_thread::sleep_for(std::chrono::seconds(2));
-
-                auto now = std::chrono::steady_clock::now();
-                std::lock_guard<std::mutex> lock(this->websocket_mutex);
-                for (auto it = this->websockets.begin(); it != this->websockets.end();) {
-                    if (now - it->second.second > timeout_duration) {
-                        logf_info("Closing connection: %s %s due to timeout\n", it->second.first.second.c_str(), it->first.c_str());
-                        it->second.first.first->close();
-                        it = this->websockets.erase(it);
-                    } else {
-                        ++it;
-                    }
+                this->timeout_cv.wait_for(lock, this->timeout_wheel.tick_interval(), [this]() { return !this->running; });
+                if (!running)
+                    break;
+
+                lock.unlock();
+                for (const auto &connection : this->timeout_wheel.advance(std::chrono::steady_clock::now())) {
+                    logf_info("Closing connection: %s %llu due to timeout\n", connection->url.c_str(), static_cast<unsigned long long>(connection->id));
+                    if (auto websocket = connection->websocket.lock())
+                        websocket->close();
+                    this->topics.remove(connection->id);
+                    this->websockets.erase(connection->id);
                 }
+                lock.lock();
             }
         }
     };
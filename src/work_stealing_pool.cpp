@@ -0,0 +1,247 @@
+/**
+ * @file work_stealing_pool.cpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Implementation of the WorkStealingPool class.
+ *
+ * This file contains the implementation of the WorkStealingPool class, a task queue for httplib::Server with per-worker queues,
+ * work stealing, bounded admission and a worker count following the load.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <work_stealing_pool.hpp>
+#include <log.h>
+#include <algorithm>
+
+using namespace httpservernp;
+
+TaskQueueStats TaskQueueMetrics::snapshot() const {
+    TaskQueueStats stats;
+    stats.threads = this->threads.load();
+    stats.idle_threads = this->idle_threads.load();
+    stats.queued = this->queued.load();
+    stats.executed = this->executed.load();
+    stats.rejected = this->rejected.load();
+    stats.stolen = this->stolen.load();
+    stats.wait_ns_total = this->wait_ns_total.load();
+    stats.wait_ns_max = this->wait_ns_max.load();
+    return stats;
+}
+
+WorkStealingPool::TaskRing::TaskRing(size_t capacity) : cells(new Cell[capacity]),
+                                                        mask(capacity - 1),
+                                                        tail(0),
+                                                        head(0) {
+    for (size_t i = 0; i < capacity; ++i)
+        this->cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool WorkStealingPool::TaskRing::push(Task &task) {
+    size_t position = this->tail.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &this->cells[position & this->mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (lap == 0) {
+            if (this->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (lap < 0) {
+            // the cell still holds the task of the previous lap
+            return false;
+        } else {
+            position = this->tail.load(std::memory_order_relaxed);
+        }
+    }
+    cell->task = std::move(task);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool WorkStealingPool::TaskRing::pop(Task &task) {
+    size_t position = this->head.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &this->cells[position & this->mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto lap = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+        if (lap == 0) {
+            if (this->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (lap < 0) {
+            return false;
+        } else {
+            position = this->head.load(std::memory_order_relaxed);
+        }
+    }
+    task = std::move(cell->task);
+    // drop what the moved-from function may still capture before the cell is reused
+    cell->task.fn = nullptr;
+    cell->sequence.store(position + this->mask + 1, std::memory_order_release);
+    return true;
+}
+
+WorkStealingPool::WorkStealingPool(const Options &options, std::shared_ptr<TaskQueueMetrics> metrics) : options(options),
+                                                                                                       metrics(metrics ? std::move(metrics) : std::make_shared<TaskQueueMetrics>()) {
+    this->options.min_threads = std::max<size_t>(this->options.min_threads, 1);
+    this->options.max_threads = std::max(this->options.max_threads, this->options.min_threads);
+    this->options.max_queued = std::max<size_t>(this->options.max_queued, 1);
+    // Room for twice a fair share in every queue, a push falls over to the next queue when one is full
+    size_t capacity = 16;
+    while (capacity < 2 * this->options.max_queued / this->options.max_threads)
+        capacity <<= 1;
+    for (size_t i = 0; i < this->options.max_threads; ++i)
+        this->workers.push_back(std::make_unique<Worker>(capacity));
+
+    std::lock_guard<std::mutex> lock(this->resize_mutex);
+    for (size_t i = 0; i < this->options.min_threads; ++i) {
+        this->workers[i]->running = true;
+        ++this->metrics->threads;
+        this->workers[i]->thread = std::thread(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    this->shutdown();
+}
+
+bool WorkStealingPool::enqueue(std::function<void()> fn) {
+    if (this->stopping.load())
+        return false;
+    if (this->metrics->queued.fetch_add(1) >= this->options.max_queued) {
+        --this->metrics->queued;
+        ++this->metrics->rejected;
+        return false;
+    }
+
+    Task task{std::move(fn), std::chrono::steady_clock::now()};
+    const size_t count = this->workers.size();
+    const size_t start = this->next_worker.fetch_add(1, std::memory_order_relaxed);
+    bool pushed = false;
+    // Queues of exited workers are still stolen from, they only take the tasks the live queues have no room for
+    for (int pass = 0; pass < 2 && !pushed; ++pass) {
+        for (size_t i = 0; i < count && !pushed; ++i) {
+            Worker &worker = *this->workers[(start + i) % count];
+            if (pass == 1 || worker.running.load(std::memory_order_relaxed))
+                pushed = worker.tasks.push(task);
+        }
+    }
+    if (!pushed) {
+        --this->metrics->queued;
+        ++this->metrics->rejected;
+        return false;
+    }
+
+    // queued was raised before idle_threads is read, a worker going to sleep raises idle_threads before reading queued
+    size_t idle = this->metrics->idle_threads.load();
+    if (idle > 0) {
+        std::lock_guard<std::mutex> lock(this->park_mutex);
+        this->park.notify_one();
+    }
+    // more tasks waiting than workers about to take them
+    if (this->metrics->queued.load() > idle && this->metrics->threads.load() < this->options.max_threads)
+        this->grow();
+    return true;
+}
+
+void WorkStealingPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(this->park_mutex);
+        this->stopping = true;
+    }
+    this->park.notify_all();
+    std::lock_guard<std::mutex> lock(this->resize_mutex);
+    for (auto &worker : this->workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+void WorkStealingPool::run(size_t index) {
+    Task task;
+    while (true) {
+        if (this->take(index, task)) {
+            task.fn();
+            task.fn = nullptr;
+            ++this->metrics->executed;
+            continue;
+        }
+
+        bool timed_out = false;
+        {
+            std::unique_lock<std::mutex> lock(this->park_mutex);
+            ++this->metrics->idle_threads;
+            while (this->metrics->queued.load() == 0 && !this->stopping.load() && !timed_out)
+                timed_out = this->park.wait_for(lock, this->options.idle_timeout) == std::cv_status::timeout;
+            --this->metrics->idle_threads;
+        }
+        // a queued task may not be visible in its queue yet, take again until it is
+        if (this->metrics->queued.load() != 0)
+            continue;
+        if (this->stopping.load()) {
+            this->workers[index]->running = false;
+            --this->metrics->threads;
+            return;
+        }
+        if (timed_out && this->retire(index))
+            return;
+    }
+}
+
+bool WorkStealingPool::take(size_t index, Task &task) {
+    const size_t count = this->workers.size();
+    bool stolen = false;
+    bool taken = this->workers[index]->tasks.pop(task);
+    for (size_t i = 1; i < count && !taken; ++i)
+        stolen = taken = this->workers[(index + i) % count]->tasks.pop(task);
+    if (!taken)
+        return false;
+
+    --this->metrics->queued;
+    if (stolen)
+        ++this->metrics->stolen;
+    auto waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - task.queued_at).count());
+    this->metrics->wait_ns_total += waited;
+    uint64_t longest = this->metrics->wait_ns_max.load(std::memory_order_relaxed);
+    while (waited > longest && !this->metrics->wait_ns_max.compare_exchange_weak(longest, waited, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void WorkStealingPool::grow() {
+    // The accept thread must not wait for a worker being joined, a busy pool tries again on the next task
+    std::unique_lock<std::mutex> lock(this->resize_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || this->stopping.load() || this->metrics->threads.load() >= this->options.max_threads)
+        return;
+    for (size_t i = 0; i < this->workers.size(); ++i) {
+        Worker &worker = *this->workers[i];
+        if (worker.running.load())
+            continue;
+        // a retired worker returns right after leaving its slot
+        if (worker.thread.joinable())
+            worker.thread.join();
+        worker.running = true;
+        ++this->metrics->threads;
+        try {
+            worker.thread = std::thread(&WorkStealingPool::run, this, i);
+        } catch (const std::system_error &e) {
+            worker.running = false;
+            --this->metrics->threads;
+            logf_warn("cannot start a http worker: %s\n", e.what());
+        }
+        return;
+    }
+}
+
+bool WorkStealingPool::retire(size_t index) {
+    // shutdown joins the workers holding the lock, a worker waiting for it would never return
+    std::unique_lock<std::mutex> lock(this->resize_mutex, std::try_to_lock);
+    if (!lock.owns_lock() || this->metrics->threads.load() <= this->options.min_threads)
+        return false;
+    this->workers[index]->running = false;
+    --this->metrics->threads;
+    return true;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file work_stealing_pool.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief Declaration of the WorkStealingPool class.
+ *
+ * This file contains the declaration of the WorkStealingPool class, a task queue for httplib::Server with per-worker queues,
+ * work stealing, bounded admission and a worker count following the load.
+ *
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+
+#include <httplib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace httpservernp
+{
+    /**
+     * @brief Snapshot of the metrics of a task queue.
+     */
+    struct TaskQueueStats {
+        size_t threads = 0;         /** Worker threads running. */
+        size_t idle_threads = 0;    /** Worker threads waiting for work. */
+        size_t queued = 0;          /** Tasks waiting for a worker. */
+        uint64_t executed = 0;      /** Tasks run. */
+        uint64_t rejected = 0;      /** Tasks refused because the queue was full. */
+        uint64_t stolen = 0;        /** Tasks run by another worker than the one they were queued to. */
+        uint64_t wait_ns_total = 0; /** Time all tasks run so far waited in the queue. */
+        uint64_t wait_ns_max = 0;   /** Longest time a task waited in the queue. */
+    };
+
+    /**
+     * @brief Live metrics of a task queue.
+     *
+     * Held by the owner of the server and shared with the pool, so they can be read while the server is restarted.
+     * A metrics object serves one pool at a time.
+     */
+    struct TaskQueueMetrics {
+        std::atomic<size_t> threads{0};         /** Worker threads running. */
+        std::atomic<size_t> idle_threads{0};    /** Worker threads waiting for work. */
+        std::atomic<size_t> queued{0};          /** Tasks admitted and not taken yet. */
+        std::atomic<uint64_t> executed{0};      /** Tasks run. */
+        std::atomic<uint64_t> rejected{0};      /** Tasks refused because the queue was full. */
+        std::atomic<uint64_t> stolen{0};        /** Tasks run by another worker than the one they were queued to. */
+        std::atomic<uint64_t> wait_ns_total{0}; /** Time all tasks run so far waited in the queue. */
+        std::atomic<uint64_t> wait_ns_max{0};   /** Longest time a task waited in the queue. */
+
+        /**
+         * @brief Read the metrics.
+         *
+         * @return TaskQueueStats
+         */
+        TaskQueueStats snapshot() const;
+    };
+
+    /**
+     * @brief Task queue for httplib::Server running each connection on a pool of workers.
+     *
+     * Every worker owns a bounded lock-free queue, new tasks are spread over the queues round-robin
+     * and a worker whose queue is empty steals from the others before going to sleep.
+     * No lock is taken while workers are busy, the sleeping workers are woken up through a condition variable.
+     * Tasks beyond the admission limit are refused, httplib then answers the connection with 503.
+     * A worker is started when more tasks are waiting than workers are idle, and a worker left idle for a while exits.
+     */
+    class WorkStealingPool : public httplib::TaskQueue
+    {
+    public:
+        /**
+         * @brief Sizing of the pool.
+         */
+        struct Options {
+            size_t min_threads = 2;                                            /** Workers kept running when idle, at least 1. */
+            size_t max_threads = 32;                                           /** Upper bound of the workers. */
+            size_t max_queued = 512;                                           /** Tasks waiting for a worker beyond which new ones are refused. */
+            std::chrono::milliseconds idle_timeout = std::chrono::seconds(30); /** Time a worker above min_threads stays idle before exiting. */
+        };
+
+        /**
+         * @brief Constructor for the WorkStealingPool class, starts min_threads workers.
+         *
+         * @param options Sizing of the pool.
+         * @param metrics Metrics updated by the pool, a private instance if null.
+         */
+        WorkStealingPool(const Options &options, std::shared_ptr<TaskQueueMetrics> metrics);
+
+        /**
+         * @brief Destructor for the WorkStealingPool class, runs the queued tasks and stops the workers.
+         */
+        ~WorkStealingPool() override;
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        /**
+         * @brief Queue a task.
+         *
+         * @param fn The task.
+         * @return True if admitted, false if the queue is full or the pool is shutting down.
+         */
+        bool enqueue(std::function<void()> fn) override;
+
+        /**
+         * @brief Run the queued tasks and stop the workers.
+         */
+        void shutdown() override;
+
+    private:
+        /**
+         * @brief A queued task.
+         */
+        struct Task {
+            std::function<void()> fn;                        /** The task. */
+            std::chrono::steady_clock::time_point queued_at; /** When it was admitted. */
+        };
+
+        /**
+         * @brief Bounded lock-free queue, any thread may push and pop.
+         *
+         * Each cell carries a sequence number telling whether it is free for the push or filled for the pop of the current lap,
+         * so pushes and pops only contend on their own index.
+         */
+        class TaskRing
+        {
+        public:
+            /**
+             * @brief Constructor for the TaskRing class.
+             *
+             * @param capacity Number of cells, a power of 2.
+             */
+            explicit TaskRing(size_t capacity);
+
+            /**
+             * @brief Append a task.
+             *
+             * @param task The task, moved from if pushed.
+             * @return True if pushed, false if the queue is full.
+             */
+            bool push(Task &task);
+
+            /**
+             * @brief Take the oldest task.
+             *
+             * @param task The task taken.
+             * @return True if taken, false if the queue is empty.
+             */
+            bool pop(Task &task);
+
+        private:
+            /**
+             * @brief A slot of the queue.
+             */
+            struct Cell {
+                std::atomic<size_t> sequence; /** Position the cell is ready for, +1 once filled. */
+                Task task;                    /** The task, valid while filled. */
+            };
+
+            std::unique_ptr<Cell[]> cells;        /** The slots. */
+            size_t mask;                          /** Number of cells minus 1. */
+            alignas(64) std::atomic<size_t> tail; /** Position of the next push. */
+            alignas(64) std::atomic<size_t> head; /** Position of the next pop. */
+        };
+
+        /**
+         * @brief A worker slot, reused when a worker exits and another one is started.
+         */
+        struct Worker {
+            explicit Worker(size_t capacity) : tasks(capacity) {}
+
+            TaskRing tasks;                   /** Tasks queued to this worker. */
+            std::thread thread;               /** The worker thread, may have exited if not running. */
+            std::atomic<bool> running{false}; /** The slot has a live worker taking new tasks. */
+        };
+
+        /**
+         * @brief Worker thread main loop.
+         *
+         * @param index The slot of the worker.
+         */
+        void run(size_t index);
+
+        /**
+         * @brief Take a task from the own queue, or steal one from the other workers.
+         *
+         * @param index The slot of the worker.
+         * @param task The task taken.
+         * @return True if a task was taken.
+         */
+        bool take(size_t index, Task &task);
+
+        /**
+         * @brief Start a worker if below max_threads, never blocks on another resize.
+         */
+        void grow();
+
+        /**
+         * @brief Let an idle worker exit if more than min_threads are running.
+         *
+         * @param index The slot of the worker.
+         * @return True if the worker must exit.
+         */
+        bool retire(size_t index);
+
+        Options options;                              /** Sizing of the pool. */
+        std::shared_ptr<TaskQueueMetrics> metrics;    /** Metrics, the counters also drive admission and wake-ups. */
+        std::vector<std::unique_ptr<Worker>> workers; /** Worker slots, max_threads of them. */
+        std::atomic<size_t> next_worker{0};           /** Round-robin position of the next push. */
+        std::atomic<bool> stopping{false};            /** Shutting down, no task is admitted anymore. */
+        std::mutex park_mutex;                        /** Protects the sleep of the idle workers. */
+        std::condition_variable park;                 /** Wakes up the idle workers. */
+        std::mutex resize_mutex;                      /** Serializes starting and exiting workers. */
+    };
+
+} // namespace httpservernp
@@ -0,0 +1,151 @@
+/**
+ * @file worker_pool.hpp
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 固定线程数的工作线程池
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace websocketnp
+{
+    /**
+     * @class WorkerPool
+     * @brief 所有连接共享的工作线程池, 任务按提交顺序取出
+     */
+    class WorkerPool
+    {
+    public:
+        /**
+         * @brief 构造函数, 立即启动工作线程
+         *
+         * @param thread_count 线程数, 0表示与CPU核数相同
+         */
+        explicit WorkerPool(size_t thread_count = 0) {
+            if (thread_count == 0)
+                thread_count = std::max(1u, std::thread::hardware_concurrency());
+            this->threads.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; ++i)
+                this->threads.emplace_back(&WorkerPool::run, this);
+        }
+
+        /**
+         * @brief 析构函数, 执行完已提交的任务后退出
+         *
+         */
+        ~WorkerPool() {
+            this->stop();
+        }
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        /**
+         * @brief 提交任务
+         *
+         * @param task 不能抛出异常
+         * @return bool 线程池已停止时返回false, 任务不会执行
+         */
+        bool post(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (this->stopping)
+                    return false;
+                this->tasks.push_back(std::move(task));
+            }
+            this->cv.notify_one();
+            return true;
+        }
+
+        /**
+         * @brief 提交有返回值的任务
+         *
+         * @tparam Task
+         * @param task
+         * @return std::future 线程池已停止时得到broken_promise异常
+         */
+        template <typename Task>
+        auto submit(Task &&task) -> std::future<std::invoke_result_t<Task>> {
+            using Result = std::invoke_result_t<Task>;
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+            auto future = packaged->get_future();
+            this->post([packaged]() { (*packaged)(); });
+            return future;
+        }
+
+        /**
+         * @brief 停止接受新任务, 执行完已提交的任务后等待线程退出
+         *
+         */
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (this->stopping)
+                    return;
+                this->stopping = true;
+            }
+            this->cv.notify_all();
+            for (auto &thread : this->threads)
+                thread.join();
+        }
+
+        /**
+         * @brief 线程数
+         *
+         * @return size_t
+         */
+        size_t size() const {
+            return this->threads.size();
+        }
+
+        /**
+         * @brief 等待执行的任务数
+         *
+         * @return size_t
+         */
+        size_t pending() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->tasks.size();
+        }
+
+    private:
+        std::vector<std::thread> threads;        // 工作线程
+        std::deque<std::function<void()>> tasks; // 等待执行的任务
+        std::mutex mutex;                        // 保护tasks和stopping
+        std::condition_variable cv;              // 有新任务或停止时唤醒
+        bool stopping = false;                   // 不再接受新任务
+
+        /**
+         * @brief 工作线程主循环
+         *
+         */
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->cv.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+                    if (this->tasks.empty())
+                        return;
+                    task = std::move(this->tasks.front());
+                    this->tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+} // namespace websocketnp
@@ -0,0 +1,145 @@
+/**
+ * @file http_download_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief HttpServer静态文件流式发送的负载测试: 多个客户端并行下载大文件时的吞吐和内存占用
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: http_download_bench [文件MB数] [并发客户端数]
+ * 在临时目录生成稀疏文件, 开启文件流式发送后由并发客户端下载并丢弃数据, 最后报告吞吐和进程RSS峰值;
+ * 另外检查多段Range请求的各段Content-Range带有文件的总长度
+ *
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <http_server.hpp>
+#include <log.h>
+
+/**
+ * @brief 读取/proc/self/status中的内存字段
+ *
+ * @param key 字段名, 如VmRSS, VmHWM
+ * @return long 单位kB, 读取失败时返回-1
+ */
+static long proc_status_kb(const std::string &key) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") == 0)
+            return strtol(line.c_str() + key.size() + 1, nullptr, 10);
+    }
+    return -1;
+}
+
+/**
+ * @brief 请求多段Range, 检查206响应中每段的Content-Range和内容
+ *
+ * @param client
+ * @param path 请求路径
+ * @param size 文件总长度
+ * @param content 文件内容, 为空时不检查内容
+ * @return bool
+ */
+static bool check_multipart_ranges(httplib::Client &client, const std::string &path, size_t size, const std::string &content) {
+    auto res = client.Get(path.c_str(), {{"Range", "bytes=0-1,4-5"}});
+    if (!res || res->status != 206) {
+        logf_err("%s: multipart range got %d\n", path.c_str(), res ? res->status : -1);
+        return false;
+    }
+    const std::string total = "/" + std::to_string(size);
+    for (auto range : {std::make_pair(0, 1), std::make_pair(4, 5)}) {
+        std::string field = "Content-Range: bytes " + std::to_string(range.first) + "-" + std::to_string(range.second) + total + "\r\n\r\n";
+        auto at = res->body.find(field);
+        if (at == std::string::npos || (!content.empty() && res->body.compare(at + field.size(), 2, content, range.first, 2) != 0)) {
+            logf_err("%s: part %s missing in\n%s\n", path.c_str(), field.c_str(), res->body.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char const *argv[]) {
+    size_t file_mb = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024;
+    size_t clients = argc > 2 ? strtoull(argv[2], nullptr, 10) : 50;
+    const int port = 9390;
+
+    char root[] = "/tmp/http_download_benchXXXXXX";
+    if (!mkdtemp(root)) {
+        logf_err("mkdtemp failed\n");
+        return 1;
+    }
+    const std::string file = std::string(root) + "/download.bin";
+    const size_t file_size = file_mb << 20;
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(file_size)) != 0) {
+        logf_err("create %s failed\n", file.c_str());
+        return 1;
+    }
+    ::close(fd);
+    const std::string text = "0123456789";
+    std::ofstream(std::string(root) + "/a.txt") << text;
+
+    httpservernp::HttpServer server(port, "127.0.0.1");
+    server.set_root_path(root);
+    server.enable_file_streaming();
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    long rss_before = proc_status_kb("VmRSS");
+    std::atomic<size_t> received{0};
+    std::atomic<size_t> completed{0};
+    std::atomic<bool> sampling{true};
+    long rss_peak = rss_before;
+    std::thread sampler([&]() {
+        while (sampling) {
+            rss_peak = std::max(rss_peak, proc_status_kb("VmRSS"));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> downloaders;
+    for (size_t i = 0; i < clients; ++i) {
+        downloaders.emplace_back([&]() {
+            httplib::Client client("127.0.0.1", port);
+            client.set_read_timeout(60, 0);
+            size_t bytes = 0;
+            auto res = client.Get("/download.bin", [&bytes](const char *, size_t length) {
+                bytes += length;
+                return true;
+            });
+            received += bytes;
+            if (res && res->status == 200 && bytes == file_size)
+                ++completed;
+        });
+    }
+    for (auto &downloader : downloaders)
+        downloader.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    sampling = false;
+    sampler.join();
+
+    httplib::Client client("127.0.0.1", port);
+    bool ranges = check_multipart_ranges(client, "/download.bin", file_size, "") && check_multipart_ranges(client, "/a.txt", text.size(), text);
+
+    server.stop();
+    ::unlink(file.c_str());
+    ::unlink((std::string(root) + "/a.txt").c_str());
+    ::rmdir(root);
+
+    logf_info("%zu/%zu downloads of %zu MB in %.3f s: %.1f MB/s\n", completed.load(), clients, file_mb, elapsed,
+              received / elapsed / (1 << 20));
+    logf_info("RSS %ld kB before, %ld kB peak during the downloads (server and clients share the process)\n", rss_before, rss_peak);
+    return completed == clients && ranges ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file http_pool_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief HttpServer任务队列的负载测试: httplib固定线程池与WorkStealingPool在突发连接下的吞吐, 排队和过载拒绝
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: http_pool_bench [并发客户端数] [每个客户端的请求数] [处理函数耗时us]
+ * 每个请求使用新连接, 连接即任务; 最后一轮把线程池和排队上限调小, 验证超出部分返回503
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <http_server.hpp>
+#include <log.h>
+
+using namespace httpservernp;
+
+/**
+ * @brief 一轮测试的结果
+ */
+struct RoundResult {
+    size_t ok = 0;        // 200的请求数
+    size_t rejected = 0;  // 503的请求数
+    size_t failed = 0;    // 连接失败或其他状态的请求数
+    double seconds = 0;   // 耗时
+    double p99_ms = 0;    // 成功请求的99分位延迟
+};
+
+/**
+ * @brief 启动服务器并用并发客户端压测一轮
+ *
+ * @param port 监听端口
+ * @param setup 启动前配置服务器
+ * @param clients 并发客户端数
+ * @param requests 每个客户端的请求数
+ * @param handler_us 处理函数耗时
+ * @param stats 输出线程池的统计
+ * @return RoundResult
+ */
+template <typename Setup>
+static RoundResult run_round(int port, Setup setup, size_t clients, size_t requests, int handler_us, TaskQueueStats &stats) {
+    HttpServer server(port, "127.0.0.1");
+    server.set_root_path("/tmp");
+    server.register_handler("/api/work/:id<uint>", HttpMethods::GET, [handler_us](const Request &req, Response &res) {
+        std::this_thread::sleep_for(std::chrono::microseconds(handler_us));
+        res.set_content(req.path_params.at("id"), "text/plain");
+    });
+    setup(server);
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    std::atomic<size_t> ok{0}, rejected{0}, failed{0};
+    std::vector<std::vector<double>> latencies(clients);
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            httplib::Client client("127.0.0.1", port);
+            for (size_t i = 0; i < requests; ++i) {
+                auto sent = std::chrono::steady_clock::now();
+                auto res = client.Get(("/api/work/" + std::to_string(i)).c_str());
+                if (res && res->status == 200) {
+                    ++ok;
+                    latencies[c].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+                } else if (res && res->status == 503) {
+                    ++rejected;
+                } else {
+                    ++failed;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    RoundResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    stats = server.task_queue_stats();
+    server.stop();
+
+    std::vector<double> all;
+    for (const auto &client : latencies)
+        all.insert(all.end(), client.begin(), client.end());
+    std::sort(all.begin(), all.end());
+    result.ok = ok;
+    result.rejected = rejected;
+    result.failed = failed;
+    result.p99_ms = all.empty() ? 0 : all[all.size() * 99 / 100];
+    return result;
+}
+
+/**
+ * @brief 打印一轮测试的结果
+ *
+ * @param name 轮次名
+ * @param result 结果
+ * @param stats 线程池的统计, 固定线程池时全为0
+ */
+static void report(const char *name, const RoundResult &result, const TaskQueueStats &stats) {
+    logf_info("%-14s %6zu ok %5zu rejected %3zu failed in %.2f s: %7.0f req/s, p99 %.2f ms\n", name, result.ok, result.rejected,
+              result.failed, result.seconds, result.ok / result.seconds, result.p99_ms);
+    if (stats.executed || stats.rejected)
+        logf_info("%-14s pool: executed %llu stolen %llu rejected %llu, wait avg %.1f us max %.1f us\n", "",
+                  static_cast<unsigned long long>(stats.executed), static_cast<unsigned long long>(stats.stolen),
+                  static_cast<unsigned long long>(stats.rejected), stats.wait_ns_total / 1e3 / std::max<uint64_t>(stats.executed, 1),
+                  stats.wait_ns_max / 1e3);
+}
+
+int main(int argc, char const *argv[]) {
+    size_t clients = argc > 1 ? strtoull(argv[1], nullptr, 10) : 32;
+    size_t requests = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200;
+    int handler_us = argc > 3 ? atoi(argv[3]) : 200;
+    TaskQueueStats stats;
+
+    auto fixed = run_round(9391, [](HttpServer &) {}, clients, requests, handler_us, stats);
+    report("httplib pool", fixed, stats);
+
+    auto stealing = run_round(9392, [](HttpServer &server) { server.enable_work_stealing_pool(); }, clients, requests, handler_us, stats);
+    report("work stealing", stealing, stats);
+
+    WorkStealingPool::Options small;
+    small.min_threads = 1;
+    small.max_threads = 2;
+    small.max_queued = 4;
+    auto shedding = run_round(9393, [&small](HttpServer &server) { server.enable_work_stealing_pool(small); }, clients, requests / 4, handler_us * 10, stats);
+    report("overload", shedding, stats);
+
+    bool ok = fixed.failed == 0 && stealing.failed == 0 && stealing.rejected == 0 && shedding.rejected > 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file http_router_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief HttpRouter的微基准: 与httplib按注册顺序逐个std::regex_match的路由方式对比
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: http_router_bench [每组查找次数]
+ * 分别注册10/100/1000条路由, 字面路径, 带uint参数和带字符串参数的路由各占三分之一,
+ * 请求均匀命中所有路由并混入十分之一的未命中路径
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <http_router.hpp>
+#include <log.h>
+
+using namespace httplib;
+using namespace httpservernp;
+
+/**
+ * @brief 第i条路由的模式, regex为httplib使用的等价正则
+ *
+ * @param i 路由序号
+ * @param regex 是否返回正则形式
+ * @return std::string
+ */
+static std::string route_pattern(size_t i, bool regex) {
+    std::string base = "/api/v1/resource" + std::to_string(i);
+    switch (i % 3) {
+    case 0:
+        return base + "/status";
+    case 1:
+        return base + (regex ? R"(/(\d+))" : "/:id<uint>");
+    default:
+        return base + (regex ? "/([^/]+)/items" : "/:name/items");
+    }
+}
+
+/**
+ * @brief 命中第i条路由的请求路径
+ *
+ * @param i 路由序号
+ * @return std::string
+ */
+static std::string request_path(size_t i) {
+    std::string base = "/api/v1/resource" + std::to_string(i);
+    switch (i % 3) {
+    case 0:
+        return base + "/status";
+    case 1:
+        return base + "/" + std::to_string(i * 7);
+    default:
+        return base + "/dev" + std::to_string(i) + "/items";
+    }
+}
+
+int main(int argc, char const *argv[]) {
+    size_t lookups = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+
+    for (size_t routes : {10, 100, 1000}) {
+        size_t hits = 0;
+        auto handler = [&hits](const Request &, Response &) { ++hits; };
+
+        HttpRouter router;
+        std::vector<std::pair<std::regex, HttpRouter::Handler>> expressions;
+        for (size_t i = 0; i < routes; ++i) {
+            router.add("GET", route_pattern(i, false), handler);
+            expressions.emplace_back(std::regex(route_pattern(i, true)), handler);
+        }
+
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < routes; ++i) {
+            paths.push_back(request_path(i));
+            if (i % 10 == 9)
+                paths.push_back("/api/v1/missing" + std::to_string(i));
+        }
+
+        Request req;
+        req.method = "GET";
+        Response res;
+        double elapsed[2];
+        size_t found[2];
+        for (int variant = 0; variant < 2; ++variant) {
+            hits = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t n = 0; n < lookups; ++n) {
+                req.path = paths[n % paths.size()];
+                if (variant == 1) {
+                    router.dispatch(req, res, nullptr);
+                    continue;
+                }
+                // httplib::Server::dispatch_request
+                for (const auto &expression : expressions) {
+                    if (std::regex_match(req.path, req.matches, expression.first)) {
+                        expression.second(req, res);
+                        break;
+                    }
+                }
+            }
+            elapsed[variant] = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            found[variant] = hits;
+        }
+
+        logf_info("%4zu routes: regex scan %9.0f ns/req, router %6.0f ns/req, %.0fx faster, hits %zu/%zu\n", routes,
+                  elapsed[0] / lookups * 1e9, elapsed[1] / lookups * 1e9, elapsed[0] / elapsed[1], found[1], found[0]);
+        if (found[0] != found[1]) {
+            logf_err("router and regex scan disagree\n");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file websocket_arena_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief 消息处理路径的堆分配对比: 全局堆上的nlohmann::json与每连接内存池上的MessageJson
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: websocket_arena_bench [每个线程处理的请求数] [线程数]
+ * 每个线程模拟一个连接: 解析请求, 调用回调生成回复, 序列化回复. 统计每个请求的堆分配次数和吞吐
+ *
+ */
+
+#include <message_arena.hpp>
+#include <message_format.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <log.h>
+
+using namespace websocketnp;
+
+static std::atomic<uint64_t> heap_allocations{0};
+
+// 替换全局的operator new以统计堆分配次数, 不内联以免编译器把new和free配对检查
+__attribute__((noinline)) void *operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+/**
+ * @brief 构造一组请求
+ *
+ * @return std::vector<std::string>
+ */
+static std::vector<std::string> make_requests() {
+    nlohmann::json samples = nlohmann::json::array();
+    for (int i = 0; i < 20; ++i)
+        samples.push_back({{"ch", i % 8}, {"snr", -40.5 + i}, {"lock", i % 3 == 0}});
+    return {
+        nlohmann::json{{"type", "StartWork"}, {"value", {{"mode", "auto"}, {"channels", {0, 1, 2, 3}}, {"gain", 12.5}}}}.dump(),
+        nlohmann::json{{"type", "Working"}, {"value", {}}}.dump(),
+        nlohmann::json{{"type", "SetSchedule"}, {"value", {{"start", "2026-10-17T08:00:00"}, {"repeat", 3}}}}.dump(),
+        nlohmann::json{{"type", "UploadSamples"}, {"value", samples}}.dump(),
+    };
+}
+
+/**
+ * @brief 按请求生成回复, 与controller中的回调类似
+ *
+ * @tparam Json
+ * @param request
+ * @return Json
+ */
+template <typename Json>
+static Json handle(const Json &request) {
+    const Json &value = request["value"];
+    return {{"type", request["type"].template get_ref<const std::string &>() + "Ret"},
+            {"value", {{"success", true}, {"msg", ""}, {"count", value.size()}}}};
+}
+
+/**
+ * @brief 多线程运行一种处理方式
+ *
+ * @param name 名称
+ * @param requests 请求
+ * @param per_thread 每个线程的请求数
+ * @param threads 线程数
+ * @param process 处理一条请求, 参数为线程序号和请求
+ */
+template <typename Process>
+static void run(const char *name, const std::vector<std::string> &requests, size_t per_thread, size_t threads, Process process) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    uint64_t allocations_before = heap_allocations.load();
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t i = 0; i < per_thread; ++i)
+                process(t, requests[i % requests.size()]);
+        });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    // 减去启动线程本身的分配
+    uint64_t allocations = heap_allocations.load() - allocations_before - threads;
+    size_t total = per_thread * threads;
+    logf_info("%-6s: %zu threads, %.0f req/s, %.2f heap allocations/request\n", name, threads, total / elapsed, allocations / static_cast<double>(total));
+}
+
+int main(int argc, char const *argv[]) {
+    size_t per_thread = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200000;
+    size_t threads = argc > 2 ? strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    const auto requests = make_requests();
+
+    // 先比对两种方式的回复
+    {
+        MessageArena arena;
+        std::string buffer;
+        for (const auto &request : requests) {
+            MessageArena::Scope scope(arena);
+            encode_message(MessageFormat::Json, handle(MessageJson::parse(request)), buffer);
+            if (buffer != handle(nlohmann::json::parse(request)).dump()) {
+                logf_err("reply mismatch: %s\n", request.c_str());
+                return 1;
+            }
+        }
+    }
+
+    run("heap", requests, per_thread, threads, [](size_t, const std::string &request) {
+        std::string reply = handle(nlohmann::json::parse(request)).dump();
+        return reply.size();
+    });
+
+    // 每个线程一个内存池和回复缓冲区, 与ClientState相同
+    std::vector<std::unique_ptr<MessageArena>> arenas;
+    std::vector<std::string> buffers(threads);
+    for (size_t t = 0; t < threads; ++t)
+        arenas.push_back(std::make_unique<MessageArena>());
+    run("arena", requests, per_thread, threads, [&](size_t t, const std::string &request) {
+        MessageArena::Scope scope(*arenas[t]);
+        encode_message(MessageFormat::Json, handle(MessageJson::parse(request)), buffers[t]);
+        return buffers[t].size();
+    });
+
+    uint64_t blocks = 0;
+    for (const auto &arena : arenas)
+        blocks += arena->block_allocation_count();
+    logf_info("arena blocks allocated: %llu\n", static_cast<unsigned long long>(blocks));
+    return 0;
+}
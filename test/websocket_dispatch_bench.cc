@@ -0,0 +1,222 @@
+/**
+ * @file websocket_dispatch_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocket命令分发的微基准: 完整DOM解析加std::map查表, 与扫描type加完美哈希表按需解析value的对比
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: websocket_dispatch_bench [每种方式处理的请求数]
+ * 请求按controller注册的命令构造, 另有约一成未注册的命令和一条带较大value的上报;
+ * 计时前先检查扫描只接受完整解析也接受的消息, 其他键或value写错时同样报错
+ *
+ */
+
+#include <command_dispatch.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <log.h>
+
+using namespace websocketnp;
+
+using Handler = std::function<nlohmann::json(const nlohmann::json &)>;
+
+/**
+ * @brief 构造一组请求
+ *
+ * @return std::vector<std::string>
+ */
+static std::vector<std::string> make_requests() {
+    nlohmann::json samples = nlohmann::json::array();
+    for (int i = 0; i < 100; ++i)
+        samples.push_back({{"ch", i % 8}, {"snr", -40.5 + i}, {"freq", 1.2e9 + i * 1e5}, {"lock", i % 3 == 0}});
+
+    std::vector<std::string> requests = {
+        nlohmann::json{{"type", "StartWork"}, {"value", {{"mode", "auto"}, {"channels", {0, 1, 2, 3}}, {"gain", 12.5}}}}.dump(),
+        nlohmann::json{{"type", "StopWork"}, {"value", nullptr}}.dump(),
+        nlohmann::json{{"type", "Working"}, {"value", {}}}.dump(),
+        nlohmann::json{{"type", "VersionReq"}, {"value", ""}}.dump(),
+        nlohmann::json{{"value", {{"id", 42}, {"name", "ant-3"}}}, {"type", "SetAntenna"}}.dump(),
+        nlohmann::json{{"type", "SetSchedule"}, {"value", {{"start", "2026-10-17T08:00:00"}, {"repeat", 3}, {"note", "维护窗口"}}}}.dump(),
+        nlohmann::json{{"type", "UploadSamples"}, {"value", samples}}.dump(),
+        nlohmann::json{{"type", "NoSuchCommand"}, {"value", {{"x", 1}}}}.dump(),
+        nlohmann::json{{"type", "Working"}, {"value", 1}}.dump(),
+        nlohmann::json{{"type", "StartWork"}, {"value", {{"mode", "manual"}}}}.dump(),
+    };
+    return requests;
+}
+
+/**
+ * @brief 扫描与完整解析对其他键的值是否同样接受或拒绝
+ *
+ * @return bool
+ */
+static bool check_scan_grammar() {
+    const char *cases[] = {
+        R"({"type":"StartWork","value":1,"x":true})",
+        R"({"type":"StartWork","value":1,"x":tru})",
+        R"({"type":"StartWork","value":1,"x":truex})",
+        R"({"type":"StartWork","value":1,"x":nul})",
+        R"({"type":"StartWork","value":1,"x":1x})",
+        R"({"type":"StartWork","value":1,"x":01})",
+        R"({"type":"StartWork","value":1,"x":-})",
+        R"({"type":"StartWork","value":1,"x":1.})",
+        R"({"type":"StartWork","value":1,"x":.5})",
+        R"({"type":"StartWork","value":1,"x":1e})",
+        R"({"type":"StartWork","value":1,"x":+1})",
+        R"({"type":"StartWork","value":1,"x":1e999})",
+        R"({"type":"StartWork","value":1,"x":-0.5E+3})",
+        R"({"type":"StartWork","value":1,"x":12345678901234567890123})",
+        R"({"type":"StartWork","value":1,"x":[}})",
+        R"({"type":"StartWork","value":1,"x":{]})",
+        R"({"type":"StartWork","value":1,"x":[1,]})",
+        R"({"type":"StartWork","value":1,"x":[1 2]})",
+        R"({"type":"StartWork","value":1,"x":{"a"}})",
+        R"({"type":"StartWork","value":1,"x":{"a":1,}})",
+        R"({"type":"StartWork","value":1,"x":{1:2}})",
+        R"({"type":"StartWork","value":1,"x":[[],{},[{"a":[null,false]}]]})",
+        R"({"type":"StartWork","value":1,"x": [ 1 , { "b" : "c" } ] })",
+        R"({"type":"StartWork","value":1,"x":"\q"})",
+        R"({"type":"StartWork","value":1,"x":"\u12"})",
+        R"({"type":"StartWork","value":1,"x":"é\n\"\/"})",
+        R"({"type":"StartWork","value":1,"x":"😀"})",
+        R"({"type":"StartWork","value":1,"x":"\ud83d"})",
+        R"({"type":"StartWork","value":1,"x":"\ude00"})",
+        R"({"type":"StartWork","value":1,"x":1} )",
+        R"({"type":"StartWork","value":1,"x":1}})",
+    };
+    bool ok = true;
+    for (const char *request : cases) {
+        CommandEnvelope envelope;
+        bool scanned = scan_command(request, envelope);
+        bool accepted = nlohmann::json::accept(request);
+        if (scanned != accepted) {
+            logf_err("scan %s, full parse %s: %s\n", scanned ? "accepts" : "rejects", accepted ? "accepts" : "rejects", request);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char const *argv[]) {
+    size_t total = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    const char *commands[] = {"StartWork", "StopWork", "Working", "VersionReq", "SetAntenna", "SetSchedule", "UploadSamples",
+                              "GetConfig", "SetConfig", "Reboot", "ClearAlarm", "GetLog"};
+
+    size_t handled = 0;
+    Handler handler = [&handled](const nlohmann::json &value) {
+        handled += value.size();
+        return nlohmann::json();
+    };
+    std::map<std::string, Handler> map_table;
+    std::vector<PerfectHashMap<Handler>::Item> items;
+    for (const char *command : commands) {
+        map_table[command] = handler;
+        items.emplace_back(command, handler);
+    }
+    PerfectHashMap<Handler> hash_table(std::move(items));
+    logf_info("%zu commands in %zu slots\n", map_table.size(), hash_table.table_size());
+
+    if (!check_scan_grammar())
+        return 1;
+
+    const auto requests = make_requests();
+    size_t request_bytes = 0;
+    for (const auto &request : requests)
+        request_bytes += request.size();
+
+    // 原有的路径: 完整解析, 先find再operator[]
+    size_t dom_handled = 0;
+    auto dom_dispatch = [&](const std::string &request) {
+        auto json_msg = nlohmann::json::parse(request);
+        if (!json_msg.contains("value") || !json_msg.contains("type"))
+            return false;
+        std::string type = json_msg.value("type", "");
+        if (map_table.find(type) == map_table.end())
+            return false;
+        map_table[type](json_msg["value"]);
+        return true;
+    };
+    // 新的路径: 扫描顶层键, 完美哈希查表, 找到回调后才解析value
+    // 未注册的命令和value写错时退回完整解析, 与WebsocketServer::handle_message相同
+    auto scan_dispatch = [&](const std::string &request) {
+        CommandEnvelope envelope;
+        if (!scan_command(request, envelope) || !envelope.has_type || !envelope.has_value)
+            return dom_dispatch(request);
+        const Handler *found = hash_table.find(envelope.type);
+        if (!found)
+            return dom_dispatch(request);
+        nlohmann::json value;
+        try {
+            value = nlohmann::json::parse(envelope.value.begin(), envelope.value.end());
+        } catch (const nlohmann::json::parse_error &) {
+            return dom_dispatch(request);
+        }
+        (*found)(value);
+        return true;
+    };
+
+    // value只找出结尾, 写错时由解析value发现, 退回完整解析后报错
+    for (const char *request : {R"({"type":"StartWork","value":tru})", R"({"type":"StartWork","value":[}})",
+                                R"({"type":"StartWork","value":{"a":1,}})", R"({"type":"NoSuchCommand","value":[1,]})"}) {
+        try {
+            scan_dispatch(request);
+            logf_err("malformed value dispatched: %s\n", request);
+            return 1;
+        } catch (const nlohmann::json::parse_error &) {
+        }
+    }
+
+    // 先比对两条路径的结果
+    for (const auto &request : requests) {
+        handled = 0;
+        bool dom_ok = dom_dispatch(request);
+        dom_handled = handled;
+        handled = 0;
+        if (dom_ok != scan_dispatch(request) || dom_handled != handled) {
+            logf_err("dispatch mismatch: %s\n", request.c_str());
+            return 1;
+        }
+    }
+
+    const std::pair<const char *, std::function<bool(const std::string &)>> paths[] = {{"dom+map", dom_dispatch}, {"scan+phf", scan_dispatch}};
+    // 两种方式交替分轮计时, 机器负载的波动对两者的影响相同
+    const size_t rounds = 20;
+    const size_t per_round = std::max<size_t>(total / rounds, 1);
+    auto measure = [&](size_t k, size_t count, size_t &dispatched) {
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < per_round; ++i)
+            dispatched += paths[k].second(requests[i % count]);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    double elapsed[2] = {0, 0};
+    size_t dispatched[2] = {0, 0};
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t k = 0; k < 2; ++k)
+            elapsed[k] += measure(k, requests.size(), dispatched[k]);
+    }
+    for (size_t k = 0; k < 2; ++k)
+        logf_info("%-8s: %zu requests (%zu dispatched) in %.3f s: %.0f req/s, %.1f MB/s\n", paths[k].first, rounds * per_round, dispatched[k], elapsed[k],
+                  rounds * per_round / elapsed[k], rounds * per_round * (request_bytes / static_cast<double>(requests.size())) / elapsed[k] / 1e6);
+    logf_info("speedup: %.2fx\n", elapsed[0] / elapsed[1]);
+
+    // 只有小命令时, 不含大value的上报
+    double small[2] = {0, 0};
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t k = 0; k < 2; ++k)
+            small[k] += measure(k, 6, dispatched[k]);
+    }
+    for (size_t k = 0; k < 2; ++k)
+        logf_info("%-8s small commands: %.0f req/s\n", paths[k].first, rounds * per_round / small[k]);
+    logf_info("small commands speedup: %.2fx\n", small[0] / small[1]);
+    return 0;
+}
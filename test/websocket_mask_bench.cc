@@ -0,0 +1,64 @@
+/**
+ * @file websocket_mask_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocket负载掩码各实现的吞吐对比
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: websocket_mask_bench [每种尺寸处理的总字节数]
+ * 依次对各负载尺寸运行当前CPU支持的所有掩码实现, 先与逐字节实现比对结果, 再统计吞吐
+ *
+ */
+
+#include <ixwebsocket/IXWebSocketMask.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <log.h>
+
+int main(int argc, char const *argv[]) {
+    size_t total_bytes = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1ull << 30;
+    const size_t payload_sizes[] = {16, 125, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    const ix::MaskKernel kernels[] = {ix::MaskKernel::Scalar, ix::MaskKernel::Word, ix::MaskKernel::SSE2, ix::MaskKernel::AVX2};
+    const uint8_t masking_key[4] = {0x12, 0x34, 0x56, 0x78};
+
+    logf_info("best kernel: %s\n", ix::getMaskKernelName(ix::getBestMaskKernel()));
+    for (size_t payload_size : payload_sizes) {
+        // 多留一个字节, 从奇数地址开始, 覆盖非对齐访问
+        std::vector<uint8_t> buffer(payload_size + 1);
+        for (size_t i = 0; i < buffer.size(); ++i)
+            buffer[i] = static_cast<uint8_t>(i * 131 + 7);
+        uint8_t *payload = buffer.data() + 1;
+
+        std::vector<uint8_t> expected(payload, payload + payload_size);
+        ix::getMaskFunction(ix::MaskKernel::Scalar)(expected.data(), payload_size, masking_key);
+
+        size_t iterations = std::max<size_t>(1, total_bytes / payload_size);
+        for (ix::MaskKernel kernel : kernels) {
+            ix::MaskFunction mask = ix::getMaskFunction(kernel);
+            if (!mask)
+                continue;
+
+            std::vector<uint8_t> check(payload, payload + payload_size);
+            mask(check.data(), payload_size, masking_key);
+            if (check != expected) {
+                logf_err("%s: wrong result for %zu bytes\n", ix::getMaskKernelName(kernel), payload_size);
+                return 1;
+            }
+
+            auto begin = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i)
+                mask(payload, payload_size, masking_key);
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            logf_info("%8zu bytes %-6s: %8.2f GB/s\n", payload_size, ix::getMaskKernelName(kernel),
+                      iterations * payload_size / elapsed / 1e9);
+        }
+    }
+    return 0;
+}
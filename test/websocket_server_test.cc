@@ -43,15 +43,24 @@ int main(int argc, char const *argv[]) {
     printf("press q with enter to quit.\n");
     printf("press s with enter to show connections.\n");
     printf("press t with enter to send test message.\n");
+    printf("press c with enter to publish a console message to subscribers of CONSOLE.\n");
     char quit;
     while (true) {
         quit = getchar();
-        if (quit == 's')
+        if (quit == 's') {
             logf_info("\n%s\n", server.show_all_connections().dump(4).c_str());
-        else if (quit == 'q')
+            logf_info("\n%s\n", server.show_send_queue_counters().dump(4).c_str());
+            logf_info("\n%s\n", server.show_topics().dump(4).c_str());
+        } else if (quit == 'q') {
             break;
-        else if (quit == 't')
-            server.brodcast_message({{"type", "CONSOLE"}, {"value", {{"message", "SNR = " + std::to_string(random() % 80 - 40) + " dB"}, {"level", "INFO"}}}});
+        } else if (quit == 't') {
+            auto stats = server.brodcast_message({{"type", "CONSOLE"}, {"value", {{"message", "SNR = " + std::to_string(random() % 80 - 40) + " dB"}, {"level", "INFO"}}}});
+            logf_info("broadcast %zu bytes to %zu clients, serialize %lld us, send %lld us\n", stats.bytes, stats.clients,
+                      static_cast<long long>(stats.serialize_time.count()), static_cast<long long>(stats.send_time.count()));
+        } else if (quit == 'c') {
+            auto stats = server.publish("CONSOLE", {{"type", "CONSOLE"}, {"value", {{"message", "topic test"}, {"level", "INFO"}}}});
+            logf_info("published %zu bytes to %zu subscribers\n", stats.bytes, stats.clients);
+        }
     }
 
     running = false;
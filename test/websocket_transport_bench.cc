@@ -0,0 +1,231 @@
+/**
+ * @file websocket_transport_bench.cc
+ * @author wlanxww (xueweiwujxw@outlook.com)
+ * @brief WebSocketTransport接收路径的微基准: 小帧突发到达时的解帧吞吐
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * 用法: websocket_transport_bench [帧数] [每帧字节数]
+ * 对端线程通过socketpair持续写入带掩码的帧, 主线程以服务端模式poll并dispatch;
+ * 最后发送声明超大长度但不带负载的续帧, 验证接收端不会按对端声明的长度预留内存
+ *
+ */
+
+#include <ixwebsocket/IXSocket.h>
+#include <ixwebsocket/IXWebSocketTransport.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <log.h>
+
+/**
+ * @brief 生成一批客户端发往服务端的带掩码文本帧
+ *
+ * @param count 帧数
+ * @param payload_size 每帧负载字节数, 小于126
+ * @return std::string
+ */
+static std::string make_frames(size_t count, size_t payload_size) {
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string frames;
+    frames.reserve(count * (payload_size + 6));
+    for (size_t i = 0; i < count; ++i) {
+        frames.push_back(static_cast<char>(0x81));
+        frames.push_back(static_cast<char>(0x80 | payload_size));
+        frames.append(reinterpret_cast<const char *>(mask), 4);
+        for (size_t j = 0; j < payload_size; ++j)
+            frames.push_back(static_cast<char>('a' ^ mask[j & 0x3]));
+    }
+    return frames;
+}
+
+/**
+ * @brief 阻塞写入全部数据
+ *
+ * @param fd
+ * @param data
+ * @return bool
+ */
+static bool write_all(int fd, const std::string &data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t ret = ::write(fd, data.data() + offset, data.size() - offset);
+        if (ret <= 0)
+            return false;
+        offset += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+/**
+ * @brief 在socketpair上建立服务端模式的WebSocketTransport
+ *
+ * @param fds socketpair, fds[0]交给transport, fds[1]作为客户端
+ * @param transport
+ * @return bool
+ */
+static bool open_transport(int fds[2], ix::WebSocketTransport &transport) {
+    int buffer_size = 4 * 1024 * 1024;
+    setsockopt(fds[0], SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // 握手请求提前写入, 服务端握手时直接读取
+    write_all(fds[1], "GET / HTTP/1.1\r\n"
+                      "Host: bench\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: Upgrade\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                      "Sec-WebSocket-Version: 13\r\n\r\n");
+
+    transport.configure(ix::WebSocketPerMessageDeflateOptions(false), ix::SocketTLSOptions(), false, -1);
+    auto socket = std::make_unique<ix::Socket>(fds[0]);
+    std::string error;
+    if (!socket->init(error)) {
+        logf_err("socket init failed: %s\n", error.c_str());
+        return false;
+    }
+    auto status = transport.connectToSocket(std::move(socket), 5, false);
+    if (!status.success) {
+        logf_err("handshake failed: %s\n", status.errorStr.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 当前进程的虚拟内存大小
+ *
+ * @return size_t KiB
+ */
+static size_t vm_size_kb() {
+    size_t size = 0;
+    FILE *status = fopen("/proc/self/status", "r");
+    if (!status)
+        return 0;
+    char line[256];
+    while (fgets(line, sizeof(line), status)) {
+        if (strncmp(line, "VmSize:", 7) == 0)
+            size = strtoull(line + 7, nullptr, 10);
+    }
+    fclose(status);
+    return size;
+}
+
+/**
+ * @brief 分片消息的首帧后跟一个只有帧头的续帧, 续帧声明的长度未收到
+ *
+ * 接收端只能按已收到的负载预留内存, 否则2^62会抛出length_error终止进程, 2GiB会为一个连接预留2GiB
+ *
+ * @param declared 续帧声明的负载长度
+ * @return bool 进程存活且虚拟内存增长不超过64MiB
+ */
+static bool check_declared_continuation(uint64_t declared) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        logf_err("socketpair failed\n");
+        return false;
+    }
+    ix::WebSocketTransport transport;
+    if (!open_transport(fds, transport)) {
+        ::close(fds[1]);
+        return false;
+    }
+
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::string frames;
+    // 非fin的TEXT帧, 负载"ab"
+    frames.push_back(static_cast<char>(0x01));
+    frames.push_back(static_cast<char>(0x82));
+    frames.append(reinterpret_cast<const char *>(mask), 4);
+    frames.push_back(static_cast<char>('a' ^ mask[0]));
+    frames.push_back(static_cast<char>('b' ^ mask[1]));
+    // fin的续帧, 64位长度, 不带负载
+    frames.push_back(static_cast<char>(0x80));
+    frames.push_back(static_cast<char>(0x80 | 127));
+    for (int i = 7; i >= 0; --i)
+        frames.push_back(static_cast<char>((declared >> (8 * i)) & 0xff));
+    frames.append(reinterpret_cast<const char *>(mask), 4);
+    write_all(fds[1], frames);
+
+    size_t before = vm_size_kb();
+    size_t messages = 0;
+    // 两帧一次写入, 一次poll即全部读到; 续帧的负载永远不会到达, 不能再poll
+    auto result = transport.poll();
+    transport.dispatch(result, [&messages](std::string_view, size_t, bool, ix::WebSocketTransport::MessageKind) {
+        ++messages;
+    });
+    size_t grown = vm_size_kb() - before;
+    ::close(fds[1]);
+
+    logf_info("continuation declaring %llu bytes: %zu messages, vm grew %zu KiB\n",
+              static_cast<unsigned long long>(declared), messages, grown);
+    return grown <= 64 * 1024;
+}
+
+int main(int argc, char const *argv[]) {
+    size_t total = argc > 1 ? strtoull(argv[1], nullptr, 10) : 2000000;
+    size_t payload_size = argc > 2 ? strtoull(argv[2], nullptr, 10) : 64;
+    if (payload_size >= 126) {
+        logf_err("payload size must be less than 126\n");
+        return 1;
+    }
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        logf_err("socketpair failed\n");
+        return 1;
+    }
+    ix::WebSocketTransport transport;
+    if (!open_transport(fds, transport))
+        return 1;
+
+    const size_t batch_frames = 16384;
+    const std::string batch = make_frames(batch_frames, payload_size);
+    size_t batches = (total + batch_frames - 1) / batch_frames;
+    total = batches * batch_frames;
+
+    std::thread writer([&]() {
+        for (size_t i = 0; i < batches; ++i)
+            if (!write_all(fds[1], batch))
+                break;
+    });
+
+    size_t received = 0;
+    auto begin = std::chrono::steady_clock::now();
+    while (received < total) {
+        auto result = transport.poll();
+        transport.dispatch(result, [&received](std::string_view, size_t, bool, ix::WebSocketTransport::MessageKind) {
+            ++received;
+        });
+        if (result != ix::WebSocketTransport::PollResult::Succeeded)
+            break;
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    writer.join();
+
+    logf_info("%zu frames of %zu bytes in %.3f s: %.0f frames/s, %.1f MB/s\n", received, payload_size, elapsed,
+              received / elapsed, received * (payload_size + 6) / elapsed / 1e6);
+    ::close(fds[1]);
+    if (received != total)
+        return 1;
+
+    for (uint64_t declared : {uint64_t(1) << 62, uint64_t(2) << 30}) {
+        if (!check_declared_continuation(declared)) {
+            logf_err("receive buffer was sized from the declared length\n");
+            return 1;
+        }
+    }
+    return 0;
+}